@@ -0,0 +1,258 @@
+#include "applesoft.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+
+// In token order, $80-$EA
+const char* const Applesoft::TOKENS[NUM_TOKENS] = {
+    "END", "FOR", "NEXT", "DATA", "INPUT", "DEL", "DIM", "READ",
+    "GR", "TEXT", "PR#", "IN#", "CALL", "PLOT", "HLIN", "VLIN",
+    "HGR2", "HGR", "HCOLOR=", "HPLOT", "DRAW", "XDRAW", "HTAB", "HOME",
+    "ROT=", "SCALE=", "SHLOAD", "TRACE", "NOTRACE", "NORMAL", "INVERSE", "FLASH",
+    "COLOR=", "POP", "VTAB", "HIMEM:", "LOMEM:", "ONERR", "RESUME", "RECALL",
+    "STORE", "SPEED=", "LET", "GOTO", "RUN", "IF", "RESTORE", "&",
+    "GOSUB", "RETURN", "REM", "STOP", "ON", "WAIT", "LOAD", "SAVE",
+    "DEF", "POKE", "PRINT", "CONT", "LIST", "CLEAR", "GET", "NEW",
+    "TAB(", "TO", "FN", "SPC(", "THEN", "AT", "NOT", "STEP",
+    "+", "-", "*", "/", "^", "AND", "OR", ">", "=", "<",
+    "SGN", "INT", "ABS", "USR", "FRE", "SCRN(", "PDL", "POS",
+    "SQR", "RND", "LOG", "EXP", "COS", "SIN", "TAN", "ATN",
+    "PEEK", "LEN", "STR$", "VAL", "ASC", "CHR$", "LEFT$", "RIGHT$",
+    "MID$"
+};
+
+static const uint8_t TOKEN_DATA = 0x83;
+static const uint8_t TOKEN_REM = 0xB2;
+static const uint8_t TOKEN_PRINT = 0xBA;
+static const uint8_t TOKEN_AT = 0xC5;
+static const uint8_t TOKEN_ATN = 0xE1;
+
+static size_t skipSpaces(const std::string& text, size_t pos) {
+    while (pos < text.size() && text[pos] == ' ') pos++;
+    return pos;
+}
+
+// ========== Tokenizer ==========
+
+// Like the ROM's PARSE: the first keyword in table order wins, and spaces
+// may appear between its letters. "AT" is special-cased: followed by N it
+// is ATN, followed by O it is not a keyword at all (so "A TO" survives).
+int Applesoft::matchToken(const std::string& text, size_t pos, size_t& end) {
+    for (int token = 0; token < NUM_TOKENS; token++) {
+        const char* keyword = TOKENS[token];
+        size_t j = pos;
+        bool matched = true;
+        for (const char* k = keyword; *k; k++) {
+            j = (k == keyword) ? j : skipSpaces(text, j);
+            if (j >= text.size() || toupper((unsigned char)text[j]) != *k) {
+                matched = false;
+                break;
+            }
+            j++;
+        }
+        if (!matched) continue;
+
+        if (FIRST_TOKEN + token == TOKEN_AT) {
+            size_t next = skipSpaces(text, j);
+            char c = next < text.size() ? toupper((unsigned char)text[next]) : 0;
+            if (c == 'N') {
+                end = next + 1;
+                return TOKEN_ATN;
+            }
+            if (c == 'O') return -1;
+        }
+        end = j;
+        return FIRST_TOKEN + token;
+    }
+    return -1;
+}
+
+bool Applesoft::tokenizeLine(const std::string& text, std::vector<uint8_t>& tokens) {
+    bool inData = false;
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+
+        // Strings are copied verbatim, closing quote optional
+        if (c == '"') {
+            tokens.push_back(c);
+            for (i++; i < text.size(); i++) {
+                tokens.push_back(text[i] & 0x7F);
+                if (text[i] == '"') break;
+            }
+            i++;
+            continue;
+        }
+
+        // DATA items keep their spaces and case up to the next statement
+        if (inData) {
+            if (c == ':') inData = false;
+            tokens.push_back(c & 0x7F);
+            i++;
+            continue;
+        }
+
+        if (c == ' ') {
+            i++;
+            continue;
+        }
+
+        if (c == '?') {
+            tokens.push_back(TOKEN_PRINT);
+            i++;
+            continue;
+        }
+
+        size_t end;
+        int token = matchToken(text, i, end);
+        if (token < 0) {
+            tokens.push_back(toupper((unsigned char)c) & 0x7F);
+            i++;
+            continue;
+        }
+
+        tokens.push_back(token);
+        i = end;
+        if (token == TOKEN_REM) {
+            for (; i < text.size(); i++) tokens.push_back(text[i] & 0x7F);
+        } else if (token == TOKEN_DATA) {
+            inData = true;
+        }
+    }
+    return true;
+}
+
+bool Applesoft::tokenize(const std::string& listing, uint16_t start,
+                         std::vector<uint8_t>& program, std::string& error) {
+    std::map<int, std::vector<uint8_t>> lines;
+
+    size_t pos = 0;
+    int lineCount = 0;
+    while (pos < listing.size()) {
+        size_t eol = listing.find_first_of("\r\n", pos);
+        if (eol == std::string::npos) eol = listing.size();
+        std::string text = listing.substr(pos, eol - pos);
+        pos = eol + 1;
+        lineCount++;
+
+        size_t i = skipSpaces(text, 0);
+        if (i == text.size()) continue;
+
+        if (!isdigit((unsigned char)text[i])) {
+            error = "line " + std::to_string(lineCount) + ": missing line number";
+            return false;
+        }
+        long number = 0;
+        for (; i < text.size() && (isdigit((unsigned char)text[i]) || text[i] == ' '); i++) {
+            if (text[i] != ' ') number = number * 10 + (text[i] - '0');
+            if (number > MAX_LINE_NUMBER) {
+                error = "line " + std::to_string(lineCount) + ": line number over 63999";
+                return false;
+            }
+        }
+
+        // A bare line number deletes the line, as at the prompt
+        std::vector<uint8_t> tokens;
+        tokenizeLine(text.substr(i), tokens);
+        if (tokens.empty()) {
+            lines.erase(number);
+        } else {
+            lines[number] = tokens;
+        }
+    }
+
+    program.clear();
+    for (const auto& line : lines) {
+        uint32_t next = start + program.size() + 4 + line.second.size() + 1;
+        if (next > 0xFFFF) {
+            error = "program too large";
+            return false;
+        }
+        program.push_back(next & 0xFF);
+        program.push_back(next >> 8);
+        program.push_back(line.first & 0xFF);
+        program.push_back(line.first >> 8);
+        program.insert(program.end(), line.second.begin(), line.second.end());
+        program.push_back(0);
+    }
+    program.push_back(0);
+    program.push_back(0);
+    return true;
+}
+
+// ========== Detokenizer ==========
+
+std::string Applesoft::detokenize(const uint8_t* ram, uint16_t start) {
+    std::string out;
+    uint32_t addr = start;
+
+    // Links must move forward, so a corrupt program cannot loop
+    while (addr + 4 <= 0x10000) {
+        uint16_t link = ram[addr] | (ram[addr + 1] << 8);
+        if (link == 0) break;
+        uint16_t number = ram[addr + 2] | (ram[addr + 3] << 8);
+        out += std::to_string(number);
+        out += ' ';
+
+        bool inQuote = false;
+        for (uint32_t p = addr + 4; p < 0x10000 && ram[p]; p++) {
+            uint8_t b = ram[p];
+            if (b < FIRST_TOKEN || inQuote) {
+                if (b == '"') inQuote = !inQuote;
+                out += (char)(b & 0x7F);
+                continue;
+            }
+            if (b - FIRST_TOKEN >= NUM_TOKENS) continue;
+
+            // Words get a space either side, operators none. REM and DATA
+            // text follows as stored, leading spaces included.
+            std::string keyword = TOKENS[b - FIRST_TOKEN];
+            bool word = isalpha((unsigned char)keyword[0]);
+            bool literal = b == TOKEN_REM || b == TOKEN_DATA;
+            if (word && out.back() != ' ') out += ' ';
+            out += keyword;
+            if (word && !literal && isalpha((unsigned char)keyword.back())) out += ' ';
+        }
+        out += '\n';
+
+        if (link <= addr) break;
+        addr = link;
+    }
+    return out;
+}
+
+// ========== Memory Image ==========
+
+bool Applesoft::load(uint8_t* ram, const std::string& listing, std::string& error) {
+    uint16_t start = ram[TXTTAB] | (ram[TXTTAB + 1] << 8);
+    if (start == 0) start = PROGRAM_START;
+
+    std::vector<uint8_t> program;
+    if (!tokenize(listing, start, program, error)) {
+        return false;
+    }
+
+    uint32_t end = start + program.size();
+    uint16_t himem = ram[MEMSIZ] | (ram[MEMSIZ + 1] << 8);
+    if (himem == 0) himem = 0x9600;
+    if (end > himem) {
+        error = "program too large (" + std::to_string(program.size()) + " bytes)";
+        return false;
+    }
+
+    ram[start - 1] = 0;
+    std::copy(program.begin(), program.end(), ram + start);
+
+    const uint8_t pointers[] = {TXTTAB, VARTAB, ARYTAB, STREND, PRGEND};
+    for (uint8_t zp : pointers) {
+        uint16_t value = (zp == TXTTAB) ? start : end;
+        ram[zp] = value & 0xFF;
+        ram[zp + 1] = value >> 8;
+    }
+    return true;
+}
+
+std::string Applesoft::save(const uint8_t* ram) {
+    uint16_t start = ram[TXTTAB] | (ram[TXTTAB + 1] << 8);
+    return detokenize(ram, start ? start : PROGRAM_START);
+}
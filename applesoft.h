@@ -0,0 +1,52 @@
+// applesoft.h - Host-side Applesoft BASIC tokenizer and detokenizer
+#ifndef APPLESOFT_H
+#define APPLESOFT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Programs are stored as linked lines from TXTTAB ($0801):
+//   [next line lo/hi] [line number lo/hi] [tokens and ASCII...] $00
+// and end with a $0000 link. Keywords are single bytes $80-$EA.
+class Applesoft {
+public:
+    static const uint16_t PROGRAM_START = 0x0801;
+    static const int MAX_LINE_NUMBER = 63999;
+    static const uint8_t FIRST_TOKEN = 0x80;
+    static const int NUM_TOKENS = 107;              // $80 END .. $EA MID$
+
+    // Zero-page pointers fixed up by load()
+    static const uint8_t TXTTAB = 0x67;             // Program start
+    static const uint8_t VARTAB = 0x69;             // Simple variables (program end)
+    static const uint8_t ARYTAB = 0x6B;             // Arrays
+    static const uint8_t STREND = 0x6D;             // End of arrays
+    static const uint8_t MEMSIZ = 0x73;             // HIMEM
+    static const uint8_t PRGEND = 0xAF;             // End of program
+
+    static const char* const TOKENS[NUM_TOKENS];
+
+    // Tokenize a text listing the way the Applesoft line editor would:
+    // spaces dropped outside strings, REM and DATA, keywords matched
+    // greedily, lines sorted by number with later duplicates replacing
+    // earlier ones. The image is linked for loading at `start`.
+    static bool tokenize(const std::string& listing, uint16_t start,
+                         std::vector<uint8_t>& program, std::string& error);
+
+    // LIST-style text of the program linked from `start` in `ram`
+    static std::string detokenize(const uint8_t* ram, uint16_t start);
+
+    // Tokenize into `ram` at TXTTAB and point VARTAB, ARYTAB, STREND and
+    // PRGEND past it, as if the lines had been typed. Fails if the
+    // program would run into HIMEM.
+    static bool load(uint8_t* ram, const std::string& listing, std::string& error);
+
+    // Detokenize the program at TXTTAB
+    static std::string save(const uint8_t* ram);
+
+private:
+    static bool tokenizeLine(const std::string& text, std::vector<uint8_t>& tokens);
+    static int matchToken(const std::string& text, size_t pos, size_t& end);
+};
+
+#endif
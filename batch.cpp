@@ -0,0 +1,476 @@
+// batch.cpp - Parallel test runner: many machines, one per job, on every core
+#include "diskimage.h"
+#include "machine.h"
+#include "script.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Machines run on pool threads and never open the trace log
+DebugLog debugLog;
+
+static const uint64_t DEFAULT_CYCLES = 100000000;      // ~100 s emulated
+
+struct Job {
+  std::string name;
+  std::string rom;
+  std::string disks[2];
+  std::string hardDisk;
+  std::string program;          // Applesoft listing to load at the first prompt
+  std::string input;            // Typed after the program is loaded
+  std::string script;
+  std::string expect;           // Without a script: text to wait for
+  uint64_t cycles = DEFAULT_CYCLES;
+};
+
+struct JobResult {
+  enum Status { PASSED, FAILED, ERROR };
+
+  Status status = ERROR;
+  std::string message;
+  std::string output;           // What the script printed
+  std::string screen;           // Text page when the job failed
+  uint64_t cycles = 0;
+  double seconds = 0;
+
+  double mhz() const { return seconds > 0 ? cycles / seconds / 1e6 : 0; }
+};
+
+struct Options {
+  Job defaults;
+  int threads = 0;
+  std::string junitFile;
+  std::string jsonFile;
+  bool quiet = false;
+};
+
+static std::mutex g_print_lock;
+
+// ========== Jobs ==========
+
+static bool readFile(const std::string &path, std::string &text) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) return false;
+  text.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return true;
+}
+
+static std::string quote(const std::string &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') quoted += '\\';
+    if (c == '\n') {
+      quoted += "\\n";
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+// ROM images are read once and shared read-only by every job
+typedef std::map<std::string, std::vector<uint8_t>> RomCache;
+
+static void runJob(const Job &job, const RomCache &roms, JobResult &result) {
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Machine> machine(new Machine);
+  Script script;
+  std::string error;
+
+  auto fail = [&](const std::string &message) {
+    result.status = JobResult::ERROR;
+    result.message = message;
+  };
+
+  auto rom = roms.find(job.rom);
+  if (job.rom.empty()) return fail("no ROM (use -rom or a rom key)");
+  if (rom == roms.end() || rom->second.empty()) return fail("cannot read ROM " + job.rom);
+  if (!machine->loadROMImage(rom->second.data(), rom->second.size())) return fail("bad ROM " + job.rom);
+
+  for (int drive = 0; drive < 2; drive++) {
+    if (!job.disks[drive].empty() && !machine->loadDisk(drive, job.disks[drive])) {
+      return fail("cannot load disk " + job.disks[drive]);
+    }
+  }
+  if (!job.hardDisk.empty() && !machine->loadHardDisk(0, job.hardDisk)) {
+    return fail("cannot mount hard disk " + job.hardDisk);
+  }
+
+  if (!job.program.empty()) {
+    std::string listing;
+    if (!readFile(job.program, listing)) return fail("cannot open " + job.program);
+    if (!machine->setProgram(listing, error)) return fail(job.program + ": " + error);
+  }
+  if (!job.input.empty()) machine->setInput(job.input);
+
+  // Without a script the job is a one-line one: wait for the expected
+  // text, or just run the whole budget as a smoke test
+  if (!job.script.empty()) {
+    if (!script.load(job.script, error)) return fail(error);
+  } else {
+    std::string text = job.expect.empty() ? "run " + std::to_string(job.cycles)
+                                          : "wait " + quote(job.expect) + " " + std::to_string(job.cycles);
+    if (!script.parse(text, job.name, error)) return fail(error);
+  }
+  script.setCycleLimit(job.cycles);
+
+  std::ostringstream out;
+  bool passed = script.run(*machine, out, error);
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.cycles = machine->cycles();
+  result.output = out.str();
+  result.status = passed ? JobResult::PASSED : JobResult::FAILED;
+  if (!passed) {
+    result.message = error;
+    result.screen = script.screen(*machine).text();
+  }
+}
+
+static void report(const Options &options, const Job &job, const JobResult &result) {
+  static const char *const STATUS[] = {"PASS", "FAIL", "ERROR"};
+  std::lock_guard<std::mutex> guard(g_print_lock);
+  printf("%-5s %s: %llu cycles in %.3f s (%.1f MHz)\n", STATUS[result.status], job.name.c_str(),
+         (unsigned long long)result.cycles, result.seconds, result.mhz());
+  if (result.status == JobResult::PASSED) return;
+  printf("      %s\n", result.message.c_str());
+  if (!options.quiet) printf("%s", result.screen.c_str());
+}
+
+// ========== Manifests and Directories ==========
+
+// Resolve a path from a manifest against the manifest's own directory
+static std::string resolve(const fs::path &base, const std::string &path) {
+  if (path.empty() || fs::path(path).is_absolute()) return path;
+  return (base / path).lexically_normal().string();
+}
+
+static bool setKey(Job &job, const std::string &key, const std::string &value, const fs::path &base) {
+  if (key == "rom") {
+    job.rom = resolve(base, value);
+  } else if (key == "disk" || key == "disk1") {
+    job.disks[0] = resolve(base, value);
+  } else if (key == "disk2") {
+    job.disks[1] = resolve(base, value);
+  } else if (key == "hd") {
+    job.hardDisk = resolve(base, value);
+  } else if (key == "load") {
+    job.program = resolve(base, value);
+  } else if (key == "script") {
+    job.script = resolve(base, value);
+  } else if (key == "input") {
+    job.input = value;
+  } else if (key == "expect") {
+    job.expect = value;
+  } else if (key == "cycles") {
+    return Script::parseNumber(value, job.cycles) && job.cycles > 0;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// One job per line: a name, then KEY VALUE pairs, in script syntax.
+// A line named "default" sets the keys of every job after it.
+//
+//   default rom apple2e.rom cycles 50000000
+//   hello   load hello.bas input "RUN\r" expect "HELLO, WORLD"
+//   dos     disk dos33.dsk script dos.txt
+static bool loadManifest(const std::string &filename, Job defaults, std::vector<Job> &jobs) {
+  std::string text;
+  if (!readFile(filename, text)) {
+    std::cerr << "Error: Cannot open " << filename << "\n";
+    return false;
+  }
+  fs::path base = fs::path(filename).parent_path();
+
+  std::istringstream lines(text);
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(lines, line)) {
+    lineNumber++;
+    std::vector<std::string> words;
+    std::string error;
+    bool ok = Script::tokenizeLine(line, words, error);
+    if (ok && words.empty()) continue;
+    if (ok && words.size() % 2 == 0) error = "expected a name and KEY VALUE pairs";
+
+    Job job = defaults;
+    job.name = ok ? words[0] : "";
+    for (size_t i = 1; ok && error.empty() && i + 1 < words.size(); i += 2) {
+      if (!setKey(job, words[i], words[i + 1], base)) error = "bad " + words[i] + " " + words[i + 1];
+    }
+    if (!error.empty()) {
+      std::cerr << filename << ":" << lineNumber << ": " << error << "\n";
+      return false;
+    }
+
+    if (job.name == "default") {
+      defaults = job;
+    } else {
+      jobs.push_back(job);
+    }
+  }
+  return true;
+}
+
+// Every Applesoft listing (.bas), disk image and stand-alone script
+// (.script) under `path` is a job. Files beside it with the same stem
+// complete it: NAME.script drives it, NAME.expect holds the text to wait
+// for, NAME.input is typed after loading.
+static void collectDirectory(const std::string &path, const Job &defaults, std::vector<Job> &jobs) {
+  std::error_code ec;
+  std::vector<fs::path> found;
+  for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (it->is_regular_file(ec)) found.push_back(it->path());
+  }
+  std::sort(found.begin(), found.end());
+
+  for (const fs::path &file : found) {
+    std::string ext = file.extension().string();
+    bool program = ext == ".bas";
+    bool disk = !program && DiskImage::formatFromName(file.string()) != DiskImage::FORMAT_UNKNOWN;
+    bool script = ext == ".script";
+    if (!program && !disk && !script) continue;
+
+    fs::path stem = file;
+    stem.replace_extension();
+    // A script next to a program or disk belongs to it
+    if (script) {
+      bool owned = false;
+      for (const fs::path &other : found) {
+        fs::path otherStem = other;
+        otherStem.replace_extension();
+        owned |= other != file && otherStem == stem &&
+                 (other.extension() == ".bas" || DiskImage::formatFromName(other.string()) != DiskImage::FORMAT_UNKNOWN);
+      }
+      if (owned) continue;
+    }
+
+    Job job = defaults;
+    job.name = fs::path(file).lexically_relative(path).string();
+    if (program) job.program = file.string();
+    if (disk) job.disks[0] = file.string();
+    if (script || fs::exists(stem.string() + ".script")) job.script = stem.string() + ".script";
+
+    std::string text;
+    if (readFile(stem.string() + ".expect", text)) {
+      while (!text.empty() && isspace((unsigned char)text.back())) text.pop_back();
+      job.expect = text;
+    }
+    if (readFile(stem.string() + ".input", text)) job.input = text;
+    jobs.push_back(job);
+  }
+}
+
+// ========== Reports ==========
+
+static std::string xmlEscape(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    switch (c) {
+      case '&': escaped += "&amp;"; break;
+      case '<': escaped += "&lt;"; break;
+      case '>': escaped += "&gt;"; break;
+      case '"': escaped += "&quot;"; break;
+      default:
+        // XML 1.0 has no way to write most control characters
+        escaped += ((unsigned char)c < 32 && c != '\n' && c != '\t') ? '?' : c;
+        break;
+    }
+  }
+  return escaped;
+}
+
+static std::string jsonEscape(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else if ((unsigned char)c < 32) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", c);
+      escaped += code;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+static bool writeJUnit(const std::string &filename, const std::vector<Job> &jobs,
+                       const std::vector<JobResult> &results, double seconds) {
+  std::ofstream file(filename);
+  if (!file.is_open()) return false;
+
+  int failures = 0, errors = 0;
+  for (const JobResult &result : results) {
+    failures += result.status == JobResult::FAILED;
+    errors += result.status == JobResult::ERROR;
+  }
+
+  char number[64];
+  snprintf(number, sizeof(number), "%.3f", seconds);
+  file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+       << "<testsuite name=\"appleiie-batch\" tests=\"" << jobs.size() << "\" failures=\"" << failures
+       << "\" errors=\"" << errors << "\" time=\"" << number << "\">\n";
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const JobResult &result = results[i];
+    snprintf(number, sizeof(number), "%.3f", result.seconds);
+    file << "  <testcase classname=\"appleiie-batch\" name=\"" << xmlEscape(jobs[i].name)
+         << "\" time=\"" << number << "\">\n";
+    snprintf(number, sizeof(number), "%.2f", result.mhz());
+    file << "    <properties>\n"
+         << "      <property name=\"cycles\" value=\"" << result.cycles << "\"/>\n"
+         << "      <property name=\"mhz\" value=\"" << number << "\"/>\n"
+         << "    </properties>\n";
+    if (result.status != JobResult::PASSED) {
+      const char *tag = result.status == JobResult::FAILED ? "failure" : "error";
+      file << "    <" << tag << " message=\"" << xmlEscape(result.message) << "\">"
+           << xmlEscape(result.screen) << "</" << tag << ">\n";
+    }
+    if (!result.output.empty()) {
+      file << "    <system-out>" << xmlEscape(result.output) << "</system-out>\n";
+    }
+    file << "  </testcase>\n";
+  }
+  file << "</testsuite>\n";
+  return file.good();
+}
+
+static bool writeJSON(const std::string &filename, const std::vector<Job> &jobs,
+                      const std::vector<JobResult> &results, double seconds, uint64_t cycles) {
+  static const char *const STATUS[] = {"passed", "failed", "error"};
+  std::ofstream file(filename);
+  if (!file.is_open()) return false;
+
+  char number[64];
+  file << "{\n  \"jobs\": [\n";
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const JobResult &result = results[i];
+    snprintf(number, sizeof(number), "\"seconds\": %.6f, \"mhz\": %.2f", result.seconds, result.mhz());
+    file << "    {\"name\": \"" << jsonEscape(jobs[i].name) << "\", \"status\": \"" << STATUS[result.status]
+         << "\", \"cycles\": " << result.cycles << ", " << number;
+    if (!result.message.empty()) file << ", \"message\": \"" << jsonEscape(result.message) << "\"";
+    if (!result.screen.empty()) file << ", \"screen\": \"" << jsonEscape(result.screen) << "\"";
+    if (!result.output.empty()) file << ", \"output\": \"" << jsonEscape(result.output) << "\"";
+    file << "}" << (i + 1 < jobs.size() ? "," : "") << "\n";
+  }
+  snprintf(number, sizeof(number), "\"seconds\": %.6f, \"mhz\": %.2f", seconds, seconds > 0 ? cycles / seconds / 1e6 : 0);
+  file << "  ],\n  \"total\": {\"jobs\": " << jobs.size() << ", \"cycles\": " << cycles << ", " << number << "}\n}\n";
+  return file.good();
+}
+
+// ========== Main ==========
+
+static void usage(const char *program) {
+  std::cerr << "Usage: " << program << " [-rom file] [-cycles N] [-j threads] [-junit file] [-json file] [-q] <manifest|dir>...\n";
+  std::cerr << "Runs every job on its own machine, flat out, across all cores.\n";
+  std::cerr << "Example: " << program << " -junit report.xml tests/manifest.txt\n";
+  std::cerr << "Example: " << program << " -rom apple2e.rom -cycles 20000000 programs/\n";
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-rom" && i + 1 < argc) {
+      options.defaults.rom = argv[++i];
+    } else if (arg == "-cycles" && i + 1 < argc) {
+      if (!Script::parseNumber(argv[++i], options.defaults.cycles) || options.defaults.cycles == 0) {
+        std::cerr << "Bad cycle count: " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "-j" && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (arg == "-junit" && i + 1 < argc) {
+      options.junitFile = argv[++i];
+    } else if (arg == "-json" && i + 1 < argc) {
+      options.jsonFile = argv[++i];
+    } else if (arg == "-q") {
+      options.quiet = true;
+    } else if (arg[0] != '-') {
+      inputs.push_back(arg);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Job> jobs;
+  for (const std::string &input : inputs) {
+    if (fs::is_directory(input)) {
+      collectDirectory(input, options.defaults, jobs);
+    } else if (!loadManifest(input, options.defaults, jobs)) {
+      return 1;
+    }
+  }
+  if (jobs.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  RomCache roms;
+  for (const Job &job : jobs) {
+    if (!job.rom.empty() && !roms.count(job.rom)) {
+      std::string image;
+      readFile(job.rom, image);
+      roms[job.rom].assign(image.begin(), image.end());
+    }
+  }
+
+  std::vector<JobResult> results(jobs.size());
+  auto start = std::chrono::steady_clock::now();
+  {
+    ThreadPool pool(options.threads);
+    printf("%zu jobs, %d threads\n", jobs.size(), pool.size());
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+      const Job *job = &jobs[i];
+      JobResult *result = &results[i];
+      pool.submit([&options, &roms, job, result] {
+        runJob(*job, roms, *result);
+        report(options, *job, *result);
+      });
+    }
+    pool.wait();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  int counts[3] = {0, 0, 0};
+  uint64_t cycles = 0;
+  for (const JobResult &result : results) {
+    counts[result.status]++;
+    cycles += result.cycles;
+  }
+  printf("%zu jobs: %d passed, %d failed, %d errors; %llu cycles in %.2f s (%.1f MHz aggregate)\n",
+         jobs.size(), counts[JobResult::PASSED], counts[JobResult::FAILED], counts[JobResult::ERROR],
+         (unsigned long long)cycles, seconds, seconds > 0 ? cycles / seconds / 1e6 : 0);
+
+  if (!options.junitFile.empty() && !writeJUnit(options.junitFile, jobs, results, seconds)) {
+    std::cerr << "Error: Cannot write " << options.junitFile << "\n";
+    return 1;
+  }
+  if (!options.jsonFile.empty() && !writeJSON(options.jsonFile, jobs, results, seconds, cycles)) {
+    std::cerr << "Error: Cannot write " << options.jsonFile << "\n";
+    return 1;
+  }
+  return counts[JobResult::PASSED] == (int)jobs.size() ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include "blockdev.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ImageBlockDevice::ImageBlockDevice()
+    : fd(-1), mapping(nullptr), mappingSize(0), blocks(nullptr),
+      blockCount(0), writeProtected(true) {}
+
+ImageBlockDevice::~ImageBlockDevice() {
+    close();
+}
+
+bool ImageBlockDevice::open(const std::string& filename) {
+    close();
+
+    writeProtected = false;
+    fd = ::open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        writeProtected = true;
+        fd = ::open(filename.c_str(), O_RDONLY);
+    }
+    if (fd < 0) {
+        printf("Failed to open block image: %s\n", filename.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < BLOCK_SIZE) {
+        printf("Block image too small: %s\n", filename.c_str());
+        close();
+        return false;
+    }
+    mappingSize = st.st_size;
+
+    int prot = writeProtected ? PROT_READ : (PROT_READ | PROT_WRITE);
+    void* map = mmap(nullptr, mappingSize, prot, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        printf("Failed to map block image: %s\n", filename.c_str());
+        mapping = nullptr;
+        close();
+        return false;
+    }
+    mapping = (uint8_t*)map;
+
+    // 2MG images carry a 64-byte header with the data offset and length
+    size_t dataOffset = 0;
+    size_t dataLength = mappingSize;
+    if (mappingSize >= 64 && memcmp(mapping, "2IMG", 4) == 0) {
+        uint32_t format = mapping[0x0C] | (mapping[0x0D] << 8) | (mapping[0x0E] << 16) | (mapping[0x0F] << 24);
+        uint32_t offset = mapping[0x18] | (mapping[0x19] << 8) | (mapping[0x1A] << 16) | (mapping[0x1B] << 24);
+        uint32_t length = mapping[0x1C] | (mapping[0x1D] << 8) | (mapping[0x1E] << 16) | (mapping[0x1F] << 24);
+        if (format != 1 || offset > mappingSize || length > mappingSize - offset) {
+            printf("Unsupported 2MG image (must be ProDOS order): %s\n", filename.c_str());
+            close();
+            return false;
+        }
+        dataOffset = offset;
+        dataLength = length;
+    }
+
+    blocks = mapping + dataOffset;
+    blockCount = dataLength / BLOCK_SIZE;
+    if (blockCount > MAX_BLOCKS) {
+        blockCount = MAX_BLOCKS;
+    }
+
+    // The image is accessed at random, one block at a time
+    madvise(mapping, mappingSize, MADV_RANDOM);
+
+    printf("Mapped block image %s: %u blocks%s\n", filename.c_str(), blockCount,
+           writeProtected ? " (read-only)" : "");
+    return true;
+}
+
+void ImageBlockDevice::close() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    blocks = nullptr;
+    blockCount = 0;
+    mappingSize = 0;
+    writeProtected = true;
+}
+
+bool ImageBlockDevice::readBlock(uint32_t block, uint8_t* buffer) {
+    if (!blocks || block >= blockCount) {
+        return false;
+    }
+    memcpy(buffer, blocks + (size_t)block * BLOCK_SIZE, BLOCK_SIZE);
+    return true;
+}
+
+bool ImageBlockDevice::writeBlock(uint32_t block, const uint8_t* buffer) {
+    if (!blocks || writeProtected || block >= blockCount) {
+        return false;
+    }
+    memcpy(blocks + (size_t)block * BLOCK_SIZE, buffer, BLOCK_SIZE);
+    return true;
+}
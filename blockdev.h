@@ -0,0 +1,50 @@
+// blockdev.h - 512-byte block storage for ProDOS block devices
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class BlockDevice {
+public:
+    static const int BLOCK_SIZE = 512;
+    static const uint32_t MAX_BLOCKS = 0xFFFF;      // 32 MB ProDOS volume limit
+
+    virtual ~BlockDevice() {}
+
+    virtual uint32_t getBlockCount() const = 0;
+    virtual bool isWriteProtected() const = 0;
+
+    // Copy one block in or out; false if the block is out of range or the
+    // device cannot service it
+    virtual bool readBlock(uint32_t block, uint8_t* buffer) = 0;
+    virtual bool writeBlock(uint32_t block, const uint8_t* buffer) = 0;
+};
+
+// .po / .hdv / .2mg image mapped straight into the address space. Reads and
+// writes are a memcpy against the mapping; the kernel pages the image in on
+// first touch, so even a full 32 MB volume opens instantly.
+class ImageBlockDevice : public BlockDevice {
+public:
+    ImageBlockDevice();
+    ~ImageBlockDevice();
+
+    bool open(const std::string& filename);
+    void close();
+
+    uint32_t getBlockCount() const override { return blockCount; }
+    bool isWriteProtected() const override { return writeProtected; }
+    bool readBlock(uint32_t block, uint8_t* buffer) override;
+    bool writeBlock(uint32_t block, const uint8_t* buffer) override;
+
+private:
+    int fd;
+    uint8_t* mapping;                   // Whole file
+    size_t mappingSize;
+    uint8_t* blocks;                    // Start of block data (after any 2MG header)
+    uint32_t blockCount;
+    bool writeProtected;
+};
+
+#endif
@@ -1 +1,6 @@
-g++ -o appleiie main.cpp instructions.cpp disk.cpp ppu.cpp `pkg-config --cflags --libs gtk+-3.0` -DWITH_GTK -lncurses -std=c++17
+g++ -O2 -o appleiie main.cpp machine.cpp memory.cpp hooks.cpp monitorhooks.cpp fastmath.cpp script.cpp applesoft.cpp instructions.cpp disk.cpp diskimage.cpp frameexport.cpp gcr.cpp slots.cpp blockdev.cpp hostvolume.cpp harddisk.cpp ncursesview.cpp ppu.cpp screen.cpp `pkg-config --cflags --libs gtk+-3.0` -DWITH_GTK -lncursesw -lpthread -lz -std=c++17
+g++ -O2 -o appleiie-headless main.cpp machine.cpp memory.cpp hooks.cpp monitorhooks.cpp fastmath.cpp script.cpp applesoft.cpp instructions.cpp disk.cpp diskimage.cpp frameexport.cpp gcr.cpp slots.cpp blockdev.cpp hostvolume.cpp harddisk.cpp ncursesview.cpp ppu.cpp screen.cpp -lncursesw -lpthread -lz -std=c++17
+g++ -O2 -o appleiie-disktool disktool.cpp diskimage.cpp gcr.cpp threadpool.cpp -lpthread -std=c++17
+g++ -O2 -o appleiie-batch batch.cpp machine.cpp memory.cpp hooks.cpp monitorhooks.cpp fastmath.cpp script.cpp applesoft.cpp instructions.cpp disk.cpp diskimage.cpp frameexport.cpp gcr.cpp slots.cpp blockdev.cpp hostvolume.cpp harddisk.cpp ppu.cpp screen.cpp threadpool.cpp -lpthread -lz -std=c++17
+g++ -O2 -o appleiie-daemon daemon.cpp machine.cpp memory.cpp hooks.cpp monitorhooks.cpp fastmath.cpp script.cpp applesoft.cpp instructions.cpp disk.cpp diskimage.cpp frameexport.cpp gcr.cpp slots.cpp blockdev.cpp hostvolume.cpp harddisk.cpp ppu.cpp screen.cpp threadpool.cpp -lpthread -lz -std=c++17
+g++ -O2 -o appleiie-gcrtest gcrtest.cpp gcr.cpp -std=c++17
@@ -1,31 +1,55 @@
 #ifndef CPU_HPP
 #define CPU_HPP
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
+#include "hooks.h"
+#include "memory.h"
 #include "ppu.h"
-#include "disk.h"
+#include "slots.h"
 
 class CPU6502 {
 public:
     uint8_t regA, regX, regY, regSP;
     uint16_t regPC;
     uint8_t regP;
-    uint8_t ram[65536];
+    AddressSpace memory;                // Firmware pages may be shared with other machines
+    uint8_t* const ram;                 // memory.data(): all 64 KB, indexed directly
     uint64_t totalCycles;
 
     AppleIIVideo* video;
     AppleIIKeyboard* keyboard;
-    DiskII* diskController;
+    SlotBus slots;                      // Peripheral cards, $C080-$CFFF
 
-    bool irqRequested = false;
-    bool nmiRequested = false;
+    // Raised from the UI thread
+    std::atomic<bool> irqRequested{false};
+    std::atomic<bool> nmiRequested{false};
 
-    // Constructor WITH disk support
-    CPU6502(AppleIIVideo* v, AppleIIKeyboard* k, DiskII* d)
+    // Per-page access flags; pages with none set are plain RAM
+    enum PageFlags {
+        PAGE_IO = 0x01,                 // $C000-$CFFF: soft switches and slots
+        PAGE_VIDEO = 0x02,              // Displayed by the video, writes mark it dirty
+        PAGE_AUX = 0x04                 // Banked to aux memory (80STORE + PAGE2 + HIRES)
+    };
+    uint8_t pageFlags[256];
+    HookTable hooks;                    // ROM routines run natively (see hooks.h)
+    bool bulkLoops;                     // Copy and fill loops in one go (see runCopyLoop)
+
+    CPU6502(AppleIIVideo* v, AppleIIKeyboard* k)
         : regA(0), regX(0), regY(0), regSP(0xFF), regPC(0xD000), regP(0x24),
-          totalCycles(0), video(v), keyboard(k), diskController(d) {
-        memset(ram, 0, sizeof(ram));
+          ram(memory.data()), totalCycles(0), video(v), keyboard(k), bulkLoops(true) {
+        memset(pageFlags, 0, sizeof(pageFlags));
+        for (int page = AppleIIVideo::TEXT_START >> 8; page < AppleIIVideo::TEXT_END >> 8; page++) {
+            pageFlags[page] = PAGE_VIDEO;
+        }
+        for (int page = AppleIIVideo::HIRES_PAGE1_START >> 8; page < AppleIIVideo::HIRES_PAGE2_END >> 8; page++) {
+            pageFlags[page] = PAGE_VIDEO;
+        }
+        for (int page = 0xC0; page < 0xD0; page++) {
+            pageFlags[page] = PAGE_IO;
+        }
+        video->attachMemory(ram);
     }
 
     enum StatusFlags {
@@ -46,6 +70,15 @@ public:
     uint16_t readWord(uint16_t address);
     void writeWord(uint16_t address, uint16_t value);
 
+    // Bulk transfers for DMA-style peripherals (plain RAM is a memcpy,
+    // anything else goes through readByte/writeByte)
+    void readMemory(uint16_t address, uint8_t* data, size_t length);
+    void writeMemory(uint16_t address, const uint8_t* data, size_t length);
+    bool isPlainRAM(uint32_t start, uint32_t end, uint8_t mask) const;
+
+    // Video soft switch, then re-bank $2000-$3FFF to match
+    void softSwitch(uint16_t address);
+
     void pushByte(uint8_t value);
     uint8_t pullByte();
     void pushWord(uint16_t value);
@@ -133,6 +166,12 @@ public:
     void TXS();
     void TYA();
 
+    // Tight copy and fill loops, recognised at their first instruction
+    // and run as one copy or fill where memory allows; false leaves the
+    // instruction to run normally
+    bool runCopyLoop();
+    bool runFillLoop(uint8_t& index, uint8_t increment, uint8_t decrement);
+
     void executeInstruction();
 
 
@@ -0,0 +1,536 @@
+// daemon.cpp - Emulator as a service: jobs over a Unix socket, run on pre-booted machines
+#include "machine.h"
+#include "script.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Machines run on pool threads and never open the trace log
+DebugLog debugLog;
+
+static const uint64_t BOOT_CYCLES = 50000000;          // Give up booting after ~50 s emulated
+static const uint64_t DEFAULT_JOB_CYCLES = 10000000;
+static const int IDLE_SECONDS = 30;                    // Drop clients that stall mid-request
+static const int POLL_MS = 200;                        // How soon a stop signal is noticed
+static const int BOOT_RETRY_SECONDS = 5;               // Wait after a failed boot in the pool
+static const size_t LATENCY_WINDOW = 10000;            // Samples behind p50/p99
+static const int MAX_DUMPS = 16;
+
+struct Options {
+  std::string socketPath = "/tmp/appleiie.sock";
+  std::string rom;
+  std::string disk;
+  int poolSize = 4;
+  int threads = 0;
+  int maxQueued = 64;
+  uint64_t maxCycles = 100000000;
+  size_t maxRequest = 65536;
+};
+
+static std::atomic<bool> g_running{true};
+
+static void on_stop_signal(int) {
+  g_running = false;
+}
+
+// ========== Machine Pool ==========
+
+// Booting to the prompt takes far longer than a typical job, so it is
+// done ahead of time: a refill thread keeps -pool booted machines
+// ready. A job takes one and throws it away afterwards, so no state can
+// leak between jobs. If the pool runs dry a job boots its own (a "cold"
+// start, counted in the stats).
+class MachinePool {
+public:
+  MachinePool(const Options &options, const std::vector<uint8_t> &rom)
+      : options(options), rom(rom), coldStarts(0), stopping(false) {}
+
+  ~MachinePool() { stop(); }
+
+  // Boot one machine up front so a bad ROM or disk fails at startup
+  bool start(std::string &error) {
+    std::unique_ptr<Machine> machine = boot(error);
+    if (!machine) return false;
+    ready.push_back(std::move(machine));
+    refiller = std::thread(&MachinePool::refill, this);
+    return true;
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    wake.notify_all();
+    if (refiller.joinable()) refiller.join();
+  }
+
+  std::unique_ptr<Machine> take(std::string &error) {
+    std::unique_ptr<Machine> machine;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (!ready.empty()) {
+        machine = std::move(ready.front());
+        ready.pop_front();
+      }
+    }
+    wake.notify_one();
+    if (machine) return machine;
+
+    coldStarts++;
+    return boot(error);
+  }
+
+  int readyCount() {
+    std::lock_guard<std::mutex> guard(lock);
+    return (int)ready.size();
+  }
+
+  uint64_t coldStartCount() const { return coldStarts; }
+
+private:
+  const Options &options;
+  const std::vector<uint8_t> &rom;
+  std::deque<std::unique_ptr<Machine>> ready;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::thread refiller;
+  std::atomic<uint64_t> coldStarts;
+  bool stopping;
+
+  std::unique_ptr<Machine> boot(std::string &error) {
+    std::unique_ptr<Machine> machine(new Machine);
+    if (!machine->loadROMImage(rom.data(), rom.size())) {
+      error = "bad ROM";
+      return nullptr;
+    }
+    if (!options.disk.empty() && !machine->loadDisk(0, options.disk)) {
+      error = "cannot load disk " + options.disk;
+      return nullptr;
+    }
+    while (!machine->isWaitingForKey()) {
+      if (machine->cycles() >= BOOT_CYCLES) {
+        error = "machine did not reach a prompt in " + std::to_string(BOOT_CYCLES) + " cycles";
+        return nullptr;
+      }
+      machine->runCycles(Script::POLL_CYCLES);
+    }
+    return machine;
+  }
+
+  // A boot that fails (say the disk image went away) is reported once
+  // and retried after a pause rather than straight away
+  void refill() {
+    std::unique_lock<std::mutex> guard(lock);
+    bool failing = false;
+    while (!stopping) {
+      if ((int)ready.size() >= options.poolSize) {
+        wake.wait(guard);
+        continue;
+      }
+      guard.unlock();
+      std::string error;
+      std::unique_ptr<Machine> machine = boot(error);
+      guard.lock();
+      if (machine) {
+        if (failing) std::cerr << "Pool: booting again\n";
+        failing = false;
+        ready.push_back(std::move(machine));
+        continue;
+      }
+      if (!failing) {
+        std::cerr << "Pool: " << error << ", retrying every " << BOOT_RETRY_SECONDS << " s\n";
+        failing = true;
+      }
+      wake.wait_for(guard, std::chrono::seconds(BOOT_RETRY_SECONDS), [this] { return stopping; });
+    }
+  }
+};
+
+// ========== Metrics ==========
+
+class Metrics {
+public:
+  Metrics() : jobs(0), failed(0), errors(0), rejected(0) {}
+
+  void record(double micros, bool passed, bool error) {
+    std::lock_guard<std::mutex> guard(lock);
+    jobs++;
+    failed += !passed && !error;
+    errors += error;
+    if (latencies.size() < LATENCY_WINDOW) {
+      latencies.push_back(micros);
+    } else {
+      latencies[jobs % LATENCY_WINDOW] = micros;
+    }
+  }
+
+  void reject() {
+    std::lock_guard<std::mutex> guard(lock);
+    rejected++;
+  }
+
+  // "key value" lines; latencies in microseconds over the last jobs
+  std::string report() {
+    std::vector<double> sorted;
+    std::ostringstream out;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      sorted = latencies;
+      out << "jobs " << jobs << "\nfailed " << failed << "\nerrors " << errors
+          << "\nrejected " << rejected << "\n";
+    }
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) {
+      return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+    };
+    char line[128];
+    snprintf(line, sizeof(line), "p50 %.0f\np99 %.0f\nmax %.0f\n",
+             percentile(0.50), percentile(0.99), sorted.empty() ? 0.0 : sorted.back());
+    out << line;
+    return out.str();
+  }
+
+private:
+  std::mutex lock;
+  uint64_t jobs, failed, errors, rejected;
+  std::vector<double> latencies;
+};
+
+// ========== Connections ==========
+
+// Buffered reads from a client socket. Every read is bounded by the
+// request size limit and IDLE_SECONDS, and gives up once a stop signal
+// arrives.
+class Connection {
+public:
+  explicit Connection(int fd) : fd(fd), consumed(0) {}
+  ~Connection() { close(fd); }
+
+  bool readLine(std::string &line, size_t limit) {
+    line.clear();
+    for (;;) {
+      size_t eol = buffer.find('\n');
+      if (eol != std::string::npos) {
+        line = buffer.substr(0, eol);
+        buffer.erase(0, eol + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        consumed += line.size() + 1;
+        return consumed <= limit;
+      }
+      if (buffer.size() > limit) return false;
+      if (!waitReadable()) return false;
+      char chunk[4096];
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) return false;
+      buffer.append(chunk, n);
+    }
+  }
+
+  bool write(const std::string &text) {
+    size_t done = 0;
+    while (done < text.size()) {
+      ssize_t n = send(fd, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      done += n;
+    }
+    return true;
+  }
+
+  void startRequest() { consumed = 0; }
+
+private:
+  bool waitReadable() {
+    for (int waited = 0; waited < IDLE_SECONDS * 1000; waited += POLL_MS) {
+      if (!g_running) return false;
+      pollfd p = {fd, POLLIN, 0};
+      int ready = poll(&p, 1, POLL_MS);
+      if (ready > 0) return true;
+      if (ready < 0 && errno != EINTR) return false;
+    }
+    return false;
+  }
+
+  int fd;
+  std::string buffer;
+  size_t consumed;               // Bytes of the current request
+};
+
+struct Request {
+  std::string program;
+  std::string script;
+  std::string input;
+  uint64_t cycles = DEFAULT_JOB_CYCLES;
+  std::vector<std::pair<uint16_t, uint64_t>> dumps;
+};
+
+// Lines up to a lone "." (a program or script body)
+static bool readBlock(Connection &connection, size_t limit, std::string &block) {
+  std::string line;
+  while (connection.readLine(line, limit)) {
+    if (line == ".") return true;
+    block += line + "\n";
+  }
+  return false;
+}
+
+// Read one request up to "run". Returns false when the client is gone
+// (or broke a limit); `error` is set for a request that is only malformed.
+static bool readRequest(Connection &connection, const Options &options, Request &request,
+                        bool &stats, std::string &error) {
+  connection.startRequest();
+  std::string line;
+  while (connection.readLine(line, options.maxRequest)) {
+    std::vector<std::string> w;
+    std::string message;
+    if (!Script::tokenizeLine(line, w, message)) {
+      if (error.empty()) error = message;
+      continue;
+    }
+    if (w.empty()) continue;
+
+    uint64_t a, b;
+    if (w[0] == "run" && w.size() == 1) {
+      return true;
+    } else if (w[0] == "stats" && w.size() == 1) {
+      stats = true;
+      return true;
+    } else if (w[0] == "program" && w.size() == 1) {
+      if (!readBlock(connection, options.maxRequest, request.program)) return false;
+    } else if (w[0] == "script" && w.size() == 1) {
+      if (!readBlock(connection, options.maxRequest, request.script)) return false;
+    } else if (w[0] == "input" && w.size() == 2) {
+      request.input += w[1];
+    } else if (w[0] == "cycles" && w.size() == 2 && Script::parseNumber(w[1], a) && a > 0) {
+      request.cycles = a;
+    } else if (w[0] == "mem" && w.size() == 3 && Script::parseNumber(w[1], a) && a <= 0xFFFF &&
+               Script::parseNumber(w[2], b) && b <= 0x10000) {
+      if ((int)request.dumps.size() == MAX_DUMPS) {
+        if (error.empty()) error = "more than " + std::to_string(MAX_DUMPS) + " memory dumps";
+      } else {
+        request.dumps.push_back(std::make_pair((uint16_t)a, b));
+      }
+    } else if (error.empty()) {
+      error = "bad request line: " + line;
+    }
+  }
+  return false;
+}
+
+static std::string runRequest(const Request &request, const Options &options, MachinePool &pool,
+                              bool &passed, std::string &error) {
+  passed = false;
+  if (request.cycles > options.maxCycles) {
+    error = "cycle budget over the limit of " + std::to_string(options.maxCycles);
+    return "";
+  }
+
+  std::unique_ptr<Machine> machine = pool.take(error);
+  if (!machine) return "";
+  if (!request.program.empty() && !machine->setProgram(request.program, error)) return "";
+  if (!request.input.empty()) machine->setInput(request.input);
+
+  // By default a job runs until the program is back at a prompt (or
+  // asks for input) with everything typed
+  Script script;
+  if (!script.parse(request.script.empty() ? "wait-input" : request.script, "job", error)) return "";
+  script.setCycleLimit(request.cycles);
+
+  std::ostringstream output;
+  passed = script.run(*machine, output, error);
+
+  std::ostringstream response;
+  response << "status " << (passed ? "passed" : "failed") << "\n";
+  if (!passed) response << "message " << error << "\n";
+  response << "cycles " << script.cyclesRun() << "\n";
+  response << "screen\n" << script.screen(*machine).text() << ".\n";
+  for (const auto &dump : request.dumps) {
+    char header[32];
+    snprintf(header, sizeof(header), "mem $%04X %llu\n", dump.first, (unsigned long long)dump.second);
+    response << header;
+    Script::printMemory(response, machine->cpu.ram, dump.first, dump.second);
+    response << ".\n";
+  }
+  if (!output.str().empty()) response << "output\n" << output.str() << ".\n";
+  return response.str();
+}
+
+// Requests are served until the client leaves or goes idle, or the
+// daemon is stopping; a stop is checked between requests and while
+// waiting for input, and the client is told before it is dropped
+static void serve(int fd, const Options &options, MachinePool &pool, Metrics &metrics) {
+  Connection connection(fd);
+  for (;;) {
+    Request request;
+    bool stats = false;
+    std::string error;
+    if (!g_running || !readRequest(connection, options, request, stats, error)) {
+      if (!g_running) connection.write("status error\nmessage shutting down\nend\n");
+      return;
+    }
+
+    if (stats) {
+      std::string report = metrics.report();
+      report += "ready " + std::to_string(pool.readyCount()) + "\n";
+      report += "cold " + std::to_string(pool.coldStartCount()) + "\n";
+      if (!connection.write(report + "end\n")) return;
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool passed = false;
+    std::string response;
+    if (error.empty()) response = runRequest(request, options, pool, passed, error);
+    bool failedToRun = response.empty();
+    if (failedToRun) response = "status error\nmessage " + error + "\n";
+    double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    metrics.record(micros, passed, failedToRun);
+
+    char timing[48];
+    snprintf(timing, sizeof(timing), "micros %.0f\n", micros);
+    if (!connection.write(response + timing + "end\n")) return;
+  }
+}
+
+// ========== Main ==========
+
+static int listenOn(const std::string &path) {
+  sockaddr_un address = {};
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Error: Socket path too long: " << path << "\n";
+    return -1;
+  }
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if (fd < 0 || bind(fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 64) < 0) {
+    std::cerr << "Error: Cannot listen on " << path << "\n";
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void usage(const char *program) {
+  std::cerr << "Usage: " << program << " [options] <rom_file>\n";
+  std::cerr << "Options:\n";
+  std::cerr << "  -socket path      Unix socket to listen on (default /tmp/appleiie.sock)\n";
+  std::cerr << "  -disk file        Boot every machine from this disk image\n";
+  std::cerr << "  -pool N           Booted machines kept ready (default 4)\n";
+  std::cerr << "  -j N              Jobs run at once (default: one per core)\n";
+  std::cerr << "  -max-cycles N     Largest cycle budget a job may ask for (default 100000000)\n";
+  std::cerr << "  -max-request N    Largest request in bytes (default 65536)\n";
+  std::cerr << "  -max-queued N     Connections waiting for a thread before new ones are refused (default 64)\n";
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-socket" && i + 1 < argc) {
+      options.socketPath = argv[++i];
+    } else if (arg == "-disk" && i + 1 < argc) {
+      options.disk = argv[++i];
+    } else if (arg == "-pool" && i + 1 < argc) {
+      options.poolSize = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-j" && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (arg == "-max-cycles" && i + 1 < argc) {
+      options.maxCycles = strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "-max-request" && i + 1 < argc) {
+      options.maxRequest = strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "-max-queued" && i + 1 < argc) {
+      options.maxQueued = atoi(argv[++i]);
+    } else if (arg[0] != '-' && options.rom.empty()) {
+      options.rom = arg;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (options.rom.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::ifstream file(options.rom, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Error: Cannot open " << options.rom << "\n";
+    return 1;
+  }
+  std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  MachinePool machines(options, rom);
+  std::string error;
+  if (!machines.start(error)) {
+    std::cerr << "Error: " << error << "\n";
+    return 1;
+  }
+
+  int listenFd = listenOn(options.socketPath);
+  if (listenFd < 0) return 1;
+
+  signal(SIGINT, on_stop_signal);
+  signal(SIGTERM, on_stop_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  Metrics metrics;
+  std::atomic<int> queued{0};
+  {
+    ThreadPool workers(options.threads);
+    std::cerr << "Listening on " << options.socketPath << " with " << workers.size()
+              << " threads and " << options.poolSize << " machines ready\n";
+
+    // Poll rather than block in accept() so a signal is noticed promptly
+    while (g_running) {
+      pollfd p = {listenFd, POLLIN, 0};
+      if (poll(&p, 1, POLL_MS) <= 0) continue;
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd < 0) continue;
+
+      if (queued >= options.maxQueued) {
+        metrics.reject();
+        Connection busy(fd);
+        busy.write("status error\nmessage busy\nend\n");
+        continue;
+      }
+
+      queued++;
+      workers.submit([fd, &options, &machines, &metrics, &queued] {
+        queued--;
+        serve(fd, options, machines, metrics);
+      });
+    }
+
+    // Finish the connections already accepted
+    close(listenFd);
+    unlink(options.socketPath.c_str());
+    workers.wait();
+  }
+  machines.stop();
+
+  std::cerr << metrics.report();
+  return 0;
+}
@@ -0,0 +1,45 @@
+// debuglog.h - Optional trace log shared by the emulator's modules
+#ifndef DEBUGLOG_H
+#define DEBUGLOG_H
+
+#include <fstream>
+#include <ios>
+#include <ostream>
+#include <string>
+
+// A file stream that does nothing until it is opened. The interactive
+// emulator opens it at startup; tools that run many machines on many
+// threads (appleiie-batch) never do, so their machines share no stream
+// state and a log line costs one test.
+class DebugLog {
+public:
+  void open(const std::string &path) { file.open(path, std::ios::trunc); }
+  bool isOpen() const { return file.is_open(); }
+
+  template <typename T>
+  DebugLog &operator<<(const T &value) {
+    if (file.is_open()) file << value;
+    return *this;
+  }
+
+  // Manipulators (std::hex, std::endl, ...)
+  DebugLog &operator<<(std::ostream &(*manip)(std::ostream &)) {
+    if (file.is_open()) file << manip;
+    return *this;
+  }
+  DebugLog &operator<<(std::ios_base &(*manip)(std::ios_base &)) {
+    if (file.is_open()) file << manip;
+    return *this;
+  }
+
+  void flush() {
+    if (file.is_open()) file.flush();
+  }
+
+private:
+  std::ofstream file;
+};
+
+extern DebugLog debugLog;
+
+#endif
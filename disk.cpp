@@ -2,18 +2,11 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <filesystem>
+#include <map>
+#include <mutex>
 
-// GCR encoding: 4-bit value -> 8-bit GCR
-const uint8_t DiskII::GCR_ENCODING_TABLE[64] = {
-    0x96, 0x97, 0x9A, 0x9B, 0x9D, 0x9E, 0x9F, 0xA6,
-    0xA7, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF, 0xB2, 0xB3,
-    0xB4, 0xB5, 0xB6, 0xB7, 0xB9, 0xBA, 0xBB, 0xBC,
-    0xBD, 0xBE, 0xBF, 0xCB, 0xCD, 0xCE, 0xCF, 0xD3,
-    0xD6, 0xD7, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE,
-    0xDF, 0xE5, 0xE6, 0xE7, 0xE9, 0xEA, 0xEB, 0xEC,
-    0xED, 0xEE, 0xEF, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6,
-    0xF7, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
-};
+namespace fs = std::filesystem;
 
 // Boot ROM for PR#6 - Disk II controller (loaded at $C600)
 const uint8_t DiskII::DISK_BOOT_ROM[256] = {
@@ -35,38 +28,71 @@ const uint8_t DiskII::DISK_BOOT_ROM[256] = {
     0x3D,0xCD,0x00,0x08,0xA6,0x2B,0x90,0xDB,0x4C,0x01,0x08,0x00,0x00,0x00,0x00,0x00,
 };
 
-// DOS 3.3 physical -> logical sector mapping
-const int DiskII::GCR_LOGICAL_DOS33_SECTOR[16] = {
-    0x0, 0x7, 0xE, 0x6, 0xD, 0x5, 0xC, 0x4,
-    0xB, 0x3, 0xA, 0x2, 0x9, 0x1, 0x8, 0xF
-};
-
-// ProDOS physical -> logical sector mapping
-const int DiskII::GCR_LOGICAL_PRODOS_SECTOR[16] = {
-    0x0, 0x8, 0x1, 0x9, 0x2, 0xA, 0x3, 0xB,
-    0x4, 0xC, 0x5, 0xD, 0x6, 0xE, 0x7, 0xF
-};
-
-const int DiskII::GCR_SWAP_BIT[4] = {0, 2, 1, 3};
-
 DiskII::DiskII() 
     : currentDrive(0), phases(0), motorOn(false), currPhysTrack(0), 
       currNibble(0), latchData(0), writeMode(false), loadMode(false), driveSpin(0) {
     
     for (int i = 0; i < NUM_DRIVES; i++) {
-        diskData[i] = nullptr;
-        diskTracks[i] = 0;
+        ejectDisk(i);
         writeProtected[i] = true;
     }
 }
 
-DiskII::~DiskII() {
-    for (int i = 0; i < NUM_DRIVES; i++) {
-        if (diskData[i]) {
-            delete[] diskData[i];
-            diskData[i] = nullptr;
+// ========== Disk Images ==========
+
+// Images already nibblized, by canonical path, size and modification
+// time (so a file changed on disk is read afresh)
+static std::mutex imageCacheLock;
+static std::map<std::string, std::weak_ptr<const DiskII::NibbleImage>> imageCache;
+
+std::shared_ptr<const DiskII::NibbleImage> DiskII::loadImage(const std::string& filename) {
+    std::string key;
+    std::error_code ec;
+    fs::path path = fs::canonical(filename, ec);
+    if (!ec) {
+        uintmax_t size = fs::file_size(path, ec);
+        if (!ec) {
+            auto modified = fs::last_write_time(path, ec).time_since_epoch().count();
+            if (!ec) key = path.string() + "|" + std::to_string(size) + "|" + std::to_string(modified);
+        }
+    }
+
+    // Held while loading, so machines booting the same disk at once
+    // nibblize it only once
+    std::lock_guard<std::mutex> guard(imageCacheLock);
+    if (!key.empty()) {
+        auto cached = imageCache.find(key);
+        if (cached != imageCache.end()) {
+            std::shared_ptr<const NibbleImage> image = cached->second.lock();
+            if (image) return image;
+        }
+    }
+
+    DiskImageReader reader;
+    if (!reader.open(filename, DiskImage::formatFromName(filename, true))) {
+        return nullptr;
+    }
+
+    // Read tracks, nibblizing sector images on the way in
+    std::shared_ptr<NibbleImage> image(new NibbleImage);
+    for (int trackNum = 0; trackNum < DOS_NUM_TRACKS; trackNum++) {
+        if (!reader.readTrack(trackNum, image->nibbles + (trackNum * RAW_TRACK_BYTES))) {
+            printf("Failed reading track %d\n", trackNum);
+            return nullptr;
         }
     }
+
+    if (!key.empty()) imageCache[key] = image;
+    return image;
+}
+
+void DiskII::ejectDisk(int drive) {
+    image[drive].reset();
+    for (int trackNum = 0; trackNum < DOS_NUM_TRACKS; trackNum++) {
+        tracks[drive][trackNum] = nullptr;
+        writtenTracks[drive][trackNum].reset();
+    }
+    diskTracks[drive] = 0;
 }
 
 bool DiskII::loadDisk(int drive, const std::string& filename) {
@@ -74,60 +100,39 @@ bool DiskII::loadDisk(int drive, const std::string& filename) {
         return false;
     }
     
-    // Free existing disk
-    if (diskData[drive]) {
-        delete[] diskData[drive];
-        diskData[drive] = nullptr;
-    }
-    
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        printf("Failed to open disk image: %s\n", filename.c_str());
+    ejectDisk(drive);
+    std::shared_ptr<const NibbleImage> loaded = loadImage(filename);
+    if (!loaded) {
         return false;
     }
-    
-    // Determine if DOS or ProDOS by filename
-    bool isDos33 = (filename.find(".dsk") != std::string::npos);
-    
-    // Read file size
-    file.seekg(0, std::ios::end);
-    size_t fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-    
-    // Allocate storage for raw nibbles
-    // Each track is RAW_TRACK_BYTES, 35 tracks standard
-    int numTracks = DOS_NUM_TRACKS;
-    diskData[drive] = new uint8_t[numTracks * RAW_TRACK_BYTES];
-    diskTracks[drive] = numTracks;
-    
-    uint8_t track[DOS_TRACK_BYTES];
-    
-    // Read tracks and convert to nibbles
-    for (int trackNum = 0; trackNum < numTracks; trackNum++) {
-        if (file.read((char*)track, DOS_TRACK_BYTES).fail()) {
-            printf("Failed reading track %d\n", trackNum);
-            delete[] diskData[drive];
-            diskData[drive] = nullptr;
-            return false;
-        }
-        
-        // Convert sector format to nibbles
-        uint8_t* nibblePtr = diskData[drive] + (trackNum * RAW_TRACK_BYTES);
-        trackToNibbles(track, nibblePtr, 254, trackNum, isDos33);
+
+    image[drive] = loaded;
+    diskTracks[drive] = DOS_NUM_TRACKS;
+    for (int trackNum = 0; trackNum < DOS_NUM_TRACKS; trackNum++) {
+        tracks[drive][trackNum] = loaded->nibbles + (trackNum * RAW_TRACK_BYTES);
     }
     
-    file.close();
     writeProtected[drive] = true;  // For now, always write-protected
     
-    printf("Loaded disk drive %d: %d tracks\n", drive, numTracks);
+    printf("Loaded disk drive %d: %d tracks\n", drive, DOS_NUM_TRACKS);
     return true;
 }
 
-uint8_t DiskII::ioRead(uint16_t address) {
-    printf("IO Read Address Before is %x\n", address);
+// A track's own copy, made the first time the drive writes to it
+uint8_t* DiskII::writableTrack(int drive, int trackNum) {
+    std::unique_ptr<uint8_t[]>& copy = writtenTracks[drive][trackNum];
+    if (!copy) {
+        copy.reset(new uint8_t[RAW_TRACK_BYTES]);
+        memcpy(copy.get(), tracks[drive][trackNum], RAW_TRACK_BYTES);
+        tracks[drive][trackNum] = copy.get();
+    }
+    return copy.get();
+}
 
+// ========== I/O ==========
+
+uint8_t DiskII::ioRead(uint16_t address) {
     address &= 0x0F;
-    printf("IO Read Address After is %x\n", address);
     switch (address) {
         case 0x0:
         case 0x1:
@@ -177,7 +182,6 @@ uint8_t DiskII::ioRead(uint16_t address) {
     }
     
     // Only even addresses return the latch
-    printf("Returned %x\n", ((address & 1) == 0) ? latchData : (rand() & 0xFF));
     return ((address & 1) == 0) ? latchData : (rand() & 0xFF);
 }
 
@@ -235,17 +239,6 @@ void DiskII::ioWrite(uint16_t address, uint8_t value) {
     }
 }
 
-uint8_t DiskII::readROM(uint16_t address) const {
-    // PR#6 loads the Disk II controller ROM from $C600-$C6FF
-    // Address should be in the range $C600-$C6FF
-    if (address >= ROM_BASE && address < ROM_BASE + ROM_SIZE) {
-        //printf("Returning ROM %x %x\n", address, DISK_BOOT_ROM[address - ROM_BASE]);
-        return DISK_BOOT_ROM[address - ROM_BASE];
-    }
-    printf("This should never happen\n");
-    return 0x00;  // Default return if out of range
-}
-
 void DiskII::setPhase(uint16_t address) {
     int phase = (address >> 1) & 3;
     int phaseBit = (1 << phase);
@@ -294,13 +287,13 @@ void DiskII::ioLatchC() {
                 latchData = 0x7F;
             }
             // else: latchData keeps its previous value
-        } else if (diskData[currentDrive]) {
+        } else if (image[currentDrive]) {
             // Read data from disk
             int trackNum = currPhysTrack >> 1;
             if (trackNum >= diskTracks[currentDrive]) {
                 latchData = 0x7F;
             } else {
-                uint8_t* track = diskData[currentDrive] + (trackNum * RAW_TRACK_BYTES);
+                const uint8_t* track = tracks[currentDrive][trackNum];
                 latchData = track[currNibble];
                 
                 // Skip invalid nibbles (0x7F padding)
@@ -320,9 +313,8 @@ void DiskII::ioLatchC() {
     } else {
         // Write mode: store data to disk
         int trackNum = currPhysTrack >> 1;
-        if (trackNum < diskTracks[currentDrive] && diskData[currentDrive]) {
-            uint8_t* track = diskData[currentDrive] + (trackNum * RAW_TRACK_BYTES);
-            track[currNibble] = latchData;
+        if (trackNum < diskTracks[currentDrive] && image[currentDrive]) {
+            writableTrack(currentDrive, trackNum)[currNibble] = latchData;
         }
     }
     
@@ -331,126 +323,3 @@ void DiskII::ioLatchC() {
     if (currNibble >= RAW_TRACK_BYTES)
         currNibble = 0;
 }
-
-void DiskII::writeNibbles(uint8_t value, int length) {
-    while (length > 0 && gcrNibblesPos < RAW_TRACK_BYTES) {
-        gcrNibbles[gcrNibblesPos++] = value;
-        length--;
-    }
-}
-
-void DiskII::writeSync(int length) {
-    writeNibbles(0xff, length);
-}
-
-void DiskII::encode44(uint8_t value) {
-    if (gcrNibblesPos + 1 < RAW_TRACK_BYTES) {
-        gcrNibbles[gcrNibblesPos++] = ((value >> 1) | 0xaa);
-        gcrNibbles[gcrNibblesPos++] = (value | 0xaa);
-    }
-}
-
-void DiskII::encode62(const uint8_t* track, int offset) {
-    // 86 * 3 = 258 bytes
-    gcrBuffer2[0] = GCR_SWAP_BIT[track[offset + 1] & 0x03];
-    gcrBuffer2[1] = GCR_SWAP_BIT[track[offset] & 0x03];
-    
-    // Extract 6-bit values and 2-bit remainders
-    for (int i = 255, j = 2; i >= 0; i--, j = (j == 85) ? 0 : j + 1) {
-        gcrBuffer2[j] = ((gcrBuffer2[j] << 2) | GCR_SWAP_BIT[track[offset + i] & 0x03]);
-        gcrBuffer[i] = (track[offset + i] >> 2);
-    }
-    
-    // Mask to 6 bits
-    for (int i = 0; i < 86; i++) {
-        gcrBuffer2[i] &= 0x3f;
-    }
-}
-
-void DiskII::writeAddressField(int volumeNum, int trackNum, int sectorNum) {
-    if (gcrNibblesPos + 14 >= RAW_TRACK_BYTES) return;
-    
-    // Address field prologue
-    gcrNibbles[gcrNibblesPos++] = 0xd5;
-    gcrNibbles[gcrNibblesPos++] = 0xaa;
-    gcrNibbles[gcrNibblesPos++] = 0x96;
-    
-    // Write volume, track, sector, checksum with 4-4 encoding
-    encode44(volumeNum);
-    encode44(trackNum);
-    encode44(sectorNum);
-    encode44(volumeNum ^ trackNum ^ sectorNum);
-    
-    // Epilogue
-    gcrNibbles[gcrNibblesPos++] = 0xde;
-    gcrNibbles[gcrNibblesPos++] = 0xaa;
-    gcrNibbles[gcrNibblesPos++] = 0xeb;
-}
-
-void DiskII::writeDataField() {
-    if (gcrNibblesPos + 350 >= RAW_TRACK_BYTES) return;
-    
-    uint8_t last = 0;
-    uint8_t checksum;
-    
-    // Data field prologue
-    gcrNibbles[gcrNibblesPos++] = 0xd5;
-    gcrNibbles[gcrNibblesPos++] = 0xaa;
-    gcrNibbles[gcrNibblesPos++] = 0xad;
-    
-    // Write 6-2 encoded data
-    for (int i = 0x55; i >= 0; i--) {
-        checksum = last ^ gcrBuffer2[i];
-        gcrNibbles[gcrNibblesPos++] = GCR_ENCODING_TABLE[checksum];
-        last = gcrBuffer2[i];
-    }
-    
-    for (int i = 0; i < 256; i++) {
-        checksum = last ^ gcrBuffer[i];
-        gcrNibbles[gcrNibblesPos++] = GCR_ENCODING_TABLE[checksum];
-        last = gcrBuffer[i];
-    }
-    
-    // Write checksum
-    gcrNibbles[gcrNibblesPos++] = GCR_ENCODING_TABLE[last];
-    
-    // Epilogue
-    gcrNibbles[gcrNibblesPos++] = 0xde;
-    gcrNibbles[gcrNibblesPos++] = 0xaa;
-    gcrNibbles[gcrNibblesPos++] = 0xeb;
-}
-
-void DiskII::trackToNibbles(const uint8_t* track, uint8_t* nibbles, 
-                            int volumeNum, int trackNum, bool dos33) {
-    // Use the provided nibbles buffer directly
-    memset(nibbles, 0, RAW_TRACK_BYTES);
-    gcrNibblesPos = 0;
-    
-    const int* logicalSector = dos33 ? GCR_LOGICAL_DOS33_SECTOR : GCR_LOGICAL_PRODOS_SECTOR;
-    
-    // Process all 16 sectors
-    for (int sectorNum = 0; sectorNum < DOS_NUM_SECTORS; sectorNum++) {
-        // Encode sector data (6-2 encoding)
-        encode62(track, logicalSector[sectorNum] << 8);
-        
-        // Write sync bytes
-        writeSync(12);
-        
-        // Write address field
-        writeAddressField(volumeNum, trackNum, sectorNum);
-        
-        // Sync between address and data
-        writeSync(8);
-        
-        // Write data field
-        writeDataField();
-    }
-    
-    // Pad remaining space with invalid nibbles
-    while (gcrNibblesPos < RAW_TRACK_BYTES) {
-        nibbles[gcrNibblesPos++] = 0x7F;
-    }
-    
-    // Copy to persistent member for write operations
-    memcpy(gcrNibbles, nibbles, RAW_TRACK_BYTES);
-}
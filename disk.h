@@ -4,51 +4,54 @@
 
 #include <cstdint>
 #include <cstring>
-#include <fstream>
+#include <memory>
+#include <string>
+#include "diskimage.h"
+#include "slots.h"
 
-class DiskII {
+class DiskII : public Card {
 public:
     static const int NUM_DRIVES = 2;
-    static const int DOS_NUM_SECTORS = 16;
-    static const int DOS_NUM_TRACKS = 35;
+    static const int DOS_NUM_TRACKS = DiskImage::NUM_TRACKS;
     static const int MAX_PHYS_TRACK = (2 * DOS_NUM_TRACKS) - 1;
-    static const int DOS_TRACK_BYTES = 256 * DOS_NUM_SECTORS; // 4096
-    static const int RAW_TRACK_BYTES = 0x1A00; // 6656 for .NIB
+    static const int RAW_TRACK_BYTES = DiskImage::NIB_TRACK_BYTES; // 6656 for .NIB
     
-    // Boot ROM address space (PR#6 loads from $C600-$C6FF)
-    static const uint16_t ROM_BASE = 0xC600;
+    static const int DEFAULT_SLOT = 6;
     static const uint16_t ROM_SIZE = 0x100;
     
-    // GCR encoding table (64 valid values)
-    static const uint8_t GCR_ENCODING_TABLE[64];
-    
-    // DOS 3.3 logical sector ordering
-    static const int GCR_LOGICAL_DOS33_SECTOR[16];
-    static const int GCR_LOGICAL_PRODOS_SECTOR[16];
-    
-    // Boot ROM
+    // Boot ROM (PR#6 runs it from $C600-$C6FF)
     static const uint8_t DISK_BOOT_ROM[256];
 
     DiskII();
-    ~DiskII();
 
-    // Load a disk image
+    // Load a disk image (.dsk/.do, .po or .nib; other names load as ProDOS order)
     bool loadDisk(int drive, const std::string& filename);
     
-    // I/O access
-    uint8_t ioRead(uint16_t address);
-    void ioWrite(uint16_t address, uint8_t value);
+    bool hasDisk() const { return image[0] || image[1]; }
     
-    // ROM access (for PR#6 - addresses $C600-$C6FF)
-    uint8_t readROM(uint16_t address) const;
+    // I/O access ($C080 + slot * 16)
+    uint8_t ioRead(uint16_t address) override;
+    void ioWrite(uint16_t address, uint8_t value) override;
+    
+    // Boot ROM page
+    const uint8_t* getROM() const override { return DISK_BOOT_ROM; }
     
     // Query disk state
     bool isMotorOn() const { return motorOn; }
     int getCurrentTrack() const { return currPhysTrack; }
     
+    // Nibblized images, shared by every drive in the process that loads
+    // the same unchanged file
+    struct NibbleImage {
+        uint8_t nibbles[DOS_NUM_TRACKS * RAW_TRACK_BYTES];
+    };
+
 private:
-    // Disk storage
-    uint8_t* diskData[NUM_DRIVES];      // Raw nibble data
+    // Disk storage. Tracks point into the shared image until the drive
+    // first writes to them, then at a private copy of that track alone.
+    std::shared_ptr<const NibbleImage> image[NUM_DRIVES];
+    const uint8_t* tracks[NUM_DRIVES][DOS_NUM_TRACKS];
+    std::unique_ptr<uint8_t[]> writtenTracks[NUM_DRIVES][DOS_NUM_TRACKS];
     int diskTracks[NUM_DRIVES];         // Number of tracks per drive
     bool writeProtected[NUM_DRIVES];
     
@@ -63,29 +66,13 @@ private:
     bool loadMode;
     int driveSpin;                      // Anti-stuck counter
     
-    // GCR encoding/decoding
-    uint8_t gcrBuffer[256];             // 6-bit data
-    uint8_t gcrBuffer2[86];             // 2-bit remainder
-    uint8_t gcrNibbles[RAW_TRACK_BYTES];
-    int gcrNibblesPos;
-    
     // Helper functions
+    static std::shared_ptr<const NibbleImage> loadImage(const std::string& filename);
+    void ejectDisk(int drive);
+    uint8_t* writableTrack(int drive, int trackNum);
     void setPhase(uint16_t address);
     void setDrive(int newDrive);
     void ioLatchC();
-    
-    // Conversion functions
-    void trackToNibbles(const uint8_t* track, uint8_t* nibbles, 
-                        int volumeNum, int trackNum, bool dos33);
-    void encode44(uint8_t value);
-    void encode62(const uint8_t* track, int offset);
-    void writeAddressField(int volumeNum, int trackNum, int sectorNum);
-    void writeDataField();
-    void writeSync(int length);
-    void writeNibbles(uint8_t value, int length);
-    
-    // Bit manipulation
-    const static int GCR_SWAP_BIT[4];
 };
 
 #endif
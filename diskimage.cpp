@@ -0,0 +1,402 @@
+#include "diskimage.h"
+#include "gcr.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+const int DiskImage::DOS33_SECTOR_ORDER[NUM_SECTORS] = {
+    0x0, 0x7, 0xE, 0x6, 0xD, 0x5, 0xC, 0x4,
+    0xB, 0x3, 0xA, 0x2, 0x9, 0x1, 0x8, 0xF
+};
+
+const int DiskImage::PRODOS_SECTOR_ORDER[NUM_SECTORS] = {
+    0x0, 0x8, 0x1, 0x9, 0x2, 0xA, 0x3, 0xB,
+    0x4, 0xC, 0x5, 0xD, 0x6, 0xE, 0x7, 0xF
+};
+
+// Track layout: per sector, sync + address field + sync + data field
+static const int SYNC_BEFORE_ADDRESS = 12;
+static const int SYNC_BEFORE_DATA = 8;
+static const int ADDRESS_FIELD_NIBBLES = 3 + 8 + 3;
+static const int DATA_FIELD_NIBBLES = 3 + GcrCodec::DATA_NIBBLES + 3;
+static const int DATA_SEARCH_WINDOW = 64;   // Nibbles to look for a data field after an address field
+
+static const uint8_t ADDRESS_PROLOGUE[3] = {0xD5, 0xAA, 0x96};
+static const uint8_t DATA_PROLOGUE[3] = {0xD5, 0xAA, 0xAD};
+static const uint8_t EPILOGUE[3] = {0xDE, 0xAA, 0xEB};
+
+// ========== Format helpers ==========
+
+DiskImage::Format DiskImage::formatFromName(const std::string& filename, bool fallback) {
+    size_t dot = filename.rfind('.');
+    std::string ext = (dot == std::string::npos) ? "" : filename.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    if (ext == "dsk" || ext == "do") return FORMAT_DOS33;
+    if (ext == "po") return FORMAT_PRODOS;
+    if (ext == "nib") return FORMAT_NIB;
+    if (ext == "woz") return FORMAT_WOZ;
+    return fallback ? FORMAT_PRODOS : FORMAT_UNKNOWN;
+}
+
+const char* DiskImage::formatName(Format format) {
+    switch (format) {
+        case FORMAT_DOS33: return "DOS 3.3 order";
+        case FORMAT_PRODOS: return "ProDOS order";
+        case FORMAT_NIB: return "nibble";
+        case FORMAT_WOZ: return "WOZ2";
+        default: return "unknown";
+    }
+}
+
+const char* DiskImage::extension(Format format) {
+    switch (format) {
+        case FORMAT_DOS33: return ".dsk";
+        case FORMAT_PRODOS: return ".po";
+        case FORMAT_NIB: return ".nib";
+        case FORMAT_WOZ: return ".woz";
+        default: return "";
+    }
+}
+
+// ========== Nibblization ==========
+
+void DiskImage::trackToNibbles(const uint8_t* track, uint8_t* nibbles,
+                               int volumeNum, int trackNum, Format format) {
+    const int* logicalSector = (format == FORMAT_DOS33) ? DOS33_SECTOR_ORDER : PRODOS_SECTOR_ORDER;
+    uint8_t* out = nibbles;
+
+    for (int sectorNum = 0; sectorNum < NUM_SECTORS; sectorNum++) {
+        memset(out, 0xFF, SYNC_BEFORE_ADDRESS);
+        out += SYNC_BEFORE_ADDRESS;
+
+        // Address field: volume, track, sector, checksum in 4-and-4
+        memcpy(out, ADDRESS_PROLOGUE, 3);
+        GcrCodec::encode44(volumeNum, out + 3);
+        GcrCodec::encode44(trackNum, out + 5);
+        GcrCodec::encode44(sectorNum, out + 7);
+        GcrCodec::encode44(volumeNum ^ trackNum ^ sectorNum, out + 9);
+        memcpy(out + 11, EPILOGUE, 3);
+        out += ADDRESS_FIELD_NIBBLES;
+
+        memset(out, 0xFF, SYNC_BEFORE_DATA);
+        out += SYNC_BEFORE_DATA;
+
+        // Data field: 6-and-2 encoded sector and checksum
+        memcpy(out, DATA_PROLOGUE, 3);
+        GcrCodec::encodeSector(track + (logicalSector[sectorNum] << 8), out + 3);
+        memcpy(out + 3 + GcrCodec::DATA_NIBBLES, EPILOGUE, 3);
+        out += DATA_FIELD_NIBBLES;
+    }
+
+    // Pad remaining space with invalid nibbles
+    memset(out, PAD_NIBBLE, NIB_TRACK_BYTES - (out - nibbles));
+}
+
+DiskImage::TrackStatus DiskImage::nibblesToTrack(const uint8_t* nibbles, uint8_t* track,
+                                                 int trackNum, Format format) {
+    const int* logicalSector = (format == FORMAT_DOS33) ? DOS33_SECTOR_ORDER : PRODOS_SECTOR_ORDER;
+    TrackStatus status = {0, 0, 0};
+    bool found[NUM_SECTORS] = {};
+
+    // The track is circular: scan a doubled copy so fields that wrap
+    // around the end read contiguously.
+    uint8_t ring[NIB_TRACK_BYTES * 2];
+    memcpy(ring, nibbles, NIB_TRACK_BYTES);
+    memcpy(ring + NIB_TRACK_BYTES, nibbles, NIB_TRACK_BYTES);
+    memset(track, 0, TRACK_BYTES);
+
+    int pos = 0;
+    while (pos < NIB_TRACK_BYTES) {
+        if (memcmp(ring + pos, ADDRESS_PROLOGUE, 3) != 0) {
+            pos++;
+            continue;
+        }
+
+        const uint8_t* address = ring + pos + 3;
+        uint8_t volumeNum = GcrCodec::decode44(address);
+        uint8_t fieldTrack = GcrCodec::decode44(address + 2);
+        uint8_t sectorNum = GcrCodec::decode44(address + 4);
+        uint8_t checksum = GcrCodec::decode44(address + 6);
+        pos += ADDRESS_FIELD_NIBBLES;
+
+        if ((volumeNum ^ fieldTrack ^ sectorNum) != checksum ||
+            fieldTrack != trackNum || sectorNum >= NUM_SECTORS) {
+            status.addressErrors++;
+            continue;
+        }
+
+        // The data field follows within a few sync nibbles
+        int data = pos;
+        while (data < pos + DATA_SEARCH_WINDOW && memcmp(ring + data, DATA_PROLOGUE, 3) != 0) {
+            data++;
+        }
+        if (data == pos + DATA_SEARCH_WINDOW) {
+            continue;
+        }
+
+        uint8_t sector[GcrCodec::SECTOR_BYTES];
+        bool valid = GcrCodec::decodeSector(ring + data + 3, sector);
+        pos = data + DATA_FIELD_NIBBLES;
+
+        if (!valid) {
+            status.dataErrors++;
+        } else if (!found[sectorNum]) {
+            found[sectorNum] = true;
+            status.sectorsFound++;
+            memcpy(track + (logicalSector[sectorNum] << 8), sector, GcrCodec::SECTOR_BYTES);
+        }
+    }
+
+    return status;
+}
+
+uint32_t DiskImage::nibblesToBits(const uint8_t* nibbles, uint8_t* bits) {
+    const uint32_t maxBits = NIB_TRACK_BYTES * 8;
+    uint32_t bitCount = 0;
+    memset(bits, 0, NIB_TRACK_BYTES);
+
+    auto put = [&](uint8_t nibble, int width) {
+        if (bitCount + width > maxBits) return;
+        for (int bit = 7; bit >= 0; bit--, bitCount++) {
+            if (nibble & (1 << bit)) bits[bitCount >> 3] |= 0x80 >> (bitCount & 7);
+        }
+        bitCount += width - 8;          // Trailing zero bits of a self-sync nibble
+    };
+
+    int pos = 0;
+    while (pos < NIB_TRACK_BYTES) {
+        // Copy whole fields as plain 8-bit nibbles so $FF data nibbles
+        // are not mistaken for sync
+        int field = 0;
+        if (pos + 3 <= NIB_TRACK_BYTES && memcmp(nibbles + pos, ADDRESS_PROLOGUE, 3) == 0) {
+            field = ADDRESS_FIELD_NIBBLES;
+        } else if (pos + 3 <= NIB_TRACK_BYTES && memcmp(nibbles + pos, DATA_PROLOGUE, 3) == 0) {
+            field = DATA_FIELD_NIBBLES;
+        }
+
+        if (field) {
+            int end = std::min(pos + field, (int)NIB_TRACK_BYTES);
+            for (; pos < end; pos++) put(nibbles[pos], 8);
+        } else {
+            uint8_t nibble = nibbles[pos++];
+            if (nibble == 0xFF) {
+                put(nibble, 10);
+            } else if (nibble != PAD_NIBBLE) {
+                put(nibble, 8);
+            }
+        }
+    }
+
+    return bitCount;
+}
+
+// ========== DiskImageReader ==========
+
+DiskImageReader::DiskImageReader() : format(DiskImage::FORMAT_UNKNOWN) {
+    memset(sectors, 0, sizeof(sectors));
+}
+
+bool DiskImageReader::open(const std::string& filename, DiskImage::Format imageFormat) {
+    close();
+    format = (imageFormat == DiskImage::FORMAT_UNKNOWN) ? DiskImage::formatFromName(filename) : imageFormat;
+    if (format == DiskImage::FORMAT_UNKNOWN || format == DiskImage::FORMAT_WOZ) {
+        printf("Unsupported disk image format: %s\n", filename.c_str());
+        return false;
+    }
+
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        printf("Failed to open disk image: %s\n", filename.c_str());
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    size_t fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    size_t expected = (format == DiskImage::FORMAT_NIB) ? DiskImage::NIB_IMAGE_BYTES : DiskImage::IMAGE_BYTES;
+    if (fileSize < expected) {
+        printf("Disk image too small (%zu bytes, expected %zu): %s\n", fileSize, expected, filename.c_str());
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool DiskImageReader::readTrack(int trackNum, uint8_t* nibbles) {
+    if (format == DiskImage::FORMAT_NIB) {
+        return !file.read((char*)nibbles, DiskImage::NIB_TRACK_BYTES).fail();
+    }
+
+    if (file.read((char*)sectors, DiskImage::TRACK_BYTES).fail()) {
+        return false;
+    }
+    DiskImage::trackToNibbles(sectors, nibbles, DiskImage::DEFAULT_VOLUME, trackNum, format);
+    return true;
+}
+
+// ========== DiskImageWriter ==========
+
+// WOZ2 layout: 12-byte header, INFO at 12, TMAP at 80, TRKS at 248 with
+// its 160 track entries; track data starts at block 3 (byte 1536).
+static const int WOZ_INFO_OFFSET = 12;
+static const int WOZ_TMAP_OFFSET = 80;
+static const int WOZ_TRKS_OFFSET = 248;
+static const int WOZ_DATA_BLOCK = 3;
+
+static void putLE16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void putLE32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+DiskImageWriter::DiskImageWriter() : format(DiskImage::FORMAT_UNKNOWN) {
+    memset(wozTracks, 0, sizeof(wozTracks));
+}
+
+DiskImageWriter::~DiskImageWriter() {
+    close();
+}
+
+bool DiskImageWriter::open(const std::string& filename, DiskImage::Format imageFormat) {
+    close();
+    format = imageFormat;
+    if (format == DiskImage::FORMAT_UNKNOWN) {
+        return false;
+    }
+
+    file.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        printf("Failed to create disk image: %s\n", filename.c_str());
+        return false;
+    }
+
+    if (format == DiskImage::FORMAT_WOZ && !writeWozHeader()) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool DiskImageWriter::close() {
+    if (!file.is_open()) {
+        return true;
+    }
+    bool ok = file.good();
+    if (ok && format == DiskImage::FORMAT_WOZ) {
+        ok = finishWoz();
+    }
+    file.close();
+    return ok;
+}
+
+bool DiskImageWriter::writeTrack(int trackNum, const uint8_t* nibbles, DiskImage::TrackStatus& status) {
+    status = {DiskImage::NUM_SECTORS, 0, 0};
+
+    switch (format) {
+        case DiskImage::FORMAT_DOS33:
+        case DiskImage::FORMAT_PRODOS: {
+            uint8_t track[DiskImage::TRACK_BYTES];
+            status = DiskImage::nibblesToTrack(nibbles, track, trackNum, format);
+            file.write((const char*)track, sizeof(track));
+            break;
+        }
+        case DiskImage::FORMAT_NIB:
+            file.write((const char*)nibbles, DiskImage::NIB_TRACK_BYTES);
+            break;
+        case DiskImage::FORMAT_WOZ: {
+            uint8_t bits[DiskImage::NIB_TRACK_BYTES];
+            uint32_t bitCount = DiskImage::nibblesToBits(nibbles, bits);
+            uint8_t* entry = wozTracks + trackNum * 8;
+            putLE16(entry, WOZ_DATA_BLOCK + trackNum * WOZ_TRACK_BLOCKS);
+            putLE16(entry + 2, WOZ_TRACK_BLOCKS);
+            putLE32(entry + 4, bitCount);
+            file.write((const char*)bits, sizeof(bits));
+            break;
+        }
+        default:
+            return false;
+    }
+    return file.good();
+}
+
+bool DiskImageWriter::writeWozHeader() {
+    uint8_t header[WOZ_DATA_BLOCK * 512];
+    memset(header, 0, sizeof(header));
+
+    memcpy(header, "WOZ2\xFF\n\r\n", 8);
+
+    uint8_t* info = header + WOZ_INFO_OFFSET;
+    memcpy(info, "INFO", 4);
+    putLE32(info + 4, 60);
+    info[8] = 2;                        // INFO version
+    info[9] = 1;                        // 5.25" disk
+    info[10] = 0;                       // Not write protected
+    info[11] = 0;                       // Tracks not cross-track synchronized
+    info[12] = 1;                       // Cleaned: no MC3470 fake bits
+    memset(info + 13, ' ', 32);
+    memcpy(info + 13, "appleiie-disktool", 17);
+    info[45] = 1;                       // One side
+    info[46] = 1;                       // 16-sector boot format
+    info[47] = 32;                      // 4 us bit timing
+    putLE16(info + 52, WOZ_TRACK_BLOCKS);   // Largest track
+
+    // Each whole track also answers for its neighbouring quarter tracks
+    uint8_t* tmap = header + WOZ_TMAP_OFFSET;
+    memcpy(tmap, "TMAP", 4);
+    putLE32(tmap + 4, WOZ_QUARTER_TRACKS);
+    memset(tmap + 8, 0xFF, WOZ_QUARTER_TRACKS);
+    for (int track = 0; track < DiskImage::NUM_TRACKS; track++) {
+        int quarter = track * 4;
+        if (quarter > 0) tmap[8 + quarter - 1] = track;
+        tmap[8 + quarter] = track;
+        tmap[8 + quarter + 1] = track;
+    }
+
+    uint8_t* trks = header + WOZ_TRKS_OFFSET;
+    memcpy(trks, "TRKS", 4);
+    putLE32(trks + 4, WOZ_QUARTER_TRACKS * 8 + DiskImage::NUM_TRACKS * WOZ_TRACK_BLOCKS * 512);
+
+    memset(wozTracks, 0, sizeof(wozTracks));
+    file.write((const char*)header, sizeof(header));
+    return file.good();
+}
+
+bool DiskImageWriter::finishWoz() {
+    // Track entries are only known once every track has been written
+    file.seekp(WOZ_TRKS_OFFSET + 8);
+    file.write((const char*)wozTracks, sizeof(wozTracks));
+    file.flush();
+
+    // The CRC covers everything after the 12-byte header
+    uint32_t crc = 0;
+    uint8_t buffer[16384];
+    file.seekg(WOZ_INFO_OFFSET);
+    while (file.read((char*)buffer, sizeof(buffer)) || file.gcount() > 0) {
+        crc = crc32(crc, buffer, file.gcount());
+    }
+    file.clear();
+
+    uint8_t crcBytes[4];
+    putLE32(crcBytes, crc);
+    file.seekp(8);
+    file.write((const char*)crcBytes, 4);
+    return file.good();
+}
+
+uint32_t DiskImageWriter::crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    static uint32_t table[256];
+    static bool tableReady = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)tableReady;
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,110 @@
+// diskimage.h - 5.25" disk image formats and track nibblization
+#ifndef DISKIMAGE_H
+#define DISKIMAGE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+class DiskImage {
+public:
+    static const int NUM_TRACKS = 35;
+    static const int NUM_SECTORS = 16;
+    static const int TRACK_BYTES = 256 * NUM_SECTORS;      // 4096 per .dsk/.po track
+    static const int NIB_TRACK_BYTES = 0x1A00;             // 6656 per .nib track
+    static const int IMAGE_BYTES = TRACK_BYTES * NUM_TRACKS;
+    static const int NIB_IMAGE_BYTES = NIB_TRACK_BYTES * NUM_TRACKS;
+    static const int DEFAULT_VOLUME = 254;
+    static const uint8_t PAD_NIBBLE = 0x7F;                // Fills the end of a track
+
+    enum Format {
+        FORMAT_UNKNOWN,
+        FORMAT_DOS33,           // .dsk / .do: sectors in DOS 3.3 order
+        FORMAT_PRODOS,          // .po: sectors in ProDOS order
+        FORMAT_NIB,             // .nib: raw nibble tracks
+        FORMAT_WOZ              // .woz: WOZ2 bitstream (output only)
+    };
+
+    // Physical -> logical sector mapping for each sector order
+    static const int DOS33_SECTOR_ORDER[NUM_SECTORS];
+    static const int PRODOS_SECTOR_ORDER[NUM_SECTORS];
+
+    // Per-track result of decoding a nibble track back to sectors
+    struct TrackStatus {
+        int sectorsFound;
+        int addressErrors;      // Address field checksum or track mismatches
+        int dataErrors;         // Data field checksum or invalid nibbles
+    };
+
+    // Format from the file extension. Unknown extensions are treated as
+    // ProDOS order when `fallback` is set, matching the emulator's loader.
+    static Format formatFromName(const std::string& filename, bool fallback = false);
+    static const char* formatName(Format format);
+    static const char* extension(Format format);
+
+    // Nibblize one 4096-byte track (sector order given by `format`) into
+    // NIB_TRACK_BYTES nibbles: 16 address + data fields, then padding.
+    static void trackToNibbles(const uint8_t* track, uint8_t* nibbles,
+                               int volumeNum, int trackNum, Format format);
+
+    // Find the address and data fields in a nibble track and decode them
+    // into a 4096-byte track. Missing sectors are zero-filled.
+    static TrackStatus nibblesToTrack(const uint8_t* nibbles, uint8_t* track,
+                                      int trackNum, Format format);
+
+    // Convert a nibble track to a WOZ bitstream: sync bytes between fields
+    // become 10-bit self-sync nibbles and padding is dropped. Returns the
+    // bit count; `bits` must hold NIB_TRACK_BYTES bytes.
+    static uint32_t nibblesToBits(const uint8_t* nibbles, uint8_t* bits);
+};
+
+// Streams an image one nibble track at a time, whatever its format
+class DiskImageReader {
+public:
+    DiskImageReader();
+
+    // The format comes from the file name unless one is given
+    bool open(const std::string& filename, DiskImage::Format imageFormat = DiskImage::FORMAT_UNKNOWN);
+    void close() { file.close(); }
+    DiskImage::Format getFormat() const { return format; }
+
+    // Tracks must be read in order, 0 .. NUM_TRACKS-1
+    bool readTrack(int trackNum, uint8_t* nibbles);
+
+    // Sector data of the last track read from a .dsk/.po image
+    const uint8_t* lastSectors() const { return sectors; }
+
+private:
+    std::ifstream file;
+    DiskImage::Format format;
+    uint8_t sectors[DiskImage::TRACK_BYTES];
+};
+
+// Writes nibble tracks out in any format, one track at a time
+class DiskImageWriter {
+public:
+    DiskImageWriter();
+    ~DiskImageWriter();
+
+    bool open(const std::string& filename, DiskImage::Format imageFormat);
+    bool close();
+
+    // Tracks must be written in order. Sector formats decode the track
+    // first; the decode result is returned in `status`.
+    bool writeTrack(int trackNum, const uint8_t* nibbles, DiskImage::TrackStatus& status);
+
+private:
+    static const int WOZ_QUARTER_TRACKS = 160;
+    static const int WOZ_TRACK_BLOCKS = DiskImage::NIB_TRACK_BYTES / 512;
+
+    std::fstream file;
+    DiskImage::Format format;
+    uint8_t wozTracks[WOZ_QUARTER_TRACKS * 8];  // TRKS entries, patched in on close
+
+    bool writeWozHeader();
+    bool finishWoz();
+
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length);
+};
+
+#endif
@@ -0,0 +1,298 @@
+// disktool.cpp - Batch disk image conversion and verification
+#include "diskimage.h"
+#include "gcr.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct ImageResult {
+  std::string path;
+  bool ok = false;
+  std::string error;
+  DiskImage::Format from = DiskImage::FORMAT_UNKNOWN;
+  int tracks = 0;
+  int sectorsFound = 0;
+  int addressErrors = 0;
+  int dataErrors = 0;
+  int mismatches = 0;           // Sectors that did not survive the round trip
+  size_t bytes = 0;
+  double seconds = 0;
+};
+
+struct Options {
+  DiskImage::Format to = DiskImage::FORMAT_UNKNOWN;
+  std::string outDir;
+  int threads = 0;
+  int benchPasses = 0;
+};
+
+static std::mutex g_print_lock;
+
+static std::string outputPath(const Options& options, const std::string& input) {
+  fs::path in(input);
+  fs::path dir = options.outDir.empty() ? in.parent_path() : fs::path(options.outDir);
+  return (dir / in.stem()).string() + DiskImage::extension(options.to);
+}
+
+// Decode every track once and compare against the source sectors
+static void verifyTrack(const uint8_t* nibbles, const DiskImageReader& reader,
+                        int trackNum, ImageResult& result, bool countStatus) {
+  DiskImage::Format order = reader.getFormat();
+  if (order == DiskImage::FORMAT_NIB) order = DiskImage::FORMAT_DOS33;
+
+  uint8_t track[DiskImage::TRACK_BYTES];
+  DiskImage::TrackStatus status = DiskImage::nibblesToTrack(nibbles, track, trackNum, order);
+  if (countStatus) {
+    result.sectorsFound += status.sectorsFound;
+    result.addressErrors += status.addressErrors;
+    result.dataErrors += status.dataErrors;
+  }
+
+  if (reader.getFormat() != DiskImage::FORMAT_NIB) {
+    for (int sector = 0; sector < DiskImage::NUM_SECTORS; sector++) {
+      if (memcmp(track + sector * 256, reader.lastSectors() + sector * 256, 256) != 0) {
+        result.mismatches++;
+      }
+    }
+  }
+}
+
+static void processImage(const Options& options, ImageResult& result) {
+  auto start = std::chrono::steady_clock::now();
+
+  DiskImageReader reader;
+  if (!reader.open(result.path)) {
+    result.error = "cannot read image";
+    return;
+  }
+  result.from = reader.getFormat();
+
+  DiskImageWriter writer;
+  bool converting = options.to != DiskImage::FORMAT_UNKNOWN;
+  std::string out;
+  if (converting) {
+    out = outputPath(options, result.path);
+    if (fs::exists(out) && fs::equivalent(out, result.path)) {
+      result.error = "output would overwrite input";
+      return;
+    }
+    if (!writer.open(out, options.to)) {
+      result.error = "cannot create " + out;
+      return;
+    }
+  }
+
+  uint8_t nibbles[DiskImage::NIB_TRACK_BYTES];
+  for (int trackNum = 0; trackNum < DiskImage::NUM_TRACKS; trackNum++) {
+    if (!reader.readTrack(trackNum, nibbles)) {
+      result.error = "short read on track " + std::to_string(trackNum);
+      return;
+    }
+    result.bytes += (result.from == DiskImage::FORMAT_NIB) ? DiskImage::NIB_TRACK_BYTES : DiskImage::TRACK_BYTES;
+
+    // Writing to a sector format decodes the track anyway; take its counts
+    bool decodedByWriter = false;
+    if (converting) {
+      DiskImage::TrackStatus status;
+      if (!writer.writeTrack(trackNum, nibbles, status)) {
+        result.error = "write failed on track " + std::to_string(trackNum);
+        return;
+      }
+      decodedByWriter = options.to == DiskImage::FORMAT_DOS33 || options.to == DiskImage::FORMAT_PRODOS;
+      if (decodedByWriter) {
+        result.sectorsFound += status.sectorsFound;
+        result.addressErrors += status.addressErrors;
+        result.dataErrors += status.dataErrors;
+      }
+    }
+    verifyTrack(nibbles, reader, trackNum, result, !decodedByWriter);
+    result.tracks++;
+  }
+
+  if (converting && !writer.close()) {
+    result.error = "cannot finish " + out;
+    return;
+  }
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.ok = true;
+}
+
+// Time nibblize + decode of the whole image in memory
+static void benchImage(const Options& options, ImageResult& result) {
+  DiskImageReader reader;
+  if (!reader.open(result.path)) {
+    result.error = "cannot read image";
+    return;
+  }
+  result.from = reader.getFormat();
+
+  DiskImage::Format order = result.from == DiskImage::FORMAT_NIB ? DiskImage::FORMAT_DOS33 : result.from;
+  std::vector<uint8_t> sectors(DiskImage::IMAGE_BYTES);
+  uint8_t nibbles[DiskImage::NIB_TRACK_BYTES];
+  for (int trackNum = 0; trackNum < DiskImage::NUM_TRACKS; trackNum++) {
+    if (!reader.readTrack(trackNum, nibbles)) {
+      result.error = "short read on track " + std::to_string(trackNum);
+      return;
+    }
+    DiskImage::nibblesToTrack(nibbles, &sectors[trackNum * DiskImage::TRACK_BYTES], trackNum, order);
+  }
+
+  uint8_t track[DiskImage::TRACK_BYTES];
+  auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < options.benchPasses; pass++) {
+    for (int trackNum = 0; trackNum < DiskImage::NUM_TRACKS; trackNum++) {
+      DiskImage::trackToNibbles(&sectors[trackNum * DiskImage::TRACK_BYTES], nibbles,
+                                DiskImage::DEFAULT_VOLUME, trackNum, order);
+      DiskImage::TrackStatus status = DiskImage::nibblesToTrack(nibbles, track, trackNum, order);
+      if (pass == 0) {
+        result.sectorsFound += status.sectorsFound;
+        result.addressErrors += status.addressErrors;
+        result.dataErrors += status.dataErrors;
+      }
+    }
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.tracks = DiskImage::NUM_TRACKS * options.benchPasses;
+  result.bytes = (size_t)DiskImage::IMAGE_BYTES * options.benchPasses;
+  result.ok = true;
+}
+
+static void report(const Options& options, const ImageResult& result) {
+  std::lock_guard<std::mutex> guard(g_print_lock);
+  if (!result.ok) {
+    printf("FAIL  %s: %s\n", result.path.c_str(), result.error.c_str());
+    return;
+  }
+
+  bool clean = result.addressErrors == 0 && result.dataErrors == 0 && result.mismatches == 0 &&
+               result.sectorsFound == DiskImage::NUM_TRACKS * DiskImage::NUM_SECTORS;
+  double tracksPerSec = result.seconds > 0 ? result.tracks / result.seconds : 0;
+  double mbPerSec = result.seconds > 0 ? result.bytes / result.seconds / (1024 * 1024) : 0;
+
+  printf("%s  %s: %s", clean ? "OK  " : "BAD ", result.path.c_str(), DiskImage::formatName(result.from));
+  if (options.benchPasses == 0 && options.to != DiskImage::FORMAT_UNKNOWN) {
+    printf(" -> %s", DiskImage::formatName(options.to));
+  }
+  printf(", %d/%d sectors, %d address / %d data checksum errors",
+         result.sectorsFound, DiskImage::NUM_TRACKS * DiskImage::NUM_SECTORS,
+         result.addressErrors, result.dataErrors);
+  if (result.mismatches) {
+    printf(", %d sectors differ", result.mismatches);
+  }
+  printf(", %.1f ms (%.0f tracks/s, %.1f MB/s)\n", result.seconds * 1000, tracksPerSec, mbPerSec);
+}
+
+static void collectImages(const std::string& path, std::vector<std::string>& images) {
+  std::error_code ec;
+  if (!fs::is_directory(path, ec)) {
+    images.push_back(path);
+    return;
+  }
+
+  std::vector<std::string> found;
+  for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (!it->is_regular_file(ec)) continue;
+    DiskImage::Format format = DiskImage::formatFromName(it->path().string());
+    if (format != DiskImage::FORMAT_UNKNOWN && format != DiskImage::FORMAT_WOZ) {
+      found.push_back(it->path().string());
+    }
+  }
+  std::sort(found.begin(), found.end());
+  images.insert(images.end(), found.begin(), found.end());
+}
+
+static void usage(const char* program) {
+  std::cerr << "Usage: " << program << " [-to dsk|po|nib|woz] [-o dir] [-j threads] [-bench passes] <image|dir>...\n";
+  std::cerr << "Verifies address and data field checksums of every image; with -to, converts as well.\n";
+  std::cerr << "Example: " << program << " archive/\n";
+  std::cerr << "Example: " << program << " -to woz -o woz/ -j 8 archive/\n";
+  std::cerr << "Example: " << program << " -bench 100 dos33.dsk\n";
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  std::vector<std::string> images;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-to" && i + 1 < argc) {
+      options.to = DiskImage::formatFromName(std::string("x.") + argv[++i]);
+      if (options.to == DiskImage::FORMAT_UNKNOWN) {
+        std::cerr << "Unknown output format: " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (arg == "-o" && i + 1 < argc) {
+      options.outDir = argv[++i];
+    } else if (arg == "-j" && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (arg == "-bench" && i + 1 < argc) {
+      options.benchPasses = atoi(argv[++i]);
+    } else if (arg[0] != '-') {
+      collectImages(arg, images);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (images.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (!options.outDir.empty()) {
+    std::error_code ec;
+    fs::create_directories(options.outDir, ec);
+  }
+
+  std::vector<ImageResult> results(images.size());
+  auto start = std::chrono::steady_clock::now();
+  {
+    ThreadPool pool(options.threads);
+    printf("%zu images, %d threads, GCR codec: %s\n", images.size(), pool.size(), GcrCodec::simdLevel());
+
+    for (size_t i = 0; i < images.size(); i++) {
+      results[i].path = images[i];
+      ImageResult* result = &results[i];
+      pool.submit([&options, result] {
+        if (options.benchPasses > 0) {
+          benchImage(options, *result);
+        } else {
+          processImage(options, *result);
+        }
+        report(options, *result);
+      });
+    }
+    pool.wait();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  int failed = 0;
+  int bad = 0;
+  long tracks = 0;
+  for (const ImageResult& result : results) {
+    if (!result.ok) {
+      failed++;
+    } else if (result.addressErrors || result.dataErrors || result.mismatches ||
+               result.sectorsFound != DiskImage::NUM_TRACKS * DiskImage::NUM_SECTORS) {
+      bad++;
+    }
+    tracks += result.tracks;
+  }
+
+  printf("%zu images: %zu ok, %d with errors, %d failed; %ld tracks in %.2f s (%.0f tracks/s)\n",
+         images.size(), images.size() - bad - failed, bad, failed, tracks, seconds,
+         seconds > 0 ? tracks / seconds : 0);
+  return (bad || failed) ? 1 : 0;
+}
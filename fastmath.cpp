@@ -0,0 +1,934 @@
+#include "fastmath.h"
+#include "cpu.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// Applesoft's zero page, named as in the ROM listings
+static const uint8_t INDEX = 0x5E;              // Pointer to the memory operand
+static const uint8_t RESULT = 0x62;             // $62-$66: product and quotient
+static const uint8_t ARG_EXTENSION = 0x92;
+static const uint8_t TEMP3 = 0x8A;
+static const uint8_t TEMP1 = 0x93;
+static const uint8_t TEMP2 = 0x98;
+static const uint8_t FAC = 0x9D;                // Exponent, then four mantissa bytes
+static const uint8_t FAC_SIGN = 0xA2;
+static const uint8_t SHIFT_SIGN_EXT = 0xA4;
+static const uint8_t ARG = 0xA5;
+static const uint8_t ARG_SIGN = 0xAA;
+static const uint8_t SGNCPR = 0xAB;             // FAC.SIGN xor ARG.SIGN
+static const uint8_t FAC_EXTENSION = 0xAC;      // Fifth mantissa byte, for rounding
+
+const char* const FastMath::NAMES[ROUTINE_COUNT] = {
+    "FSUB", "FSUBT", "FADD", "FADDT", "FMULT", "FMULTT", "FDIV", "FDIVT"
+};
+
+const uint16_t FastMath::ENTRY[ROUTINE_COUNT] = {
+    0xE7A7, 0xE7AA, 0xE7BE, 0xE7C1, 0xE97F, 0xE982, 0xEA66, 0xEA69
+};
+
+static bool takesOperand(int routine) {
+    return routine == FastMath::FSUB || routine == FastMath::FADD ||
+           routine == FastMath::FMULT || routine == FastMath::FDIV;
+}
+
+static int routineAt(uint16_t pc) {
+    for (int routine = 0; routine < FastMath::ROUTINE_COUNT; routine++) {
+        if (FastMath::ENTRY[routine] == pc) return routine;
+    }
+    return -1;
+}
+
+// ========== Float Unit ==========
+
+// The 6502 as the ROM's arithmetic sees it: registers, flags and the
+// zero page, the only memory it writes. Instructions are named for the
+// opcode they stand for and charge what the interpreter charges for it;
+// flags follow instructions.cpp exactly, decimal mode included (ignored).
+//
+// The routines below are the ROM's, label for label. Where the ROM
+// would raise ?OVERFLOW or ?DIVISION BY ZERO they return false, and the
+// caller throws the unit away so the ROM can do it for real.
+struct FloatUnit {
+    uint8_t a, x, y;
+    bool carry, overflow;
+    uint8_t zero, negative;     // Z is zero == 0, N is bit 7 of negative
+    uint8_t otherFlags;         // I, D, B and the unused bit, untouched
+    uint8_t* zp;
+    const uint8_t* memory;      // For operands above zero page
+    uint64_t cycles;
+    uint8_t pushed[4];          // PHP in the divide loop (never nests deeper than one)
+    int depth;
+
+    enum Shift { SHIFT_RESULT, SHIFT_BYTES, SHIFT_BITS, SHIFT_ROLL };
+    enum Exponents { EXPONENTS_OK, EXPONENTS_ZERO, EXPONENTS_OVERFLOW };
+
+    FloatUnit(uint8_t a, uint8_t x, uint8_t y, uint8_t p, uint8_t* zp, const uint8_t* memory)
+        : a(a), x(x), y(y), zp(zp), memory(memory), cycles(0), depth(0) {
+        setP(p);
+    }
+
+    uint8_t p() const {
+        return otherFlags | (carry ? CPU6502::FLAG_CARRY : 0) | (zero ? 0 : CPU6502::FLAG_ZERO) |
+               (overflow ? CPU6502::FLAG_OVERFLOW : 0) | (negative & CPU6502::FLAG_NEGATIVE);
+    }
+    void setP(uint8_t p) {
+        carry = (p & CPU6502::FLAG_CARRY) != 0;
+        zero = (p & CPU6502::FLAG_ZERO) ? 0 : 1;
+        overflow = (p & CPU6502::FLAG_OVERFLOW) != 0;
+        negative = p & CPU6502::FLAG_NEGATIVE;
+        otherFlags = p & ~(CPU6502::FLAG_CARRY | CPU6502::FLAG_ZERO | CPU6502::FLAG_OVERFLOW | CPU6502::FLAG_NEGATIVE);
+    }
+
+    void tick(uint8_t opcode) { cycles += CPU6502::instructionCycles[opcode]; }
+    uint8_t zn(uint8_t value) {
+        zero = negative = value;
+        return value;
+    }
+    uint8_t read(uint16_t address) const { return address < 0x100 ? zp[address] : memory[address]; }
+
+    // Arithmetic and logic, as in instructions.cpp
+    void adc(uint8_t v) {
+        uint16_t r = a + v + (carry ? 1 : 0);
+        carry = r > 0xFF;
+        overflow = ((a ^ r) & (v ^ r) & 0x80) != 0;
+        a = zn(r & 0xFF);
+    }
+    void sbc(uint8_t v) {
+        uint16_t r = a - v - (carry ? 0 : 1);
+        carry = r <= 0xFF;
+        overflow = ((a ^ r) & (~v ^ r) & 0x80) != 0;
+        a = zn(r & 0xFF);
+    }
+    void compare(uint8_t reg, uint8_t v) { carry = reg >= v; zn(reg - v); }
+    void asl(uint8_t& m) { carry = (m & 0x80) != 0; m = zn(m << 1); }
+    void lsr(uint8_t& m) { carry = (m & 0x01) != 0; m = zn(m >> 1); }
+    void rol(uint8_t& m) {
+        bool c = carry;
+        carry = (m & 0x80) != 0;
+        m = zn((m << 1) | (c ? 1 : 0));
+    }
+    void ror(uint8_t& m) {
+        bool c = carry;
+        carry = (m & 0x01) != 0;
+        m = zn((m >> 1) | (c ? 0x80 : 0));
+    }
+    uint8_t& zpx(uint8_t base) { return zp[(uint8_t)(base + x)]; }
+
+    void LDA_imm(uint8_t v) { tick(0xA9); a = zn(v); }
+    void LDA_zp(uint8_t ad) { tick(0xA5); a = zn(zp[ad]); }
+    void LDA_zpx(uint8_t base) { tick(0xB5); a = zn(zpx(base)); }
+    void LDA_absy(uint16_t base) { tick(0xB9); a = zn(read(base + y)); }
+    void LDA_indy(uint8_t ptr) { tick(0xB1); a = zn(read((zp[ptr] | (zp[(uint8_t)(ptr + 1)] << 8)) + y)); }
+    void LDX_imm(uint8_t v) { tick(0xA2); x = zn(v); }
+    void LDX_zp(uint8_t ad) { tick(0xA6); x = zn(zp[ad]); }
+    void LDY_imm(uint8_t v) { tick(0xA0); y = zn(v); }
+    void LDY_zp(uint8_t ad) { tick(0xA4); y = zn(zp[ad]); }
+    void LDY_zpx(uint8_t base) { tick(0xB4); y = zn(zpx(base)); }
+    void STA_zp(uint8_t ad) { tick(0x85); zp[ad] = a; }
+    void STA_zpx(uint8_t base) { tick(0x95); zpx(base) = a; }
+    void STX_zp(uint8_t ad) { tick(0x86); zp[ad] = x; }
+    void STY_zp(uint8_t ad) { tick(0x84); zp[ad] = y; }
+    void STY_zpx(uint8_t base) { tick(0x94); zpx(base) = y; }
+    void ADC_imm(uint8_t v) { tick(0x69); adc(v); }
+    void ADC_zp(uint8_t ad) { tick(0x65); adc(zp[ad]); }
+    void SBC_imm(uint8_t v) { tick(0xE9); sbc(v); }
+    void SBC_zp(uint8_t ad) { tick(0xE5); sbc(zp[ad]); }
+    void SBC_zpx(uint8_t base) { tick(0xF5); sbc(zpx(base)); }
+    void EOR_imm(uint8_t v) { tick(0x49); a = zn(a ^ v); }
+    void EOR_zp(uint8_t ad) { tick(0x45); a = zn(a ^ zp[ad]); }
+    void ORA_imm(uint8_t v) { tick(0x09); a = zn(a | v); }
+    void CMP_imm(uint8_t v) { tick(0xC9); compare(a, v); }
+    void CPX_imm(uint8_t v) { tick(0xE0); compare(x, v); }
+    void CPY_zp(uint8_t ad) { tick(0xC4); compare(y, zp[ad]); }
+    void BIT_zp(uint8_t ad) {
+        tick(0x24);
+        uint8_t v = zp[ad];
+        zero = a & v;
+        negative = v;
+        overflow = (v & 0x40) != 0;
+    }
+    void BIT_skip() { tick(0x2C); }     // The .HS 2C trick; its flags are overwritten at once
+    void ASL_zp(uint8_t ad) { tick(0x06); asl(zp[ad]); }
+    void ROL_zp(uint8_t ad) { tick(0x26); rol(zp[ad]); }
+    void ROR_zp(uint8_t ad) { tick(0x66); ror(zp[ad]); }
+    void ASL_zpx(uint8_t base) { tick(0x16); asl(zpx(base)); }
+    void LSR_zpx(uint8_t base) { tick(0x56); lsr(zpx(base)); }
+    void ROR_zpx(uint8_t base) { tick(0x76); ror(zpx(base)); }
+    void INC_zp(uint8_t ad) { tick(0xE6); zp[ad] = zn(zp[ad] + 1); }
+    void INC_zpx(uint8_t base) { tick(0xF6); zpx(base) = zn(zpx(base) + 1); }
+    void ASL_acc() { tick(0x0A); asl(a); }
+    void LSR_acc() { tick(0x4A); lsr(a); }
+    void ROL_acc() { tick(0x2A); rol(a); }
+    void ROR_acc() { tick(0x6A); ror(a); }
+    void TAY() { tick(0xA8); y = zn(a); }
+    void TYA() { tick(0x98); a = zn(y); }
+    void INX() { tick(0xE8); x = zn(x + 1); }
+    void INY() { tick(0xC8); y = zn(y + 1); }
+    void DEX() { tick(0xCA); x = zn(x - 1); }
+    void DEY() { tick(0x88); y = zn(y - 1); }
+    void CLC() { tick(0x18); carry = false; }
+    void SEC() { tick(0x38); carry = true; }
+    void PHP() { tick(0x08); pushed[depth++ & 3] = p() | CPU6502::FLAG_BREAK | CPU6502::FLAG_UNUSED; }
+    void PLP() { tick(0x28); setP((pushed[--depth & 3] | CPU6502::FLAG_UNUSED) & ~CPU6502::FLAG_BREAK); }
+    void PLA() { tick(0x68); }          // Only ever to drop a return address
+    void JSR() { tick(0x20); }
+    void JMP() { tick(0x4C); }
+    void RTS() { tick(0x60); }
+    bool BCC() { tick(0x90); return !carry; }
+    bool BCS() { tick(0xB0); return carry; }
+    bool BEQ() { tick(0xF0); return zero == 0; }
+    bool BNE() { tick(0xD0); return zero != 0; }
+    bool BMI() { tick(0x30); return (negative & 0x80) != 0; }
+    bool BPL() { tick(0x10); return (negative & 0x80) == 0; }
+
+    // LOAD.ARG.FROM.YA ($E9E3): unpack the number at (A,Y) into ARG
+    void loadArg() {
+        STA_zp(INDEX);
+        STY_zp(INDEX + 1);
+        LDY_imm(4);
+        LDA_indy(INDEX); STA_zp(ARG + 4); DEY();
+        LDA_indy(INDEX); STA_zp(ARG + 3); DEY();
+        LDA_indy(INDEX); STA_zp(ARG + 2); DEY();
+        LDA_indy(INDEX); STA_zp(ARG_SIGN);
+        EOR_zp(FAC_SIGN); STA_zp(SGNCPR);
+        LDA_zp(ARG_SIGN); ORA_imm(0x80); STA_zp(ARG + 1); DEY();
+        LDA_indy(INDEX); STA_zp(ARG);
+        LDA_zp(FAC);
+        RTS();
+    }
+
+    // FSUBT ($E7AA): FAC = ARG - FAC
+    bool fsubt() {
+        LDA_zp(FAC_SIGN); EOR_imm(0xFF); STA_zp(FAC_SIGN);
+        EOR_zp(ARG_SIGN); STA_zp(SGNCPR);
+        LDA_zp(FAC);
+        JMP();
+        return faddt();
+    }
+
+    // FADDT ($E7C1): FAC = ARG + FAC, Z from the caller's LDA FAC
+    bool faddt() {
+        if (BNE()) goto add;
+        JMP();
+        copyArgToFac();
+        return true;
+    add:
+        LDX_zp(FAC_EXTENSION); STX_zp(ARG_EXTENSION);
+        LDX_imm(ARG);
+        LDA_zp(ARG);
+        // FADD.2
+        TAY();
+        if (BEQ()) goto done;
+        SEC(); SBC_zp(FAC);
+        if (BEQ()) goto aligned;
+        if (BCC()) goto shiftArg;
+        STY_zp(FAC);                    // ARG is bigger: shift FAC instead
+        LDY_zp(ARG_SIGN); STY_zp(FAC_SIGN);
+        EOR_imm(0xFF); ADC_imm(0);
+        LDY_imm(0); STY_zp(ARG_EXTENSION);
+        LDX_imm(FAC);
+        if (BNE()) goto shift;
+    shiftArg:
+        LDY_imm(0); STY_zp(FAC_EXTENSION);
+    shift:
+        CMP_imm(0xF9);
+        if (BMI()) {
+            // FADD.1: a byte or more
+            JSR(); shiftRight(SHIFT_BITS);
+            if (BCC()) goto aligned;
+            return false;               // SHIFT.RIGHT always clears carry
+        }
+        TAY();
+        LDA_zp(FAC_EXTENSION);
+        LSR_zpx(1);
+        JSR(); shiftRight(SHIFT_ROLL);
+    aligned:
+        // FADD.3
+        BIT_zp(SGNCPR);
+        if (BPL()) goto sum;
+        LDY_imm(FAC);
+        CPX_imm(ARG);
+        if (BEQ()) goto subtract;
+        LDY_imm(ARG);
+    subtract:
+        SEC(); EOR_imm(0xFF); ADC_zp(ARG_EXTENSION); STA_zp(FAC_EXTENSION);
+        LDA_absy(4); SBC_zpx(4); STA_zp(FAC + 4);
+        LDA_absy(3); SBC_zpx(3); STA_zp(FAC + 3);
+        LDA_absy(2); SBC_zpx(2); STA_zp(FAC + 2);
+        LDA_absy(1); SBC_zpx(1); STA_zp(FAC + 1);
+        // NORMALIZE.FAC.1
+        if (!BCS()) {
+            JSR(); complementFac();
+        }
+        return normalize();
+    sum:
+        // FADD.4
+        ADC_zp(ARG_EXTENSION); STA_zp(FAC_EXTENSION);
+        LDA_zp(FAC + 4); ADC_zp(ARG + 4); STA_zp(FAC + 4);
+        LDA_zp(FAC + 3); ADC_zp(ARG + 3); STA_zp(FAC + 3);
+        LDA_zp(FAC + 2); ADC_zp(ARG + 2); STA_zp(FAC + 2);
+        LDA_zp(FAC + 1); ADC_zp(ARG + 1); STA_zp(FAC + 1);
+        JMP();
+        return carryIntoMantissa();
+    done:
+        RTS();
+        return true;
+    }
+
+    // NORMALIZE.FAC.2 ($E82E): shift left until the top bit is set
+    bool normalize() {
+        LDY_imm(0); TYA(); CLC();
+    bytes:
+        LDX_zp(FAC + 1);
+        if (BNE()) goto bits;
+        LDX_zp(FAC + 2); STX_zp(FAC + 1);
+        LDX_zp(FAC + 3); STX_zp(FAC + 2);
+        LDX_zp(FAC + 4); STX_zp(FAC + 3);
+        LDX_zp(FAC_EXTENSION); STX_zp(FAC + 4);
+        STY_zp(FAC_EXTENSION);
+        ADC_imm(8);
+        CMP_imm(32);
+        if (BNE()) goto bytes;
+        zeroFac();
+        return true;
+    shiftLeft:
+        ADC_imm(1);
+        ASL_zp(FAC_EXTENSION);
+        ROL_zp(FAC + 4); ROL_zp(FAC + 3); ROL_zp(FAC + 2); ROL_zp(FAC + 1);
+    bits:
+        if (BPL()) goto shiftLeft;
+        SEC(); SBC_zp(FAC);
+        if (BCS()) {
+            zeroFac();                  // Underflow
+            return true;
+        }
+        EOR_imm(0xFF); ADC_imm(1); STA_zp(FAC);
+        return carryIntoMantissa();
+    }
+
+    // NORMALIZE.FAC.5 ($E88D): a carry out of the top goes back in
+    bool carryIntoMantissa() {
+        if (BCC()) {
+            RTS();
+            return true;
+        }
+        return shiftCarryIn();
+    }
+
+    // NORMALIZE.FAC.6
+    bool shiftCarryIn() {
+        INC_zp(FAC);
+        if (BEQ()) return false;        // OVERFLOW
+        ROR_zp(FAC + 1); ROR_zp(FAC + 2); ROR_zp(FAC + 3); ROR_zp(FAC + 4);
+        ROR_zp(FAC_EXTENSION);
+        RTS();
+        return true;
+    }
+
+    // ZERO.FAC ($E84E)
+    void zeroFac() {
+        LDA_imm(0);
+        STA_zp(FAC);
+        STA_zp(FAC_SIGN);
+        RTS();
+    }
+
+    // COMPLEMENT.FAC ($E89E): negate sign and mantissa
+    void complementFac() {
+        LDA_zp(FAC_SIGN); EOR_imm(0xFF); STA_zp(FAC_SIGN);
+        LDA_zp(FAC + 1); EOR_imm(0xFF); STA_zp(FAC + 1);
+        LDA_zp(FAC + 2); EOR_imm(0xFF); STA_zp(FAC + 2);
+        LDA_zp(FAC + 3); EOR_imm(0xFF); STA_zp(FAC + 3);
+        LDA_zp(FAC + 4); EOR_imm(0xFF); STA_zp(FAC + 4);
+        LDA_zp(FAC_EXTENSION); EOR_imm(0xFF); STA_zp(FAC_EXTENSION);
+        INC_zp(FAC_EXTENSION);
+        if (BNE()) {
+            RTS();
+            return;
+        }
+        incrementMantissa();
+    }
+
+    // INCREMENT.FAC.MANTISSA ($E8C6)
+    void incrementMantissa() {
+        INC_zp(FAC + 4);
+        if (BNE()) goto done;
+        INC_zp(FAC + 3);
+        if (BNE()) goto done;
+        INC_zp(FAC + 2);
+        if (BNE()) goto done;
+        INC_zp(FAC + 1);
+    done:
+        RTS();
+    }
+
+    // SHIFT.RIGHT ($E8F0): the number at 1,X-4,X right by -A bits, the
+    // byte shifted out last in A. Entered at SHIFT.RIGHT.1 for RESULT,
+    // SHIFT.RIGHT.2 for a byte, or SHIFT.RIGHT.4 for the bits in Y.
+    void shiftRight(Shift entry) {
+        switch (entry) {
+        case SHIFT_RESULT: LDX_imm(RESULT - 1); goto bytes;
+        case SHIFT_BYTES: goto bytes;
+        case SHIFT_BITS: goto shift;
+        case SHIFT_ROLL: goto roll;
+        }
+    bytes:
+        LDY_zpx(4); STY_zp(FAC_EXTENSION);
+        LDY_zpx(3); STY_zpx(4);
+        LDY_zpx(2); STY_zpx(3);
+        LDY_zpx(1); STY_zpx(2);
+        LDY_zp(SHIFT_SIGN_EXT); STY_zpx(1);
+    shift:
+        ADC_imm(8);
+        if (BMI()) goto bytes;
+        if (BEQ()) goto bytes;
+        SBC_imm(8);
+        TAY();
+        LDA_zp(FAC_EXTENSION);
+        if (BCS()) goto done;
+    bits:
+        ASL_zpx(1);
+        if (BCC()) goto keepSign;
+        INC_zpx(1);
+    keepSign:
+        ROR_zpx(1);
+        ROR_zpx(1);
+    roll:
+        ROR_zpx(2); ROR_zpx(3); ROR_zpx(4);
+        ROR_acc();
+        INY();
+        if (BNE()) goto bits;
+    done:
+        CLC();
+        RTS();
+    }
+
+    // FMULTT ($E982): FAC = ARG * FAC, Z from the caller's LDA FAC
+    bool fmultt() {
+        if (!BNE()) {
+            JMP();
+            RTS();
+            return true;
+        }
+        JSR();
+        switch (addExponents()) {
+        case EXPONENTS_OVERFLOW: return false;
+        case EXPONENTS_ZERO: return true;
+        case EXPONENTS_OK: break;
+        }
+        LDA_imm(0);
+        STA_zp(RESULT); STA_zp(RESULT + 1); STA_zp(RESULT + 2); STA_zp(RESULT + 3);
+        LDA_zp(FAC_EXTENSION); JSR(); multiplyByte();
+        LDA_zp(FAC + 4); JSR(); multiplyByte();
+        LDA_zp(FAC + 3); JSR(); multiplyByte();
+        LDA_zp(FAC + 2); JSR(); multiplyByte();
+        LDA_zp(FAC + 1); JSR(); multiplyBits();
+        JMP();
+        return copyResultToFac();
+    }
+
+    // MULTIPLY.1: a zero byte of the multiplier just shifts RESULT
+    void multiplyByte() {
+        if (BNE()) {
+            multiplyBits();
+            return;
+        }
+        JMP();
+        shiftRight(SHIFT_RESULT);
+    }
+
+    // MULTIPLY.2: add ARG into RESULT for each one bit of A
+    void multiplyBits() {
+        LSR_acc();
+        ORA_imm(0x80);
+    next:
+        TAY();
+        if (BCC()) goto shift;
+        CLC();
+        LDA_zp(RESULT + 3); ADC_zp(ARG + 4); STA_zp(RESULT + 3);
+        LDA_zp(RESULT + 2); ADC_zp(ARG + 3); STA_zp(RESULT + 2);
+        LDA_zp(RESULT + 1); ADC_zp(ARG + 2); STA_zp(RESULT + 1);
+        LDA_zp(RESULT); ADC_zp(ARG + 1); STA_zp(RESULT);
+    shift:
+        ROR_zp(RESULT); ROR_zp(RESULT + 1); ROR_zp(RESULT + 2); ROR_zp(RESULT + 3);
+        ROR_zp(FAC_EXTENSION);
+        TYA();
+        LSR_acc();
+        if (BNE()) goto next;
+        RTS();
+    }
+
+    // ADD.EXPONENTS ($EA0E): a zero result pops the caller and returns
+    // from it, the way the ROM's PLA PLA does
+    Exponents addExponents() {
+        LDA_zp(ARG);
+        if (BEQ()) goto zero;
+        CLC(); ADC_zp(FAC);
+        if (BCC()) goto noCarry;
+        if (BMI()) return EXPONENTS_OVERFLOW;
+        CLC();
+        BIT_skip();
+        goto inRange;
+    noCarry:
+        if (BPL()) goto zero;
+    inRange:
+        ADC_imm(0x80);
+        STA_zp(FAC);
+        if (BNE()) goto sign;
+        JMP();
+        STA_zp(FAC_SIGN);
+        RTS();
+        return EXPONENTS_OK;
+    sign:
+        LDA_zp(SGNCPR); STA_zp(FAC_SIGN);
+        RTS();
+        return EXPONENTS_OK;
+    zero:
+        PLA(); PLA();
+        JMP();
+        zeroFac();
+        return EXPONENTS_ZERO;
+    }
+
+    // FDIVT ($EA69): FAC = ARG / FAC, Z from the caller's LDA FAC
+    bool fdivt() {
+        if (BEQ()) return false;        // DIVISION BY ZERO
+        JSR();
+        if (!roundFac()) return false;
+        LDA_imm(0); SEC(); SBC_zp(FAC); STA_zp(FAC);
+        JSR();
+        switch (addExponents()) {
+        case EXPONENTS_OVERFLOW: return false;
+        case EXPONENTS_ZERO: return true;
+        case EXPONENTS_OK: break;
+        }
+        INC_zp(FAC);
+        if (BEQ()) return false;        // OVERFLOW
+        LDX_imm(0xFC);
+        LDA_imm(1);
+    divide:
+        LDY_zp(ARG + 1); CPY_zp(FAC + 1);
+        if (BNE()) goto quotientBit;
+        LDY_zp(ARG + 2); CPY_zp(FAC + 2);
+        if (BNE()) goto quotientBit;
+        LDY_zp(ARG + 3); CPY_zp(FAC + 3);
+        if (BNE()) goto quotientBit;
+        LDY_zp(ARG + 4); CPY_zp(FAC + 4);
+    quotientBit:
+        PHP();
+        ROL_acc();
+        if (BCC()) goto nextBit;
+        INX();
+        STA_zpx(RESULT + 3);
+        if (BEQ()) goto lastBits;
+        if (BPL()) goto finish;
+        LDA_imm(1);
+    nextBit:
+        PLP();
+        if (BCS()) goto subtract;
+    shiftArg:
+        ASL_zp(ARG + 4); ROL_zp(ARG + 3); ROL_zp(ARG + 2); ROL_zp(ARG + 1);
+        if (BCS()) goto quotientBit;
+        if (BMI()) goto divide;
+        if (BPL()) goto quotientBit;
+    subtract:
+        TAY();
+        LDA_zp(ARG + 4); SBC_zp(FAC + 4); STA_zp(ARG + 4);
+        LDA_zp(ARG + 3); SBC_zp(FAC + 3); STA_zp(ARG + 3);
+        LDA_zp(ARG + 2); SBC_zp(FAC + 2); STA_zp(ARG + 2);
+        LDA_zp(ARG + 1); SBC_zp(FAC + 1); STA_zp(ARG + 1);
+        TYA();
+        JMP();
+        goto shiftArg;
+    lastBits:
+        LDA_imm(0x40);
+        if (BNE()) goto nextBit;
+    finish:
+        ASL_acc(); ASL_acc(); ASL_acc(); ASL_acc(); ASL_acc(); ASL_acc();
+        STA_zp(FAC_EXTENSION);
+        PLP();
+        JMP();
+        return copyResultToFac();
+    }
+
+    // ROUND.FAC ($EB72): fold FAC.EXTENSION into the mantissa
+    bool roundFac() {
+        LDA_zp(FAC);
+        if (BEQ()) goto done;
+        ASL_zp(FAC_EXTENSION);
+        if (BCC()) goto done;
+        JSR();
+        incrementMantissa();
+        if (BNE()) goto done;
+        JMP();
+        return shiftCarryIn();
+    done:
+        RTS();
+        return true;
+    }
+
+    // COPY.RESULT.INTO.FAC ($EAE6)
+    bool copyResultToFac() {
+        LDA_zp(RESULT); STA_zp(FAC + 1);
+        LDA_zp(RESULT + 1); STA_zp(FAC + 2);
+        LDA_zp(RESULT + 2); STA_zp(FAC + 3);
+        LDA_zp(RESULT + 3); STA_zp(FAC + 4);
+        JMP();
+        return normalize();
+    }
+
+    // COPY.ARG.TO.FAC ($EB53)
+    void copyArgToFac() {
+        LDA_zp(ARG_SIGN);
+        STA_zp(FAC_SIGN);
+        LDX_imm(5);
+        do {
+            LDA_zpx(ARG - 1);
+            STA_zpx(FAC - 1);
+            DEX();
+        } while (BNE());
+        STX_zp(FAC_EXTENSION);
+        RTS();
+    }
+
+    bool run(int routine) {
+        switch (routine) {
+        case FastMath::FSUB: JSR(); loadArg(); return fsubt();
+        case FastMath::FSUBT: return fsubt();
+        case FastMath::FADD: JSR(); loadArg(); return faddt();
+        case FastMath::FADDT: return faddt();
+        case FastMath::FMULT: JSR(); loadArg(); return fmultt();
+        case FastMath::FMULTT: return fmultt();
+        case FastMath::FDIV: JSR(); loadArg(); return fdivt();
+        case FastMath::FDIVT: return fdivt();
+        }
+        return false;
+    }
+};
+
+// ========== Hook ==========
+
+FastMath::FastMath() {
+    disable();
+}
+
+bool FastMath::anyEnabled() const {
+    for (int routine = 0; routine < ROUTINE_COUNT; routine++) {
+        if (enabled[routine]) return true;
+    }
+    return false;
+}
+
+void FastMath::disable() {
+    memset(enabled, 0, sizeof(enabled));
+}
+
+bool FastMath::execute(CPU6502& cpu) {
+    int routine = routineAt(cpu.regPC);
+    if (routine < 0 || !enabled[routine]) return false;
+
+    // Operands are read straight from memory, so none from I/O
+    if (takesOperand(routine)) {
+        uint32_t address = cpu.regA | (cpu.regY << 8);
+        if (address > 0xFFFB || !cpu.isPlainRAM(address, address + 5, CPU6502::PAGE_IO | CPU6502::PAGE_AUX)) {
+            return false;
+        }
+    }
+
+    uint8_t saved[0x100];
+    memcpy(saved, cpu.ram, sizeof(saved));
+
+    FloatUnit unit(cpu.regA, cpu.regX, cpu.regY, cpu.regP, cpu.ram, cpu.ram);
+    if (!unit.run(routine)) {
+        memcpy(cpu.ram, saved, sizeof(saved));
+        return false;
+    }
+
+    cpu.regA = unit.a;
+    cpu.regX = unit.x;
+    cpu.regY = unit.y;
+    cpu.regP = unit.p();
+    cpu.regPC = cpu.pullWord() + 1;
+    cpu.totalCycles += unit.cycles;
+    return true;
+}
+
+// ========== Verification ==========
+
+static const uint16_t OPERAND = 0x0300;         // Memory operands not in zero page
+static const uint16_t SENTINEL = 0x0000;        // Return address that ends a ROM run
+static const uint64_t ROM_CYCLE_LIMIT = 100000;
+
+namespace {
+
+struct CpuState {
+    uint8_t a, x, y, p, sp;
+    uint8_t zp[0x100];
+};
+
+struct Case {
+    CpuState in;
+    uint8_t operand[5];         // At OPERAND, when A,Y points there
+    CpuState native;
+    uint64_t nativeCycles;
+    bool done;
+};
+
+}
+
+static uint8_t randomExponent(std::mt19937& rng) {
+    switch (rng() % 8) {
+    case 0: return 0;                           // Zero
+    case 1: return rng() & 0xFF;                // Anywhere, including the extremes
+    default: return 0x70 + rng() % 0x20;        // Everyday magnitudes
+    }
+}
+
+// An unpacked number, as FAC and ARG hold them: normalized mantissa,
+// any byte for the sign (only its top bit counts)
+static void randomUnpacked(std::mt19937& rng, uint8_t* number) {
+    number[0] = randomExponent(rng);
+    for (int i = 1; i < 6; i++) number[i] = rng() & 0xFF;
+    if (number[0]) number[1] |= 0x80;
+}
+
+static Case randomCase(std::mt19937& rng, int routine) {
+    Case c = Case();
+    for (int i = 0; i < 0x100; i++) c.in.zp[i] = rng() & 0xFF;
+    c.in.a = rng() & 0xFF;
+    c.in.x = rng() & 0xFF;
+    c.in.y = rng() & 0xFF;
+    c.in.p = ((rng() & 0xFF) | CPU6502::FLAG_UNUSED) & ~CPU6502::FLAG_BREAK;
+    c.in.sp = 0x20 + rng() % 0xE0;
+
+    uint8_t* zp = c.in.zp;
+    randomUnpacked(rng, zp + FAC);
+    randomUnpacked(rng, zp + ARG);
+
+    // Close exponents and equal mantissas: alignment and cancellation
+    switch (rng() % 4) {
+    case 0:
+        zp[ARG] = zp[FAC] + rng() % 41 - 20;
+        if (zp[ARG]) zp[ARG + 1] |= 0x80;
+        break;
+    case 1:
+        zp[ARG] = zp[FAC];
+        memcpy(zp + ARG + 1, zp + FAC + 1, 3 + rng() % 2);
+        break;
+    }
+
+    if (takesOperand(routine)) {
+        // Packed: the sign in place of the mantissa's top bit, which is
+        // what LOAD.ARG.FROM.YA expects to find at A,Y
+        uint8_t packed[5];
+        packed[0] = zp[ARG];
+        packed[1] = (zp[ARG + 1] & 0x7F) | (zp[ARG_SIGN] & 0x80);
+        memcpy(packed + 2, zp + ARG + 2, 3);
+
+        static const uint16_t PLACES[] = {OPERAND, OPERAND, TEMP1, TEMP2, TEMP3};
+        uint16_t address = PLACES[rng() % 5];
+        if (address == OPERAND) {
+            memcpy(c.operand, packed, 5);
+        } else {
+            memcpy(zp + address, packed, 5);
+        }
+        c.in.a = address & 0xFF;
+        c.in.y = address >> 8;
+    } else {
+        // As the formula evaluator leaves them for the operator routines
+        zp[SGNCPR] = zp[FAC_SIGN] ^ zp[ARG_SIGN];
+        c.in.a = zp[FAC];
+        c.in.p &= ~(CPU6502::FLAG_ZERO | CPU6502::FLAG_NEGATIVE);
+        if (!c.in.a) c.in.p |= CPU6502::FLAG_ZERO;
+        if (c.in.a & 0x80) c.in.p |= CPU6502::FLAG_NEGATIVE;
+    }
+    return c;
+}
+
+static std::string hexBytes(const uint8_t* bytes, int length) {
+    std::ostringstream out;
+    out << std::hex << std::setfill('0');
+    for (int i = 0; i < length; i++) {
+        out << (i ? " " : "") << std::setw(2) << (int)bytes[i];
+    }
+    return out.str();
+}
+
+// The first difference between the native result and the ROM's, or ""
+static std::string difference(const Case& c, const CpuState& rom, uint64_t romCycles, bool operand) {
+    std::ostringstream out;
+    out << "FAC " << hexBytes(c.in.zp + FAC, 6) << " ext " << hexBytes(c.in.zp + FAC_EXTENSION, 1)
+        << ", ARG " << hexBytes(c.in.zp + ARG, 6);
+    if (operand && c.in.y == OPERAND >> 8) {
+        out << ", operand " << hexBytes(c.operand, 5);
+    } else if (operand) {
+        out << ", operand at $" << hexBytes(&c.in.a, 1) << " " << hexBytes(c.in.zp + c.in.a, 5);
+    }
+    out << ": ";
+
+    const CpuState& native = c.native;
+    static const char* const NAMES[] = {"A", "X", "Y", "P"};
+    const uint8_t mine[] = {native.a, native.x, native.y, native.p};
+    const uint8_t theirs[] = {rom.a, rom.x, rom.y, rom.p};
+    for (int i = 0; i < 4; i++) {
+        if (mine[i] != theirs[i]) {
+            out << NAMES[i] << " is $" << hexBytes(mine + i, 1) << ", ROM $" << hexBytes(theirs + i, 1);
+            return out.str();
+        }
+    }
+    for (int i = 0; i < 0x100; i++) {
+        if (native.zp[i] != rom.zp[i]) {
+            uint8_t address = i;
+            out << "$" << hexBytes(&address, 1) << " is $" << hexBytes(native.zp + i, 1)
+                << ", ROM $" << hexBytes(rom.zp + i, 1) << " (FAC now " << hexBytes(native.zp + FAC, 6)
+                << ", ROM " << hexBytes(rom.zp + FAC, 6) << ")";
+            return out.str();
+        }
+    }
+    if (c.nativeCycles != romCycles) {
+        out << "took " << c.nativeCycles << " cycles, ROM " << romCycles;
+        return out.str();
+    }
+    return "";
+}
+
+void FastMath::verify(CPU6502& cpu, int cases, uint32_t seed, Report reports[ROUTINE_COUNT]) {
+    typedef std::chrono::steady_clock Clock;
+
+    // Everything a run disturbs, to put back at the end
+    CpuState saved;
+    saved.a = cpu.regA;
+    saved.x = cpu.regX;
+    saved.y = cpu.regY;
+    saved.p = cpu.regP;
+    saved.sp = cpu.regSP;
+    memcpy(saved.zp, cpu.ram, sizeof(saved.zp));
+    uint16_t savedPC = cpu.regPC;
+    uint64_t savedCycles = cpu.totalCycles;
+    uint8_t savedStack[0x100];
+    memcpy(savedStack, cpu.ram + 0x100, sizeof(savedStack));
+    uint8_t savedOperand[5];
+    memcpy(savedOperand, cpu.ram + OPERAND, sizeof(savedOperand));
+    bool irq = cpu.irqRequested.exchange(false);
+    bool nmi = cpu.nmiRequested.exchange(false);
+    bool hooked = cpu.hooks.isEnabled();
+    cpu.hooks.setEnabled(false);        // The ROM runs must be the ROM's
+
+    disable();
+    std::mt19937 rng(seed);
+
+    for (int routine = 0; routine < ROUTINE_COUNT; routine++) {
+        Report& report = reports[routine];
+        report = Report();
+
+        std::vector<Case> corpus;
+        for (int i = 0; i < cases; i++) {
+            corpus.push_back(randomCase(rng, routine));
+        }
+
+        auto start = Clock::now();
+        for (Case& c : corpus) {
+            c.native = c.in;
+            memcpy(cpu.ram + OPERAND, c.operand, sizeof(c.operand));
+            FloatUnit unit(c.in.a, c.in.x, c.in.y, c.in.p, c.native.zp, cpu.ram);
+            c.done = unit.run(routine);
+            c.native.a = unit.a;
+            c.native.x = unit.x;
+            c.native.y = unit.y;
+            c.native.p = unit.p();
+            c.nativeCycles = unit.cycles;
+        }
+        report.nativeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for (Case& c : corpus) {
+            // An error inside the ROM would leave for BASIC's error handler
+            if (!c.done) {
+                report.skipped++;
+                continue;
+            }
+
+            memcpy(cpu.ram, c.in.zp, sizeof(c.in.zp));
+            memcpy(cpu.ram + OPERAND, c.operand, sizeof(c.operand));
+            cpu.regA = c.in.a;
+            cpu.regX = c.in.x;
+            cpu.regY = c.in.y;
+            cpu.regP = c.in.p;
+            cpu.regSP = c.in.sp;
+            cpu.pushWord(SENTINEL - 1);
+            cpu.regPC = ENTRY[routine];
+
+            uint64_t begin = cpu.totalCycles;
+            while (!(cpu.regPC == SENTINEL && cpu.regSP == c.in.sp) &&
+                   cpu.totalCycles - begin < ROM_CYCLE_LIMIT) {
+                cpu.executeInstruction();
+            }
+
+            CpuState rom;
+            rom.a = cpu.regA;
+            rom.x = cpu.regX;
+            rom.y = cpu.regY;
+            rom.p = cpu.regP;
+            memcpy(rom.zp, cpu.ram, sizeof(rom.zp));
+
+            report.cases++;
+            report.romCycles += cpu.totalCycles - begin;
+            report.nativeCycles += c.nativeCycles;
+
+            std::string diff;
+            if (cpu.regPC != SENTINEL || cpu.regSP != c.in.sp) {
+                diff = "the ROM did not return within " + std::to_string(ROM_CYCLE_LIMIT) + " cycles";
+            } else {
+                diff = difference(c, rom, cpu.totalCycles - begin, takesOperand(routine));
+            }
+            if (!diff.empty()) {
+                if (!report.mismatches) report.firstMismatch = diff;
+                report.mismatches++;
+            }
+        }
+        report.romSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        enabled[routine] = report.cases > 0 && report.mismatches == 0;
+    }
+
+    memcpy(cpu.ram, saved.zp, sizeof(saved.zp));
+    memcpy(cpu.ram + 0x100, savedStack, sizeof(savedStack));
+    memcpy(cpu.ram + OPERAND, savedOperand, sizeof(savedOperand));
+    cpu.regA = saved.a;
+    cpu.regX = saved.x;
+    cpu.regY = saved.y;
+    cpu.regP = saved.p;
+    cpu.regSP = saved.sp;
+    cpu.regPC = savedPC;
+    cpu.totalCycles = savedCycles;
+    if (irq) cpu.irqRequested = true;
+    if (nmi) cpu.nmiRequested = true;
+    cpu.hooks.setEnabled(hooked);
+}
+
+void FastMath::printReport(std::ostream& out, const Report reports[ROUTINE_COUNT]) {
+    for (int routine = 0; routine < ROUTINE_COUNT; routine++) {
+        const Report& report = reports[routine];
+        char line[160];
+        snprintf(line, sizeof(line), "%-6s $%04X  %6llu cases  %-8s", NAMES[routine], ENTRY[routine],
+                 (unsigned long long)report.cases, report.mismatches ? "MISMATCH" : (report.cases ? "exact" : "untested"));
+        out << line;
+        if (report.cases) {
+            double compared = (double)report.cases / (report.cases + report.skipped);
+            snprintf(line, sizeof(line), "  %5.0f cycles (ROM %5.0f)  %5.1fx faster",
+                     (double)report.nativeCycles / report.cases, (double)report.romCycles / report.cases,
+                     report.nativeSeconds > 0 ? report.romSeconds / (report.nativeSeconds * compared) : 0.0);
+            out << line;
+        }
+        if (report.mismatches) {
+            out << "\n    " << report.mismatches << " differ; first: " << report.firstMismatch;
+        }
+        out << "\n";
+    }
+}
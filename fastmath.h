@@ -0,0 +1,68 @@
+// fastmath.h - Native Applesoft floating point, hooked by PC
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+class CPU6502;
+
+// Host versions of the Applesoft ROM's arithmetic core: FADD, FSUB,
+// FMULT and FDIV, each at both its memory-operand entry (number at A,Y
+// into ARG first) and its ARG/FAC entry (FADDT, ...). Hooked at these
+// entry points (see hooks.h), the whole routine runs natively on
+// the real zero page (FAC, ARG, FAC.EXTENSION, the multiply/divide
+// scratch) and returns through the caller's RTS, charged the cycles the
+// interpreter would have charged.
+//
+// Each routine follows the ROM instruction for instruction (registers,
+// flags, every zero page byte), just without fetching and decoding them,
+// which is what makes it bit exact rather than close: SIN, LOG, EXP, SQR,
+// ^ and the rest go faster through the calls they make to these, and
+// round exactly as before. Nothing is trusted blind, though. verify()
+// runs each routine against the ROM actually loaded on a random corpus
+// and only routines that match it bit for bit are ever hooked. Errors
+// (?OVERFLOW, ?DIVISION BY ZERO) and operands outside plain RAM are left
+// to the ROM.
+class FastMath {
+public:
+    enum Routine {
+        FSUB, FSUBT, FADD, FADDT, FMULT, FMULTT, FDIV, FDIVT,
+        ROUTINE_COUNT
+    };
+    static const char* const NAMES[ROUTINE_COUNT];
+    static const uint16_t ENTRY[ROUTINE_COUNT];
+
+    struct Report {
+        uint64_t cases = 0;             // Inputs compared
+        uint64_t skipped = 0;           // Errors, which the ROM handles anyway
+        uint64_t mismatches = 0;
+        uint64_t romCycles = 0;         // Summed over the compared cases
+        uint64_t nativeCycles = 0;
+        double romSeconds = 0;
+        double nativeSeconds = 0;
+        std::string firstMismatch;
+    };
+
+    FastMath();
+
+    // Compare every routine with the ROM in `cpu` on `cases` random
+    // inputs, then enable exactly the ones that matched. The CPU's
+    // registers, zero page and stack page are put back afterwards.
+    void verify(CPU6502& cpu, int cases, uint32_t seed, Report reports[ROUTINE_COUNT]);
+    static void printReport(std::ostream& out, const Report reports[ROUTINE_COUNT]);
+
+    bool isEnabled(int routine) const { return enabled[routine]; }
+    bool anyEnabled() const;
+    void disable();
+
+    // At an entry point: run the routine and return as its RTS would.
+    // False leaves the CPU untouched, for the ROM to run instead.
+    bool execute(CPU6502& cpu);
+
+private:
+    bool enabled[ROUTINE_COUNT];
+};
+
+#endif
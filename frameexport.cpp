@@ -0,0 +1,258 @@
+#include "frameexport.h"
+#include <algorithm>
+#include <csignal>
+#include <iostream>
+#include <unistd.h>
+#include <zlib.h>
+
+FrameExporter::FrameExporter()
+    : stream(nullptr), streaming(false), lastStreamed(0), nextSnapshot(0),
+      head(0), tail(0), stopping(false), dropped(0), repeated(0) {
+  // Exported frames are timed by the emulation, not the host clock
+  renderer.setFrameClock(true);
+}
+
+FrameExporter::~FrameExporter() {
+  stop();
+}
+
+// ========== Setup ==========
+
+bool FrameExporter::openStream(const std::string &path) {
+  if (path == "-") {
+    // The stream takes over stdout; anything else printed goes to stderr
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    stream = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  } else {
+    stream = fopen(path.c_str(), "wb");
+  }
+  if (!stream) {
+    std::cerr << "Error: Cannot write " << path << "\n";
+    return false;
+  }
+
+  // A reader that goes away shows up as a failed write, not a signal
+  signal(SIGPIPE, SIG_IGN);
+
+  if (!writeY4MHeader(stream, AppleIIVideo::HIRES_WIDTH, AppleIIVideo::HIRES_HEIGHT)) {
+    std::cerr << "Error: Cannot write video stream header\n";
+    return false;
+  }
+  streaming = true;
+  return true;
+}
+
+void FrameExporter::addSnapshot(uint64_t cycle, const std::string &path) {
+  Snapshot snapshot = {cycle, path};
+  auto at = std::upper_bound(snapshots.begin(), snapshots.end(), snapshot,
+                             [](const Snapshot &a, const Snapshot &b) { return a.cycle < b.cycle; });
+  snapshots.insert(at, snapshot);
+}
+
+void FrameExporter::start() {
+  if (isActive() && !worker.joinable()) {
+    worker = std::thread(&FrameExporter::run, this);
+  }
+}
+
+void FrameExporter::stop() {
+  if (worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(wakeLock);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+  }
+
+  if (stream) {
+    fclose(stream);
+    stream = nullptr;
+  }
+
+  if (dropped || repeated) {
+    debugLog << "Frame export: " << dropped << " frames dropped, " << repeated
+             << " repeated in the stream\n";
+  }
+  for (size_t i = nextSnapshot; i < snapshots.size(); i++) {
+    std::cerr << "Warning: Snapshot " << snapshots[i].path << " not taken (cycle "
+              << snapshots[i].cycle << " not reached)\n";
+  }
+  nextSnapshot = snapshots.size();
+}
+
+// ========== CPU Thread ==========
+
+void FrameExporter::submit(const VideoFrame &frame, uint64_t cycles) {
+  bool due = nextSnapshot < snapshots.size() && cycles >= snapshots[nextSnapshot].cycle;
+  if (!streaming && !due) return;
+
+  // A due snapshot stays due until a slot frees up
+  if (isBacklogged()) {
+    dropped++;
+    return;
+  }
+
+  unsigned t = tail.load(std::memory_order_relaxed);
+  Job &job = jobs[t & (QUEUE_FRAMES - 1)];
+  job.frame = frame;
+  job.cycles = cycles;
+  job.streamed = streaming;
+  job.snapshots.clear();
+  while (nextSnapshot < snapshots.size() && cycles >= snapshots[nextSnapshot].cycle) {
+    job.snapshots.push_back(snapshots[nextSnapshot++].path);
+  }
+  tail.store(t + 1, std::memory_order_release);
+
+  // Take the lock so a worker between "empty" and "sleep" sees the job
+  { std::lock_guard<std::mutex> guard(wakeLock); }
+  wake.notify_one();
+}
+
+// ========== Worker ==========
+
+void FrameExporter::run() {
+  while (true) {
+    unsigned h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      std::unique_lock<std::mutex> lock(wakeLock);
+      if (stopping && h == tail.load(std::memory_order_acquire)) return;
+      wake.wait(lock, [&] { return stopping || h != tail.load(std::memory_order_acquire); });
+      continue;
+    }
+
+    process(jobs[h & (QUEUE_FRAMES - 1)]);
+    head.store(h + 1, std::memory_order_release);
+  }
+}
+
+void FrameExporter::process(Job &job) {
+  const int width = AppleIIVideo::HIRES_WIDTH;
+  const int height = AppleIIVideo::HIRES_HEIGHT;
+
+  // Frames dropped on the way in are stood in for by the last one written
+  if (job.streamed && stream && lastStreamed) {
+    for (uint64_t seq = lastStreamed + 1; seq < job.frame.sequence; seq++) {
+      writeY4MFrame(stream, renderer.frameBuffer, width, height);
+      repeated++;
+    }
+  }
+
+  renderer.showFrame(job.frame);
+  renderer.render();
+
+  if (job.streamed && stream) {
+    if (!writeY4MFrame(stream, renderer.frameBuffer, width, height)) {
+      std::cerr << "Error: Video stream write failed; stream closed\n";
+      fclose(stream);
+      stream = nullptr;
+    }
+    lastStreamed = job.frame.sequence;
+  }
+
+  for (const std::string &path : job.snapshots) {
+    std::string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    bool ok = ext == ".png" ? writePNG(path, renderer.frameBuffer, width, height)
+                            : writePPM(path, renderer.frameBuffer, width, height);
+    if (ok) {
+      debugLog << "Snapshot at cycle " << job.cycles << ": " << path << "\n";
+    } else {
+      std::cerr << "Error: Cannot write " << path << "\n";
+    }
+  }
+}
+
+// ========== Encoders ==========
+
+bool FrameExporter::writePPM(const std::string &path, const uint32_t *pixels, int width, int height) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) return false;
+
+  std::vector<uint8_t> rgb(width * height * 3);
+  for (int i = 0; i < width * height; i++) {
+    rgb[i * 3] = pixels[i] >> 16;
+    rgb[i * 3 + 1] = pixels[i] >> 8;
+    rgb[i * 3 + 2] = pixels[i];
+  }
+
+  bool ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0 &&
+            fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+  return fclose(file) == 0 && ok;
+}
+
+static void putBE32(std::vector<uint8_t> &out, uint32_t value) {
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+// Length, type, data, then a CRC over type and data
+static void pngChunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data, size_t size) {
+  putBE32(out, size);
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + size);
+  putBE32(out, crc32(0, out.data() + start, size + 4));
+}
+
+bool FrameExporter::writePNG(const std::string &path, const uint32_t *pixels, int width, int height) {
+  // 8-bit RGB rows, each prefixed with filter type 0 (none)
+  std::vector<uint8_t> raw;
+  raw.reserve(height * (1 + width * 3));
+  for (int y = 0; y < height; y++) {
+    raw.push_back(0);
+    for (int x = 0; x < width; x++) {
+      uint32_t pixel = pixels[y * width + x];
+      raw.push_back(pixel >> 16);
+      raw.push_back(pixel >> 8);
+      raw.push_back(pixel);
+    }
+  }
+
+  uLongf packedSize = compressBound(raw.size());
+  std::vector<uint8_t> packed(packedSize);
+  if (compress2(packed.data(), &packedSize, raw.data(), raw.size(), Z_BEST_COMPRESSION) != Z_OK) {
+    return false;
+  }
+
+  std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  std::vector<uint8_t> header;
+  putBE32(header, width);
+  putBE32(header, height);
+  header.insert(header.end(), {8, 2, 0, 0, 0});  // Depth 8, RGB, deflate, no filter, progressive
+  pngChunk(png, "IHDR", header.data(), header.size());
+  pngChunk(png, "IDAT", packed.data(), packedSize);
+  pngChunk(png, "IEND", nullptr, 0);
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) return false;
+  bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+  return fclose(file) == 0 && ok;
+}
+
+bool FrameExporter::writeY4MHeader(FILE *file, int width, int height) {
+  return fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, FRAME_RATE) > 0;
+}
+
+// BT.601 studio range, full-resolution chroma
+bool FrameExporter::writeY4MFrame(FILE *file, const uint32_t *pixels, int width, int height) {
+  int count = width * height;
+  std::vector<uint8_t> planes(count * 3);
+  uint8_t *yPlane = planes.data();
+  uint8_t *uPlane = yPlane + count;
+  uint8_t *vPlane = uPlane + count;
+  for (int i = 0; i < count; i++) {
+    int r = (pixels[i] >> 16) & 0xFF;
+    int g = (pixels[i] >> 8) & 0xFF;
+    int b = pixels[i] & 0xFF;
+    yPlane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    uPlane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    vPlane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+  }
+
+  return fputs("FRAME\n", file) >= 0 && fwrite(planes.data(), 1, planes.size(), file) == planes.size();
+}
@@ -0,0 +1,94 @@
+// frameexport.h - Headless frame snapshots (PPM/PNG) and Y4M video streams
+#ifndef FRAMEEXPORT_H
+#define FRAMEEXPORT_H
+
+#include "ppu.h"
+#include "videoframe.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Renders published frames into an in-memory framebuffer and writes them
+// out on a worker thread:
+//   snapshots - one PPM (or PNG, by extension) at the first frame that
+//               ends at or after a chosen CPU cycle
+//   stream    - every frame as uncompressed YUV4MPEG2 (4:4:4, BT.601),
+//               to a file or a pipe, for encoding offline
+// The CPU thread only copies the frame into a free queue slot; rendering,
+// colour conversion and I/O all happen on the worker. If the queue is
+// full the frame is dropped, and the stream repeats the previous frame in
+// its place so its timing stays right.
+class FrameExporter {
+public:
+  static const unsigned QUEUE_FRAMES = 8;   // Power of two
+  static const int FRAME_RATE = 60;
+
+  FrameExporter();
+  ~FrameExporter();
+
+  // Setup, before start()
+  void setPalette(AppleIIVideo::Palette palette) { renderer.setPalette(palette); }
+  bool openStream(const std::string &path);         // "-" takes over stdout
+  void addSnapshot(uint64_t cycle, const std::string &path);
+  bool isActive() const { return streaming || !snapshots.empty(); }
+  void start();
+
+  // CPU thread, after each frame. Queues the frame if the stream or a
+  // due snapshot wants it; never waits.
+  void submit(const VideoFrame &frame, uint64_t cycles);
+  bool isBacklogged() const {
+    return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) == QUEUE_FRAMES;
+  }
+  bool snapshotsDone() const { return nextSnapshot == snapshots.size(); }
+
+  // Drain the queue, close the stream and join the worker
+  void stop();
+
+  // Encoders; `pixels` are 0xAARRGGBB, `width` * `height`
+  static bool writePPM(const std::string &path, const uint32_t *pixels, int width, int height);
+  static bool writePNG(const std::string &path, const uint32_t *pixels, int width, int height);
+  static bool writeY4MHeader(FILE *file, int width, int height);
+  static bool writeY4MFrame(FILE *file, const uint32_t *pixels, int width, int height);
+
+private:
+  struct Job {
+    VideoFrame frame;
+    uint64_t cycles;
+    bool streamed;                   // Part of the stream (else a snapshot only)
+    std::vector<std::string> snapshots;
+  };
+
+  struct Snapshot {
+    uint64_t cycle;
+    std::string path;
+  };
+
+  AppleIIVideo renderer;             // Worker only
+  FILE *stream;                      // Worker only once started
+  bool streaming;                    // Fixed before start()
+  uint64_t lastStreamed;             // Sequence of the last frame written
+  std::vector<Snapshot> snapshots;   // Sorted by cycle
+  size_t nextSnapshot;               // CPU thread only
+
+  // SPSC ring, as KeyQueue: the CPU thread writes `tail`, the worker `head`
+  Job jobs[QUEUE_FRAMES];
+  std::atomic<unsigned> head;        // Next job to process
+  std::atomic<unsigned> tail;        // Next free slot
+  std::mutex wakeLock;
+  std::condition_variable wake;
+
+  std::thread worker;
+  std::atomic<bool> stopping;
+  uint64_t dropped;                  // CPU thread only
+  uint64_t repeated;                 // Worker only
+
+  void run();
+  void process(Job &job);
+};
+
+#endif
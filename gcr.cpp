@@ -0,0 +1,337 @@
+#include "gcr.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GCR_X86 1
+#endif
+
+// 6-bit value -> disk nibble
+const uint8_t GcrCodec::ENCODE_TABLE[64] = {
+    0x96, 0x97, 0x9A, 0x9B, 0x9D, 0x9E, 0x9F, 0xA6,
+    0xA7, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF, 0xB2, 0xB3,
+    0xB4, 0xB5, 0xB6, 0xB7, 0xB9, 0xBA, 0xBB, 0xBC,
+    0xBD, 0xBE, 0xBF, 0xCB, 0xCD, 0xCE, 0xCF, 0xD3,
+    0xD6, 0xD7, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE,
+    0xDF, 0xE5, 0xE6, 0xE7, 0xE9, 0xEA, 0xEB, 0xEC,
+    0xED, 0xEE, 0xEF, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6,
+    0xF7, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
+};
+
+// Disk nibble -> 6-bit value (0xFF = not a valid data nibble)
+const uint8_t GcrCodec::DECODE_TABLE[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x01, 0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x04, 0x05, 0x06,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x08, 0xFF, 0xFF, 0xFF, 0x09, 0x0A, 0x0B, 0x0C, 0x0D,
+    0xFF, 0xFF, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0xFF, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x1B, 0xFF, 0x1C, 0x1D, 0x1E,
+    0xFF, 0xFF, 0xFF, 0x1F, 0xFF, 0xFF, 0x20, 0x21, 0xFF, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x29, 0x2A, 0x2B, 0xFF, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32,
+    0xFF, 0xFF, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0xFF, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+};
+
+// The two low bits of each byte are stored swapped in the auxiliary buffer.
+// The swap is its own inverse, so the same table serves both directions.
+static const uint8_t SWAP_BITS[4] = {0, 2, 1, 3};
+
+// Working buffers are padded to a whole number of 32-byte vectors
+static const int PADDED_BYTES = 352;
+
+enum SimdLevel { SIMD_SCALAR = 0, SIMD_SSSE3 = 1, SIMD_AVX2 = 2 };
+
+static int detectSimdLevel() {
+#ifdef GCR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("ssse3")) return SIMD_SSSE3;
+#endif
+    return SIMD_SCALAR;
+}
+
+static const int detectedLevel = detectSimdLevel();
+static int activeLevel = detectedLevel;
+
+// ========== Scalar paths ==========
+
+// values[k] -> nibbles[k] = ENCODE_TABLE[values[k] ^ values[k-1]]
+static void encodeValuesScalar(const uint8_t* values, uint8_t* nibbles) {
+    uint8_t last = 0;
+    for (int k = 0; k < GcrCodec::DATA_BYTES; k++) {
+        nibbles[k] = GcrCodec::ENCODE_TABLE[values[k] ^ last];
+        last = values[k];
+    }
+}
+
+// Returns false if any nibble is not a valid GCR data nibble
+static bool decodeValuesScalar(const uint8_t* nibbles, uint8_t* values) {
+    uint8_t last = 0;
+    uint8_t invalid = 0;
+    for (int k = 0; k < GcrCodec::DATA_BYTES; k++) {
+        uint8_t d = GcrCodec::DECODE_TABLE[nibbles[k]];
+        invalid |= (d == GcrCodec::INVALID);
+        last ^= (d & 0x3F);
+        values[k] = last;
+    }
+    return invalid == 0;
+}
+
+// ========== SSSE3 / AVX2 paths ==========
+//
+// Encoding is a chained XOR followed by a 64-entry lookup. The XOR with the
+// previous value is data-parallel (load the same buffer one byte behind) and
+// the lookup is four 16-entry PSHUFB tables selected by the top two bits.
+// Decoding uses eight PSHUFB tables over the upper half of DECODE_TABLE
+// (every valid nibble has bit 7 set) and then a log-step prefix XOR.
+
+#ifdef GCR_X86
+
+__attribute__((target("ssse3")))
+static void encodeValuesSSSE3(const uint8_t* values, uint8_t* nibbles) {
+    alignas(16) uint8_t in[16 + PADDED_BYTES] = {0};
+    alignas(16) uint8_t out[PADDED_BYTES];
+    memcpy(in + 16, values, GcrCodec::DATA_BYTES);
+
+    const __m128i lowMask = _mm_set1_epi8(0x0F);
+    __m128i tables[4];
+    for (int t = 0; t < 4; t++) {
+        tables[t] = _mm_loadu_si128((const __m128i*)(GcrCodec::ENCODE_TABLE + t * 16));
+    }
+
+    for (int k = 0; k < PADDED_BYTES; k += 16) {
+        __m128i cur = _mm_load_si128((const __m128i*)(in + 16 + k));
+        __m128i prev = _mm_loadu_si128((const __m128i*)(in + 15 + k));
+        __m128i x = _mm_xor_si128(cur, prev);
+        __m128i lo = _mm_and_si128(x, lowMask);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), lowMask);
+        __m128i r = _mm_setzero_si128();
+        for (int t = 0; t < 4; t++) {
+            __m128i sel = _mm_cmpeq_epi8(hi, _mm_set1_epi8((char)t));
+            r = _mm_or_si128(r, _mm_and_si128(sel, _mm_shuffle_epi8(tables[t], lo)));
+        }
+        _mm_store_si128((__m128i*)(out + k), r);
+    }
+    memcpy(nibbles, out, GcrCodec::DATA_BYTES);
+}
+
+__attribute__((target("ssse3")))
+static bool decodeValuesSSSE3(const uint8_t* nibbles, uint8_t* values) {
+    alignas(16) uint8_t in[PADDED_BYTES];
+    alignas(16) uint8_t out[PADDED_BYTES];
+    memcpy(in, nibbles, GcrCodec::DATA_BYTES);
+    memset(in + GcrCodec::DATA_BYTES, 0x96, PADDED_BYTES - GcrCodec::DATA_BYTES);  // decodes to 0
+
+    const __m128i lowMask = _mm_set1_epi8(0x0F);
+    const __m128i lastByte = _mm_set1_epi8(15);
+    __m128i tables[8];
+    for (int t = 0; t < 8; t++) {
+        tables[t] = _mm_loadu_si128((const __m128i*)(GcrCodec::DECODE_TABLE + 128 + t * 16));
+    }
+
+    __m128i bad = _mm_setzero_si128();
+    __m128i carry = _mm_setzero_si128();
+    for (int k = 0; k < PADDED_BYTES; k += 16) {
+        __m128i x = _mm_load_si128((const __m128i*)(in + k));
+        __m128i lo = _mm_and_si128(x, lowMask);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi8(0x07));
+        __m128i d = _mm_setzero_si128();
+        for (int t = 0; t < 8; t++) {
+            __m128i sel = _mm_cmpeq_epi8(hi, _mm_set1_epi8((char)t));
+            d = _mm_or_si128(d, _mm_and_si128(sel, _mm_shuffle_epi8(tables[t], lo)));
+        }
+        d = _mm_or_si128(d, _mm_cmpgt_epi8(x, _mm_set1_epi8(-1)));  // bit 7 clear: invalid
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(d, _mm_set1_epi8((char)0xFF)));
+        d = _mm_and_si128(d, _mm_set1_epi8(0x3F));
+
+        d = _mm_xor_si128(d, _mm_slli_si128(d, 1));
+        d = _mm_xor_si128(d, _mm_slli_si128(d, 2));
+        d = _mm_xor_si128(d, _mm_slli_si128(d, 4));
+        d = _mm_xor_si128(d, _mm_slli_si128(d, 8));
+        d = _mm_xor_si128(d, carry);
+        carry = _mm_shuffle_epi8(d, lastByte);
+        _mm_store_si128((__m128i*)(out + k), d);
+    }
+    memcpy(values, out, GcrCodec::DATA_BYTES);
+    return _mm_movemask_epi8(bad) == 0;
+}
+
+__attribute__((target("avx2")))
+static void encodeValuesAVX2(const uint8_t* values, uint8_t* nibbles) {
+    alignas(32) uint8_t in[32 + PADDED_BYTES] = {0};
+    alignas(32) uint8_t out[PADDED_BYTES];
+    memcpy(in + 32, values, GcrCodec::DATA_BYTES);
+
+    const __m256i lowMask = _mm256_set1_epi8(0x0F);
+    __m256i tables[4];
+    for (int t = 0; t < 4; t++) {
+        tables[t] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)(GcrCodec::ENCODE_TABLE + t * 16)));
+    }
+
+    for (int k = 0; k < PADDED_BYTES; k += 32) {
+        __m256i cur = _mm256_load_si256((const __m256i*)(in + 32 + k));
+        __m256i prev = _mm256_loadu_si256((const __m256i*)(in + 31 + k));
+        __m256i x = _mm256_xor_si256(cur, prev);
+        __m256i lo = _mm256_and_si256(x, lowMask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), lowMask);
+        __m256i r = _mm256_setzero_si256();
+        for (int t = 0; t < 4; t++) {
+            __m256i sel = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char)t));
+            r = _mm256_or_si256(r, _mm256_and_si256(sel, _mm256_shuffle_epi8(tables[t], lo)));
+        }
+        _mm256_store_si256((__m256i*)(out + k), r);
+    }
+    memcpy(nibbles, out, GcrCodec::DATA_BYTES);
+}
+
+__attribute__((target("avx2")))
+static bool decodeValuesAVX2(const uint8_t* nibbles, uint8_t* values) {
+    alignas(32) uint8_t in[PADDED_BYTES];
+    alignas(32) uint8_t out[PADDED_BYTES];
+    memcpy(in, nibbles, GcrCodec::DATA_BYTES);
+    memset(in + GcrCodec::DATA_BYTES, 0x96, PADDED_BYTES - GcrCodec::DATA_BYTES);
+
+    const __m256i lowMask = _mm256_set1_epi8(0x0F);
+    const __m256i lastByte = _mm256_set1_epi8(15);
+    __m256i tables[8];
+    for (int t = 0; t < 8; t++) {
+        tables[t] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)(GcrCodec::DECODE_TABLE + 128 + t * 16)));
+    }
+
+    __m256i bad = _mm256_setzero_si256();
+    __m256i carry = _mm256_setzero_si256();
+    for (int k = 0; k < PADDED_BYTES; k += 32) {
+        __m256i x = _mm256_load_si256((const __m256i*)(in + k));
+        __m256i lo = _mm256_and_si256(x, lowMask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x07));
+        __m256i d = _mm256_setzero_si256();
+        for (int t = 0; t < 8; t++) {
+            __m256i sel = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char)t));
+            d = _mm256_or_si256(d, _mm256_and_si256(sel, _mm256_shuffle_epi8(tables[t], lo)));
+        }
+        d = _mm256_or_si256(d, _mm256_cmpgt_epi8(x, _mm256_set1_epi8(-1)));
+        bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(d, _mm256_set1_epi8((char)0xFF)));
+        d = _mm256_and_si256(d, _mm256_set1_epi8(0x3F));
+
+        // Prefix XOR within each 128-bit lane...
+        d = _mm256_xor_si256(d, _mm256_slli_si256(d, 1));
+        d = _mm256_xor_si256(d, _mm256_slli_si256(d, 2));
+        d = _mm256_xor_si256(d, _mm256_slli_si256(d, 4));
+        d = _mm256_xor_si256(d, _mm256_slli_si256(d, 8));
+        // ...then fold the low lane's total into the high lane
+        __m256i laneTotals = _mm256_shuffle_epi8(d, lastByte);
+        d = _mm256_xor_si256(d, _mm256_permute2x128_si256(laneTotals, laneTotals, 0x08));
+        d = _mm256_xor_si256(d, carry);
+        __m256i totals = _mm256_shuffle_epi8(d, lastByte);
+        carry = _mm256_permute2x128_si256(totals, totals, 0x11);
+        _mm256_store_si256((__m256i*)(out + k), d);
+    }
+    memcpy(values, out, GcrCodec::DATA_BYTES);
+    return _mm256_movemask_epi8(bad) == 0;
+}
+
+#endif
+
+// ========== Public interface ==========
+
+void GcrCodec::splitSector(const uint8_t* sector, uint8_t* values) {
+    // Auxiliary value k holds the low bits of bytes k, k+86 and k+172
+    for (int k = 0; k < AUX_BYTES; k++) {
+        values[k] = SWAP_BITS[sector[k] & 0x03] |
+                    (SWAP_BITS[sector[k + 86] & 0x03] << 2) |
+                    (SWAP_BITS[sector[(k + 172) & 0xFF] & 0x03] << 4);
+    }
+    for (int i = 0; i < SECTOR_BYTES; i++) {
+        values[AUX_BYTES + i] = sector[i] >> 2;
+    }
+}
+
+void GcrCodec::joinSector(const uint8_t* values, uint8_t* sector) {
+    const uint8_t* aux = values;
+    const uint8_t* high = values + AUX_BYTES;
+    for (int i = 0; i < 86; i++) {
+        sector[i] = (high[i] << 2) | SWAP_BITS[aux[i] & 0x03];
+    }
+    for (int i = 86; i < 172; i++) {
+        sector[i] = (high[i] << 2) | SWAP_BITS[(aux[i - 86] >> 2) & 0x03];
+    }
+    for (int i = 172; i < 256; i++) {
+        sector[i] = (high[i] << 2) | SWAP_BITS[(aux[i - 172] >> 4) & 0x03];
+    }
+}
+
+void GcrCodec::encodeSector(const uint8_t* sector, uint8_t* nibbles) {
+    uint8_t values[DATA_BYTES];
+    splitSector(sector, values);
+
+    switch (activeLevel) {
+#ifdef GCR_X86
+        case SIMD_AVX2:  encodeValuesAVX2(values, nibbles); break;
+        case SIMD_SSSE3: encodeValuesSSSE3(values, nibbles); break;
+#endif
+        default:         encodeValuesScalar(values, nibbles); break;
+    }
+
+    // Checksum nibble is the last value itself
+    nibbles[DATA_BYTES] = ENCODE_TABLE[values[DATA_BYTES - 1]];
+}
+
+bool GcrCodec::decodeSector(const uint8_t* nibbles, uint8_t* sector) {
+    uint8_t values[DATA_BYTES];
+    bool valid;
+
+    switch (activeLevel) {
+#ifdef GCR_X86
+        case SIMD_AVX2:  valid = decodeValuesAVX2(nibbles, values); break;
+        case SIMD_SSSE3: valid = decodeValuesSSSE3(nibbles, values); break;
+#endif
+        default:         valid = decodeValuesScalar(nibbles, values); break;
+    }
+
+    joinSector(values, sector);
+    return valid && DECODE_TABLE[nibbles[DATA_BYTES]] == values[DATA_BYTES - 1];
+}
+
+void GcrCodec::encodeSectors(const uint8_t* sectors, uint8_t* nibbles, int count) {
+    for (int s = 0; s < count; s++) {
+        encodeSector(sectors + s * SECTOR_BYTES, nibbles + s * DATA_NIBBLES);
+    }
+}
+
+int GcrCodec::decodeSectors(const uint8_t* nibbles, uint8_t* sectors, int count) {
+    int errors = 0;
+    for (int s = 0; s < count; s++) {
+        if (!decodeSector(nibbles + s * DATA_NIBBLES, sectors + s * SECTOR_BYTES)) {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+const char* GcrCodec::simdLevel() {
+    switch (activeLevel) {
+        case SIMD_AVX2:  return "avx2";
+        case SIMD_SSSE3: return "ssse3";
+        default:         return "scalar";
+    }
+}
+
+void GcrCodec::setScalarOnly(bool scalarOnly) {
+    activeLevel = scalarOnly ? SIMD_SCALAR : detectedLevel;
+}
+
+bool GcrCodec::setSimdLevel(const char* name) {
+    int level = strcmp(name, "avx2") == 0 ? SIMD_AVX2 : strcmp(name, "ssse3") == 0 ? SIMD_SSSE3 :
+                strcmp(name, "scalar") == 0 ? SIMD_SCALAR : -1;
+    if (level < 0 || level > detectedLevel) return false;
+    activeLevel = level;
+    return true;
+}
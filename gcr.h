@@ -0,0 +1,57 @@
+// gcr.h - GCR 6-and-2 sector codec (table-driven, with SSSE3/AVX2 paths)
+#ifndef GCR_H
+#define GCR_H
+
+#include <cstdint>
+
+class GcrCodec {
+public:
+    static const int SECTOR_BYTES = 256;
+    static const int AUX_BYTES = 86;                              // 2-bit remainders
+    static const int DATA_BYTES = AUX_BYTES + SECTOR_BYTES;       // 342 6-bit values
+    static const int DATA_NIBBLES = DATA_BYTES + 1;               // + checksum = 343
+    static const int TRACK_SECTORS = 16;
+    static const uint8_t INVALID = 0xFF;                          // DECODE_TABLE miss
+
+    // 6-bit value -> disk nibble, and the inverse (INVALID for non-GCR bytes)
+    static const uint8_t ENCODE_TABLE[64];
+    static const uint8_t DECODE_TABLE[256];
+
+    // Encode one 256-byte sector into the 343 nibbles of its data field
+    // (prologue and epilogue are left to the caller).
+    static void encodeSector(const uint8_t* sector, uint8_t* nibbles);
+
+    // Decode 343 data field nibbles. Returns false on an invalid nibble or
+    // a checksum mismatch; `sector` is filled in either way.
+    static bool decodeSector(const uint8_t* nibbles, uint8_t* sector);
+
+    // Whole-track variants: `count` consecutive sectors / data fields,
+    // each data field DATA_NIBBLES long. decodeSectors returns the number
+    // of sectors that failed to decode.
+    static void encodeSectors(const uint8_t* sectors, uint8_t* nibbles, int count);
+    static int decodeSectors(const uint8_t* nibbles, uint8_t* sectors, int count);
+
+    // 4-and-4 encoding used by address fields
+    static void encode44(uint8_t value, uint8_t* nibbles) {
+        nibbles[0] = (value >> 1) | 0xAA;
+        nibbles[1] = value | 0xAA;
+    }
+    static uint8_t decode44(const uint8_t* nibbles) {
+        return ((nibbles[0] << 1) | 1) & nibbles[1];
+    }
+
+    // Name of the code path selected at startup ("avx2", "ssse3" or "scalar")
+    static const char* simdLevel();
+
+    // Force the scalar path (used when comparing implementations)
+    static void setScalarOnly(bool scalarOnly);
+
+    // Select a path by name; false if this CPU lacks it
+    static bool setSimdLevel(const char* name);
+
+private:
+    static void splitSector(const uint8_t* sector, uint8_t* values);
+    static void joinSector(const uint8_t* values, uint8_t* sector);
+};
+
+#endif
@@ -0,0 +1,188 @@
+// gcrtest.cpp - GcrCodec checks against the original DiskII encoder
+#include "gcr.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+static const char *const LEVELS[] = {"scalar", "ssse3", "avx2"};
+
+// The 6-and-2 data field encoder DiskII used before GcrCodec
+// (DiskII::encode62 and the loop of DiskII::writeDataField), kept as
+// the reference the codec must match byte for byte
+static void referenceEncode(const uint8_t *sector, uint8_t *nibbles) {
+  static const int SWAP_BIT[4] = {0, 2, 1, 3};
+  uint8_t buffer[256];
+  uint8_t buffer2[86];
+
+  buffer2[0] = SWAP_BIT[sector[1] & 0x03];
+  buffer2[1] = SWAP_BIT[sector[0] & 0x03];
+  for (int i = 255, j = 2; i >= 0; i--, j = (j == 85) ? 0 : j + 1) {
+    buffer2[j] = ((buffer2[j] << 2) | SWAP_BIT[sector[i] & 0x03]);
+    buffer[i] = (sector[i] >> 2);
+  }
+  for (int i = 0; i < 86; i++) {
+    buffer2[i] &= 0x3f;
+  }
+
+  uint8_t last = 0;
+  int pos = 0;
+  for (int i = 0x55; i >= 0; i--) {
+    nibbles[pos++] = GcrCodec::ENCODE_TABLE[last ^ buffer2[i]];
+    last = buffer2[i];
+  }
+  for (int i = 0; i < 256; i++) {
+    nibbles[pos++] = GcrCodec::ENCODE_TABLE[last ^ buffer[i]];
+    last = buffer[i];
+  }
+  nibbles[pos++] = GcrCodec::ENCODE_TABLE[last];
+}
+
+// Random bytes, or now and then one of the patterns real disks are full of
+static void makeSector(std::mt19937 &rng, int n, uint8_t *sector) {
+  switch (n % 8) {
+    case 0:
+      memset(sector, rng() & 0xFF, GcrCodec::SECTOR_BYTES);
+      break;
+    case 1:
+      for (int i = 0; i < GcrCodec::SECTOR_BYTES; i++) sector[i] = i + n;
+      break;
+    default:
+      for (int i = 0; i < GcrCodec::SECTOR_BYTES; i++) sector[i] = rng();
+      break;
+  }
+}
+
+static int failures = 0;
+
+static void fail(const char *level, int n, const char *what) {
+  if (failures++ < 10) {
+    printf("  %s case %d: %s\n", level, n, what);
+  }
+}
+
+static void check(const char *level, int cases, uint32_t seed) {
+  std::mt19937 rng(seed);
+  uint8_t sector[GcrCodec::SECTOR_BYTES];
+  uint8_t decoded[GcrCodec::SECTOR_BYTES];
+  uint8_t expected[GcrCodec::SECTOR_BYTES];
+  uint8_t reference[GcrCodec::DATA_NIBBLES];
+  uint8_t nibbles[GcrCodec::DATA_NIBBLES];
+
+  for (int n = 0; n < cases; n++) {
+    makeSector(rng, n, sector);
+    referenceEncode(sector, reference);
+    GcrCodec::encodeSector(sector, nibbles);
+    if (memcmp(nibbles, reference, sizeof(nibbles)) != 0) {
+      fail(level, n, "encoding differs from the reference");
+      continue;
+    }
+    if (!GcrCodec::decodeSector(nibbles, decoded) || memcmp(decoded, sector, sizeof(sector)) != 0) {
+      fail(level, n, "round trip failed");
+      continue;
+    }
+
+    // Corrupt 1-3 nibbles: the result must be what the scalar path
+    // says, and a single bad nibble must always be caught
+    int bad = 1 + n % 3;
+    for (int i = 0; i < bad; i++) {
+      nibbles[rng() % GcrCodec::DATA_NIBBLES] = rng();
+    }
+    bool changed = memcmp(nibbles, reference, sizeof(nibbles)) != 0;
+    bool ok = GcrCodec::decodeSector(nibbles, decoded);
+    GcrCodec::setSimdLevel("scalar");
+    bool expectedOk = GcrCodec::decodeSector(nibbles, expected);
+    GcrCodec::setSimdLevel(level);
+    if (ok != expectedOk || memcmp(decoded, expected, sizeof(decoded)) != 0) {
+      fail(level, n, "corrupt field decodes differently from the scalar path");
+    } else if (bad == 1 && changed && ok) {
+      fail(level, n, "corrupt nibble not detected");
+    }
+  }
+
+  // Whole tracks go through the same per-sector code
+  static uint8_t track[GcrCodec::TRACK_SECTORS * GcrCodec::SECTOR_BYTES];
+  static uint8_t trackNibbles[GcrCodec::TRACK_SECTORS * GcrCodec::DATA_NIBBLES];
+  static uint8_t trackDecoded[GcrCodec::TRACK_SECTORS * GcrCodec::SECTOR_BYTES];
+  for (int i = 0; i < (int)sizeof(track); i++) track[i] = rng();
+  GcrCodec::encodeSectors(track, trackNibbles, GcrCodec::TRACK_SECTORS);
+  for (int s = 0; s < GcrCodec::TRACK_SECTORS; s++) {
+    referenceEncode(track + s * GcrCodec::SECTOR_BYTES, reference);
+    if (memcmp(trackNibbles + s * GcrCodec::DATA_NIBBLES, reference, sizeof(reference)) != 0) {
+      fail(level, s, "track encoding differs from the reference");
+    }
+  }
+  if (GcrCodec::decodeSectors(trackNibbles, trackDecoded, GcrCodec::TRACK_SECTORS) != 0 ||
+      memcmp(trackDecoded, track, sizeof(track)) != 0) {
+    fail(level, 0, "track round trip failed");
+  }
+}
+
+static void bench(const char *level, int passes) {
+  static uint8_t track[GcrCodec::TRACK_SECTORS * GcrCodec::SECTOR_BYTES];
+  static uint8_t nibbles[GcrCodec::TRACK_SECTORS * GcrCodec::DATA_NIBBLES];
+  for (int i = 0; i < (int)sizeof(track); i++) track[i] = i * 7;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < passes; i++) {
+    GcrCodec::encodeSectors(track, nibbles, GcrCodec::TRACK_SECTORS);
+  }
+  auto middle = std::chrono::steady_clock::now();
+  int errors = 0;
+  for (int i = 0; i < passes; i++) {
+    errors += GcrCodec::decodeSectors(nibbles, track, GcrCodec::TRACK_SECTORS);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double encode = std::chrono::duration<double>(middle - start).count();
+  double decode = std::chrono::duration<double>(end - middle).count();
+  printf("  %-6s %9.0f tracks/s encode  %9.0f tracks/s decode%s\n", level, passes / encode,
+         passes / decode, errors ? "  (decode errors!)" : "");
+  if (errors) failures++;
+}
+
+static void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-cases N] [-seed N] [-bench N]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+  int cases = 100000;
+  uint32_t seed = 1;
+  int benchPasses = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-cases" && i + 1 < argc) {
+      cases = atoi(argv[++i]);
+    } else if (arg == "-seed" && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 0);
+    } else if (arg == "-bench" && i + 1 < argc) {
+      benchPasses = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  printf("GCR codec: %d sectors per path, seed %u\n", cases, seed);
+  for (const char *level : LEVELS) {
+    if (!GcrCodec::setSimdLevel(level)) {
+      printf("  %-6s not supported by this CPU, skipped\n", level);
+      continue;
+    }
+    int before = failures;
+    check(level, cases, seed);
+    printf("  %-6s %s\n", level, failures == before ? "ok" : "FAILED");
+  }
+
+  if (benchPasses > 0) {
+    printf("Benchmark: %d passes over one 16-sector track\n", benchPasses);
+    for (const char *level : LEVELS) {
+      if (GcrCodec::setSimdLevel(level)) bench(level, benchPasses);
+    }
+  }
+
+  return failures ? 1 : 0;
+}
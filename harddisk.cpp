@@ -0,0 +1,273 @@
+#include "harddisk.h"
+#include "cpu.h"
+#include <cstdio>
+#include <cstring>
+
+// Slot firmware. Bytes $01/$03/$05/$07 = $20/$00/$03/$00 identify a
+// SmartPort device; $CnFF holds the ProDOS entry point, and the SmartPort
+// entry sits three bytes after it. Both entries hand the call to the host
+// with a write to the card's I/O space, then load the results.
+//
+//   00: A2 20 A0 00 A2 03 A2 00    signature
+//   08: A9 01 85 42                LDA #CMD_READ / STA $42
+//   0C: A9 s0 85 43                LDA #slot*16 / STA $43     drive 1
+//   10: A9 00 85 44 85 46 85 47    buffer $0800, block 0
+//   18: A9 08 85 45
+//   1C: 20 49 Cs                   JSR prodos
+//   1F: B0 0C                      BCS fail
+//   21: AD 00 08 C9 01 D0 05       boot block must start with $01
+//   28: A2 s0 4C 01 08             LDX #slot*16 / JMP $0801
+//   2D: 4C 00 E0                   fail: JMP $E000 (BASIC)
+//
+//   40: 18 90 06                   CLC / BCC prodos     ProDOS entry
+//   43: 8D x3 C0 4C 4C Cs          STA $C0x3 / JMP done SmartPort entry
+//   49: 8D x0 C0                   prodos: STA $C0x0
+//   4C: AD x0 C0 AE x1 C0 AC x2 C0 done: LDA/LDX/LDY results
+//   55: C9 01 60                   CMP #$01 (C = error) / RTS
+//
+//   FC: 00 00 17 40                block count via STATUS, flags, entry
+
+static const uint8_t HD_ROM_TEMPLATE[] = {
+    0xA2, 0x20, 0xA0, 0x00, 0xA2, 0x03, 0xA2, 0x00,
+    0xA9, 0x01, 0x85, 0x42,
+    0xA9, 0x00, 0x85, 0x43,
+    0xA9, 0x00, 0x85, 0x44, 0x85, 0x46, 0x85, 0x47,
+    0xA9, 0x08, 0x85, 0x45,
+    0x20, 0x49, 0x00,
+    0xB0, 0x0C,
+    0xAD, 0x00, 0x08, 0xC9, 0x01, 0xD0, 0x05,
+    0xA2, 0x00, 0x4C, 0x01, 0x08,
+    0x4C, 0x00, 0xE0,
+};
+
+static const uint8_t HD_DRIVER_TEMPLATE[] = {
+    0x18, 0x90, 0x06,
+    0x8D, 0x03, 0xC0, 0x4C, 0x4C, 0x00,
+    0x8D, 0x00, 0xC0,
+    0xAD, 0x00, 0xC0, 0xAE, 0x01, 0xC0, 0xAC, 0x02, 0xC0,
+    0xC9, 0x01, 0x60,
+};
+
+static const uint8_t DRIVER_OFFSET = 0x40;
+
+HardDisk::HardDisk(int slot)
+    : slot(slot), cpu(nullptr), lastError(ERR_NONE), resultX(0), resultY(0) {
+    for (int i = 0; i < NUM_DRIVES; i++) {
+        devices[i] = nullptr;
+    }
+    buildROM();
+}
+
+void HardDisk::buildROM() {
+    uint8_t slotPage = 0xC0 + slot;
+    uint8_t ioBase = 0x80 + slot * 16;
+
+    memset(rom, 0, sizeof(rom));
+    memcpy(rom, HD_ROM_TEMPLATE, sizeof(HD_ROM_TEMPLATE));
+    memcpy(rom + DRIVER_OFFSET, HD_DRIVER_TEMPLATE, sizeof(HD_DRIVER_TEMPLATE));
+
+    // Patch slot-dependent operands
+    rom[0x0D] = slot * 16;
+    rom[0x1E] = slotPage;
+    rom[0x29] = slot * 16;
+    rom[DRIVER_OFFSET + 0x04] = ioBase + 3;
+    rom[DRIVER_OFFSET + 0x08] = slotPage;
+    rom[DRIVER_OFFSET + 0x0A] = ioBase;
+    rom[DRIVER_OFFSET + 0x0D] = ioBase;
+    rom[DRIVER_OFFSET + 0x10] = ioBase + 1;
+    rom[DRIVER_OFFSET + 0x13] = ioBase + 2;
+
+    rom[0xFC] = 0x00;                   // Block count: ask via STATUS
+    rom[0xFD] = 0x00;
+    rom[0xFE] = 0x17;                   // Two volumes; status, read, write
+    rom[0xFF] = DRIVER_OFFSET;
+}
+
+void HardDisk::setDevice(int drive, BlockDevice* device) {
+    if (drive >= 0 && drive < NUM_DRIVES) {
+        devices[drive] = device;
+    }
+}
+
+uint8_t HardDisk::ioRead(uint16_t address) {
+    switch (address & 0x0F) {
+        case 0x0: return lastError;
+        case 0x1: return resultX;
+        case 0x2: return resultY;
+    }
+    return 0;
+}
+
+void HardDisk::ioWrite(uint16_t address, uint8_t /*value*/) {
+    if (!cpu) return;
+
+    switch (address & 0x0F) {
+        case 0x0: prodosCall(); break;
+        case 0x3: smartPortCall(); break;
+    }
+}
+
+uint8_t HardDisk::readBlock(BlockDevice* device, uint32_t block, uint16_t buffer) {
+    uint8_t data[BlockDevice::BLOCK_SIZE];
+    if (block >= device->getBlockCount()) return ERR_BAD_BLOCK;
+    if (!device->readBlock(block, data)) return ERR_IO;
+    cpu->writeMemory(buffer, data, sizeof(data));
+    return ERR_NONE;
+}
+
+uint8_t HardDisk::writeBlock(BlockDevice* device, uint32_t block, uint16_t buffer) {
+    uint8_t data[BlockDevice::BLOCK_SIZE];
+    if (device->isWriteProtected()) return ERR_WRITE_PROTECTED;
+    if (block >= device->getBlockCount()) return ERR_BAD_BLOCK;
+    cpu->readMemory(buffer, data, sizeof(data));
+    return device->writeBlock(block, data) ? ERR_NONE : ERR_IO;
+}
+
+void HardDisk::prodosCall() {
+    uint8_t command = cpu->readByte(0x42);
+    uint8_t unit = cpu->readByte(0x43);
+    uint16_t buffer = cpu->readByte(0x44) | (cpu->readByte(0x45) << 8);
+    uint16_t block = cpu->readByte(0x46) | (cpu->readByte(0x47) << 8);
+
+    BlockDevice* device = devices[(unit >> 7) & 1];
+    resultX = resultY = 0;
+
+    if (!device) {
+        lastError = ERR_NO_DEVICE;
+        return;
+    }
+
+    switch (command) {
+        case CMD_STATUS:
+            resultX = device->getBlockCount() & 0xFF;
+            resultY = (device->getBlockCount() >> 8) & 0xFF;
+            lastError = device->isWriteProtected() ? ERR_WRITE_PROTECTED : ERR_NONE;
+            break;
+        case CMD_READ:
+            lastError = readBlock(device, block, buffer);
+            break;
+        case CMD_WRITE:
+            lastError = writeBlock(device, block, buffer);
+            break;
+        case CMD_FORMAT:
+            lastError = device->isWriteProtected() ? ERR_WRITE_PROTECTED : ERR_NONE;
+            break;
+        default:
+            lastError = ERR_BAD_COMMAND;
+            break;
+    }
+}
+
+void HardDisk::smartPortCall() {
+    // JSR pushed the address of its last byte; the command byte and the
+    // parameter list pointer follow it inline. Step the return past them.
+    uint16_t stack = 0x100 + cpu->regSP;
+    uint16_t ret = cpu->readByte(stack + 1) | (cpu->readByte(stack + 2) << 8);
+    uint8_t command = cpu->readByte(ret + 1);
+    uint16_t params = cpu->readByte(ret + 2) | (cpu->readByte(ret + 3) << 8);
+    ret += 3;
+    cpu->writeByte(stack + 1, ret & 0xFF);
+    cpu->writeByte(stack + 2, ret >> 8);
+
+    uint8_t unit = cpu->readByte(params + 1);
+    resultX = resultY = 0;
+
+    // SmartPort units 1..n map onto the mounted drives in order
+    BlockDevice* device = nullptr;
+    int mounted = 0;
+    for (int i = 0; i < NUM_DRIVES; i++) {
+        if (devices[i] && ++mounted == unit) {
+            device = devices[i];
+        }
+    }
+
+    if (command == 0x00) {
+        uint16_t list = cpu->readByte(params + 2) | (cpu->readByte(params + 3) << 8);
+        lastError = smartPortStatus(unit, list, cpu->readByte(params + 4));
+        return;
+    }
+
+    if (!device) {
+        lastError = (unit == 0 || unit > NUM_DRIVES) ? ERR_BAD_UNIT : ERR_NO_DEVICE;
+        return;
+    }
+
+    uint16_t buffer = cpu->readByte(params + 2) | (cpu->readByte(params + 3) << 8);
+    uint32_t block = cpu->readByte(params + 4) | (cpu->readByte(params + 5) << 8) |
+                     (cpu->readByte(params + 6) << 16);
+
+    switch (command) {
+        case 0x01:                      // READBLOCK
+            lastError = readBlock(device, block, buffer);
+            if (lastError == ERR_NONE) resultY = BlockDevice::BLOCK_SIZE >> 8;
+            break;
+        case 0x02:                      // WRITEBLOCK
+            lastError = writeBlock(device, block, buffer);
+            if (lastError == ERR_NONE) resultY = BlockDevice::BLOCK_SIZE >> 8;
+            break;
+        case 0x03:                      // FORMAT
+            lastError = device->isWriteProtected() ? ERR_WRITE_PROTECTED : ERR_NONE;
+            break;
+        case 0x04:                      // CONTROL
+        case 0x05:                      // INIT
+            lastError = ERR_NONE;
+            break;
+        default:                        // OPEN/CLOSE/READ/WRITE are character-device calls
+            lastError = ERR_BAD_COMMAND;
+            break;
+    }
+}
+
+uint8_t HardDisk::smartPortStatus(int unit, uint16_t list, uint8_t code) {
+    int mounted = 0;
+    BlockDevice* device = nullptr;
+    for (int i = 0; i < NUM_DRIVES; i++) {
+        if (devices[i] && ++mounted == unit) {
+            device = devices[i];
+        }
+    }
+
+    if (unit == 0) {
+        // Controller status: number of devices, no interrupts
+        if (code != 0) return ERR_BAD_STATUS_CODE;
+        uint8_t status[8] = {(uint8_t)mounted, 0xFF, 0, 0, 0, 0, 0, 0};
+        cpu->writeMemory(list, status, sizeof(status));
+        resultX = sizeof(status);
+        return ERR_NONE;
+    }
+
+    if (!device) return unit > NUM_DRIVES ? ERR_BAD_UNIT : ERR_NO_DEVICE;
+
+    uint32_t blocks = device->getBlockCount();
+    uint8_t general = 0xF8;             // Block device, writable, readable, online
+    if (device->isWriteProtected()) general = (general & ~0x40) | 0x04;
+
+    if (code == 0x00) {
+        uint8_t status[4] = {general, (uint8_t)blocks, (uint8_t)(blocks >> 8), (uint8_t)(blocks >> 16)};
+        cpu->writeMemory(list, status, sizeof(status));
+        resultX = sizeof(status);
+        return ERR_NONE;
+    }
+
+    if (code == 0x03) {
+        // Device information block
+        uint8_t dib[25];
+        const char name[] = "APPLEIIE HD";
+        dib[0] = general;
+        dib[1] = blocks & 0xFF;
+        dib[2] = (blocks >> 8) & 0xFF;
+        dib[3] = (blocks >> 16) & 0xFF;
+        dib[4] = sizeof(name) - 1;
+        memset(dib + 5, ' ', 16);
+        memcpy(dib + 5, name, sizeof(name) - 1);
+        dib[21] = 0x02;                 // Hard disk
+        dib[22] = 0x00;
+        dib[23] = 0x00;                 // Firmware version
+        dib[24] = 0x01;
+        cpu->writeMemory(list, dib, sizeof(dib));
+        resultX = sizeof(dib);
+        return ERR_NONE;
+    }
+
+    return ERR_BAD_STATUS_CODE;
+}
@@ -0,0 +1,75 @@
+// harddisk.h - ProDOS / SmartPort block device controller card
+#ifndef HARDDISK_H
+#define HARDDISK_H
+
+#include <cstdint>
+#include "blockdev.h"
+#include "slots.h"
+
+class CPU6502;
+
+class HardDisk : public Card {
+public:
+    static const int NUM_DRIVES = 2;
+    static const int DEFAULT_SLOT = 7;
+    static const uint16_t ROM_SIZE = 0x100;
+
+    // ProDOS block driver commands (passed in zero page $42-$47)
+    enum Command {
+        CMD_STATUS = 0,
+        CMD_READ = 1,
+        CMD_WRITE = 2,
+        CMD_FORMAT = 3
+    };
+
+    // ProDOS / SmartPort error codes
+    enum Error {
+        ERR_NONE = 0x00,
+        ERR_BAD_COMMAND = 0x01,
+        ERR_BAD_PCOUNT = 0x04,
+        ERR_BUS_ERROR = 0x06,
+        ERR_BAD_UNIT = 0x11,
+        ERR_BAD_STATUS_CODE = 0x21,
+        ERR_IO = 0x27,
+        ERR_NO_DEVICE = 0x28,
+        ERR_WRITE_PROTECTED = 0x2B,
+        ERR_BAD_BLOCK = 0x2D
+    };
+
+    HardDisk(int slot = DEFAULT_SLOT);
+
+    // Attach a block device to drive 0 or 1 (not owned)
+    void setDevice(int drive, BlockDevice* device);
+    bool isMounted() const { return devices[0] || devices[1]; }
+    int getSlot() const { return slot; }
+
+    // The card transfers blocks straight into emulated memory
+    void attach(CPU6502* cpu) { this->cpu = cpu; }
+
+    // I/O access ($C080 + slot * 16)
+    uint8_t ioRead(uint16_t address) override;
+    void ioWrite(uint16_t address, uint8_t value) override;
+
+    // Firmware page ($Cn00-$CnFF)
+    const uint8_t* getROM() const override { return rom; }
+
+private:
+    int slot;
+    CPU6502* cpu;
+    BlockDevice* devices[NUM_DRIVES];
+    uint8_t rom[ROM_SIZE];
+
+    // Results of the last call, read back by the firmware
+    uint8_t lastError;
+    uint8_t resultX;
+    uint8_t resultY;
+
+    void buildROM();
+    void prodosCall();
+    void smartPortCall();
+    uint8_t readBlock(BlockDevice* device, uint32_t block, uint16_t buffer);
+    uint8_t writeBlock(BlockDevice* device, uint32_t block, uint16_t buffer);
+    uint8_t smartPortStatus(int unit, uint16_t list, uint8_t code);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "hooks.h"
+#include "cpu.h"
+#include <algorithm>
+#include <cstring>
+
+static bool before(const HookTable::Hook& hook, uint16_t address) {
+    return hook.address < address;
+}
+
+HookTable::HookTable() : enabled(true) {
+    memset(pages, 0, sizeof(pages));
+}
+
+void HookTable::add(uint16_t address, const std::string& name, Handler handler) {
+    auto it = std::lower_bound(hooks.begin(), hooks.end(), address, before);
+    if (it != hooks.end() && it->address == address) {
+        it->name = name;
+        it->handler = handler;
+        it->calls = 0;
+    } else {
+        hooks.insert(it, Hook{address, name, handler, 0});
+    }
+    updatePages();
+}
+
+void HookTable::remove(uint16_t address) {
+    auto it = std::lower_bound(hooks.begin(), hooks.end(), address, before);
+    if (it != hooks.end() && it->address == address) {
+        hooks.erase(it);
+        updatePages();
+    }
+}
+
+void HookTable::clear() {
+    hooks.clear();
+    updatePages();
+}
+
+void HookTable::setEnabled(bool on) {
+    enabled = on;
+    updatePages();
+}
+
+bool HookTable::run(CPU6502& cpu) {
+    // Most instructions on a hooked page are not at a hook
+    auto it = std::lower_bound(hooks.begin(), hooks.end(), cpu.regPC, before);
+    if (it == hooks.end() || it->address != cpu.regPC || !it->handler(cpu)) {
+        return false;
+    }
+    it->calls++;
+    return true;
+}
+
+void HookTable::updatePages() {
+    memset(pages, 0, sizeof(pages));
+    if (!enabled) return;
+    for (const Hook& hook : hooks) {
+        pages[hook.address >> 11] |= 1 << ((hook.address >> 8) & 7);
+    }
+}
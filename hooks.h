@@ -0,0 +1,58 @@
+// hooks.h - Native stand-ins for ROM routines, looked up by PC
+#ifndef HOOKS_H
+#define HOOKS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class CPU6502;
+
+// High-level emulation: a hook replaces the routine at its address. When
+// the CPU is about to execute that address, the handler runs instead and
+// either does the routine's whole job (memory, registers, flags, cycles)
+// and returns as its RTS would, or returns false without touching
+// anything, for the 6502 code to run after all. A bit per page says
+// which pages hold a hook; code on any other page pays one bit test.
+class HookTable {
+public:
+    typedef std::function<bool(CPU6502&)> Handler;
+
+    struct Hook {
+        uint16_t address;
+        std::string name;
+        Handler handler;
+        uint64_t calls;                 // Times the handler took over
+    };
+
+    HookTable();
+
+    // One hook per address: adding at a hooked address replaces it
+    void add(uint16_t address, const std::string& name, Handler handler);
+    void remove(uint16_t address);
+    void clear();
+
+    // Disabled, hooks stay registered but are never called (-nohooks,
+    // and while FastMath compares itself with the ROM)
+    void setEnabled(bool on);
+    bool isEnabled() const { return enabled; }
+
+    bool isHooked(uint16_t address) const {
+        return (pages[address >> 11] >> ((address >> 8) & 7)) & 1;
+    }
+
+    // The hook at the CPU's PC, if any, and whether it took over
+    bool run(CPU6502& cpu);
+
+    const std::vector<Hook>& list() const { return hooks; }
+
+private:
+    std::vector<Hook> hooks;            // Sorted by address
+    uint8_t pages[32];                  // Bit per 256-byte page with a hook to call
+    bool enabled;
+
+    void updatePages();
+};
+
+#endif
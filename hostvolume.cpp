@@ -0,0 +1,461 @@
+#include "hostvolume.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+
+HostVolume::HostVolume()
+    : dirBlocks(0), bitmapBlock(0), bitmapBlocks(0), firstFree(0),
+      writeProtected(true), created(0) {}
+
+HostVolume::~HostVolume() {
+    for (HostFile& file : files) {
+        if (file.fd >= 0) {
+            ::close(file.fd);
+        }
+    }
+}
+
+// ========== Naming ==========
+
+std::string HostVolume::prodosName(const std::string& hostName, uint8_t& fileType, uint16_t& auxType) {
+    std::string base = hostName;
+    fileType = 0x06;                    // BIN
+    auxType = 0x0000;
+
+    // CiderPress-style "NAME#TTAAAA" carries the type and aux type
+    size_t hash = base.rfind('#');
+    if (hash != std::string::npos && base.size() - hash == 7 &&
+        std::all_of(base.begin() + hash + 1, base.end(), ::isxdigit)) {
+        unsigned long typeAux = strtoul(base.c_str() + hash + 1, nullptr, 16);
+        fileType = (typeAux >> 16) & 0xFF;
+        auxType = typeAux & 0xFFFF;
+        base = base.substr(0, hash);
+    } else {
+        size_t dot = base.rfind('.');
+        std::string ext = (dot == std::string::npos) ? "" : base.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == "bas") {
+            fileType = 0xFC; auxType = 0x0801; base = base.substr(0, dot);
+        } else if (ext == "txt") {
+            fileType = 0x04; base = base.substr(0, dot);
+        } else if (ext == "bin") {
+            fileType = 0x06; base = base.substr(0, dot);
+        } else if (ext == "system") {
+            fileType = 0xFF; auxType = 0x2000;  // Name keeps its .SYSTEM suffix
+        }
+    }
+
+    return sanitizeName(base);
+}
+
+std::string HostVolume::sanitizeName(const std::string& base) {
+    // Letters, digits and periods only, starting with a letter, 15 max
+    std::string name;
+    for (char c : base) {
+        if (name.size() == 15) break;
+        if (isalnum((unsigned char)c)) name += toupper((unsigned char)c);
+        else name += '.';
+    }
+    if (name.empty() || !isalpha((unsigned char)name[0])) {
+        name = ("X" + name).substr(0, 15);
+    }
+    return name;
+}
+
+void HostVolume::putDateTime(uint8_t* entry, time_t t) {
+    struct tm tmv;
+    localtime_r(&t, &tmv);
+    uint16_t date = ((tmv.tm_year % 100) << 9) | ((tmv.tm_mon + 1) << 5) | tmv.tm_mday;
+    entry[0] = date & 0xFF;
+    entry[1] = date >> 8;
+    entry[2] = tmv.tm_min;
+    entry[3] = tmv.tm_hour;
+}
+
+// ========== Volume Layout ==========
+
+bool HostVolume::open(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::is_directory(path, ec)) {
+        printf("Not a directory: %s\n", path.c_str());
+        return false;
+    }
+
+    root = path;
+    writeProtected = access(path.c_str(), W_OK) != 0;
+    created = time(nullptr);
+
+    std::string dirName = fs::path(path).lexically_normal().filename().string();
+    if (dirName.empty()) dirName = fs::path(path).lexically_normal().parent_path().filename().string();
+    volumeName = sanitizeName(dirName.empty() ? "HOST" : dirName);
+
+    // Collect regular files, sorted for a stable layout
+    std::vector<fs::directory_entry> entries;
+    for (const fs::directory_entry& entry : fs::directory_iterator(path, ec)) {
+        if (entry.is_regular_file(ec) && entry.path().filename().string()[0] != '.') {
+            entries.push_back(entry);
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const fs::directory_entry& a, const fs::directory_entry& b) { return a.path() < b.path(); });
+
+    for (const fs::directory_entry& entry : entries) {
+        uintmax_t size = entry.file_size(ec);
+        if (ec || size > MAX_FILE_SIZE) {
+            printf("Skipping %s (too large for ProDOS)\n", entry.path().c_str());
+            continue;
+        }
+
+        HostFile file;
+        file.hostPath = entry.path().string();
+        file.name = prodosName(entry.path().filename().string(), file.fileType, file.auxType);
+        file.eof = size;
+        file.fd = -1;
+        file.keyBlock = 0;
+
+        struct stat st;
+        file.modified = (stat(file.hostPath.c_str(), &st) == 0) ? st.st_mtime : created;
+
+        // Make names unique by overwriting the tail with a counter
+        for (int n = 1; std::any_of(files.begin(), files.end(),
+                                    [&](const HostFile& f) { return f.name == file.name; }); n++) {
+            std::string suffix = std::to_string(n);
+            file.name = file.name.substr(0, std::min<size_t>(file.name.size(), 15 - suffix.size())) + suffix;
+        }
+
+        file.dataBlocks = std::max<uint32_t>(1, (size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        if (file.dataBlocks == 1) {
+            file.storageType = SEEDLING;
+            file.indexBlocks = 0;
+        } else if (file.dataBlocks <= 256) {
+            file.storageType = SAPLING;
+            file.indexBlocks = 1;
+        } else {
+            file.storageType = TREE;
+            file.indexBlocks = 1 + (file.dataBlocks + 255) / 256;
+        }
+        files.push_back(file);
+    }
+
+    // Boot blocks, volume directory, bitmap, then each file's run of blocks
+    dirBlocks = std::max<uint32_t>(4, (files.size() + ENTRIES_PER_BLOCK) / ENTRIES_PER_BLOCK);
+    bitmapBlock = VOLUME_DIR_BLOCK + dirBlocks;
+    bitmapBlocks = (MAX_BLOCKS + BLOCK_SIZE * 8 - 1) / (BLOCK_SIZE * 8);
+
+    uint32_t next = bitmapBlock + bitmapBlocks;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (next + files[i].blocksUsed() > MAX_BLOCKS) {
+            printf("Volume full: dropping %zu file(s) from %s\n", files.size() - i, path.c_str());
+            files.resize(i);
+            break;
+        }
+        files[i].keyBlock = next;
+        files[i].dirBlock = VOLUME_DIR_BLOCK + (i + 1) / ENTRIES_PER_BLOCK;
+        files[i].dirEntry = (i + 1) % ENTRIES_PER_BLOCK;
+        next += files[i].blocksUsed();
+    }
+    firstFree = next;
+
+    printf("Host volume /%s: %zu files from %s%s\n", volumeName.c_str(), files.size(),
+           path.c_str(), writeProtected ? " (read-only)" : "");
+    return true;
+}
+
+int HostVolume::findFile(uint32_t block) const {
+    if (block < bitmapBlock + bitmapBlocks || block >= firstFree) {
+        return -1;
+    }
+    auto it = std::upper_bound(files.begin(), files.end(), block,
+                               [](uint32_t b, const HostFile& f) { return b < f.keyBlock; });
+    if (it == files.begin()) return -1;
+    --it;
+    if (block >= it->endBlock() || it->hostPath.empty()) return -1;
+    return it - files.begin();
+}
+
+int HostVolume::openFile(HostFile& file) {
+    if (file.fd < 0) {
+        file.fd = ::open(file.hostPath.c_str(), writeProtected ? O_RDONLY : O_RDWR);
+        if (file.fd < 0) {
+            file.fd = ::open(file.hostPath.c_str(), O_RDONLY);
+        }
+    }
+    return file.fd;
+}
+
+// ========== Block Synthesis ==========
+
+void HostVolume::buildDirectoryBlock(uint32_t index, uint8_t* buffer) const {
+    memset(buffer, 0, BLOCK_SIZE);
+    uint32_t prev = (index == 0) ? 0 : VOLUME_DIR_BLOCK + index - 1;
+    uint32_t next = (index + 1 == dirBlocks) ? 0 : VOLUME_DIR_BLOCK + index + 1;
+    buffer[0] = prev & 0xFF;
+    buffer[1] = prev >> 8;
+    buffer[2] = next & 0xFF;
+    buffer[3] = next >> 8;
+
+    for (int slot = 0; slot < ENTRIES_PER_BLOCK; slot++) {
+        uint8_t* e = buffer + 4 + slot * ENTRY_LENGTH;
+        uint32_t entry = index * ENTRIES_PER_BLOCK + slot;
+
+        if (entry == 0) {
+            // Volume directory header
+            e[0x00] = 0xF0 | volumeName.size();
+            memcpy(e + 0x01, volumeName.data(), volumeName.size());
+            putDateTime(e + 0x18, created);
+            e[0x1E] = 0xC3;
+            e[0x1F] = ENTRY_LENGTH;
+            e[0x20] = ENTRIES_PER_BLOCK;
+            e[0x21] = files.size() & 0xFF;
+            e[0x22] = files.size() >> 8;
+            e[0x23] = bitmapBlock & 0xFF;
+            e[0x24] = bitmapBlock >> 8;
+            e[0x25] = MAX_BLOCKS & 0xFF;
+            e[0x26] = MAX_BLOCKS >> 8;
+            continue;
+        }
+
+        if (entry - 1 >= files.size()) break;
+        const HostFile& f = files[entry - 1];
+        e[0x00] = (f.storageType << 4) | f.name.size();
+        memcpy(e + 0x01, f.name.data(), f.name.size());
+        e[0x10] = f.fileType;
+        e[0x11] = f.keyBlock & 0xFF;
+        e[0x12] = f.keyBlock >> 8;
+        e[0x13] = f.blocksUsed() & 0xFF;
+        e[0x14] = f.blocksUsed() >> 8;
+        e[0x15] = f.eof & 0xFF;
+        e[0x16] = (f.eof >> 8) & 0xFF;
+        e[0x17] = (f.eof >> 16) & 0xFF;
+        putDateTime(e + 0x18, f.modified);
+        e[0x1E] = writeProtected ? 0x21 : 0xE3;
+        e[0x1F] = f.auxType & 0xFF;
+        e[0x20] = f.auxType >> 8;
+        putDateTime(e + 0x21, f.modified);
+        e[0x25] = VOLUME_DIR_BLOCK & 0xFF;
+        e[0x26] = VOLUME_DIR_BLOCK >> 8;
+    }
+}
+
+void HostVolume::buildBitmapBlock(uint32_t index, uint8_t* buffer) const {
+    // One bit per block, MSB first, set = free
+    memset(buffer, 0, BLOCK_SIZE);
+    uint32_t first = index * BLOCK_SIZE * 8;
+    for (uint32_t bit = 0; bit < BLOCK_SIZE * 8; bit++) {
+        uint32_t block = first + bit;
+        if (block >= firstFree && block < MAX_BLOCKS) {
+            buffer[bit >> 3] |= 0x80 >> (bit & 7);
+        }
+    }
+}
+
+bool HostVolume::buildFileBlock(HostFile& file, uint32_t block, uint8_t* buffer) {
+    memset(buffer, 0, BLOCK_SIZE);
+    uint32_t rel = block - file.keyBlock;
+
+    if (rel < file.indexBlocks) {
+        // Index blocks hold 256 pointers: low bytes, then high bytes
+        uint32_t first = 0;
+        uint32_t count = 0;
+        if (file.storageType == TREE && rel == 0) {
+            first = file.keyBlock + 1;          // Master index -> index blocks
+            count = file.indexBlocks - 1;
+        } else {
+            uint32_t group = (file.storageType == TREE) ? rel - 1 : 0;
+            first = file.firstData() + group * 256;
+            count = std::min<uint32_t>(256, file.dataBlocks - group * 256);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            buffer[i] = (first + i) & 0xFF;
+            buffer[256 + i] = (first + i) >> 8;
+        }
+        return true;
+    }
+
+    int fd = openFile(file);
+    if (fd < 0) return false;
+    off_t offset = (off_t)(block - file.firstData()) * BLOCK_SIZE;
+    return pread(fd, buffer, BLOCK_SIZE, offset) >= 0;
+}
+
+bool HostVolume::readBlock(uint32_t block, uint8_t* buffer) {
+    if (block >= MAX_BLOCKS) return false;
+
+    auto it = overlay.find(block);
+    if (it != overlay.end()) {
+        memcpy(buffer, it->second.data(), BLOCK_SIZE);
+        return true;
+    }
+
+    if (block >= VOLUME_DIR_BLOCK && block < bitmapBlock) {
+        buildDirectoryBlock(block - VOLUME_DIR_BLOCK, buffer);
+        return true;
+    }
+    if (block >= bitmapBlock && block < bitmapBlock + bitmapBlocks) {
+        buildBitmapBlock(block - bitmapBlock, buffer);
+        return true;
+    }
+
+    int index = findFile(block);
+    if (index >= 0) {
+        return buildFileBlock(files[index], block, buffer);
+    }
+
+    // Boot blocks and free space
+    memset(buffer, 0, BLOCK_SIZE);
+    return true;
+}
+
+// ========== Write-back ==========
+
+bool HostVolume::isFree(uint32_t block) {
+    // As the guest's own bitmap has it
+    uint8_t buffer[BLOCK_SIZE];
+    uint32_t bit = block % (BLOCK_SIZE * 8);
+    return readBlock(bitmapBlock + block / (BLOCK_SIZE * 8), buffer) &&
+           (buffer[bit >> 3] & (0x80 >> (bit & 7))) != 0;
+}
+
+void HostVolume::syncDirectoryBlock(uint32_t block, const uint8_t* buffer) {
+    // Follow EOF changes, growth and deletions made by the guest. Files
+    // are matched by the entry they were given, not by name: DESTROY
+    // zeroes the name length along with the storage type. A file that is
+    // deleted, whose entry has left its run for blocks now free, or that
+    // can no longer be written, is detached: its blocks are then served
+    // from the overlay and a file reusing them never reaches the host.
+    for (HostFile& f : files) {
+        if (f.hostPath.empty() || f.dirBlock != block) continue;
+        const uint8_t* e = buffer + 4 + f.dirEntry * ENTRY_LENGTH;
+
+        uint8_t storageType = e[0] >> 4;
+        uint32_t key = e[0x11] | (e[0x12] << 8);
+        uint32_t eof = e[0x15] | (e[0x16] << 8) | (e[0x17] << 16);
+        bool changed = eof != f.eof || key != f.keyBlock || storageType != f.storageType ||
+                       eof > f.dataBlocks * BLOCK_SIZE;
+        if (storageType == 0 || (key != f.keyBlock && isFree(f.keyBlock)) ||
+            (changed && !writeBack(f, storageType, key, eof))) {
+            detach(f);
+        }
+    }
+}
+
+bool HostVolume::fileBlocks(uint8_t storageType, uint32_t key, uint32_t eof, std::vector<uint32_t>& blocks) {
+    // Data blocks in file order as the guest's index blocks give them;
+    // 0 for a sparse block
+    uint32_t count = std::max<uint32_t>(1, (eof + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    blocks.clear();
+    if (key == 0 || key >= MAX_BLOCKS) return false;
+    if (storageType == SEEDLING) {
+        blocks.push_back(key);
+        return count == 1;
+    }
+    if (storageType != SAPLING && storageType != TREE) return false;
+
+    uint8_t master[BLOCK_SIZE];
+    uint8_t index[BLOCK_SIZE];
+    if (storageType == TREE && !readBlock(key, master)) return false;
+    for (uint32_t group = 0; group * 256 < count; group++) {
+        uint32_t indexBlock = key;
+        if (storageType == TREE) {
+            indexBlock = master[group] | (master[256 + group] << 8);
+        } else if (group > 0) {
+            return false;
+        }
+
+        uint32_t n = std::min<uint32_t>(256, count - group * 256);
+        if (indexBlock == 0) {
+            blocks.insert(blocks.end(), n, 0);
+            continue;
+        }
+        if (indexBlock >= MAX_BLOCKS || !readBlock(indexBlock, index)) return false;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t block = index[i] | (index[256 + i] << 8);
+            if (block >= MAX_BLOCKS) return false;
+            blocks.push_back(block);
+        }
+    }
+    return true;
+}
+
+bool HostVolume::writeBack(HostFile& f, uint8_t storageType, uint32_t key, uint32_t eof) {
+    // Only blocks the host file does not hold yet are written: the tail
+    // of its run kept back past the old EOF, and blocks beyond the run
+    std::vector<uint32_t> blocks;
+    if (!fileBlocks(storageType, key, eof, blocks) || blocks[0] != f.firstData() || openFile(f) < 0) {
+        return false;
+    }
+
+    uint8_t buffer[BLOCK_SIZE];
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+        uint32_t block = blocks[i];
+        bool inRun = i < f.dataBlocks && block == f.firstData() + i;
+        if (block == 0 || !(inRun ? overlay.count(block) : unsynced.count(block))) continue;
+
+        uint32_t offset = i * BLOCK_SIZE;
+        uint32_t length = (eof > offset) ? std::min<uint32_t>(BLOCK_SIZE, eof - offset) : 0;
+        if (!readBlock(block, buffer) ||
+            (length > 0 && pwrite(f.fd, buffer, length, offset) != (ssize_t)length)) {
+            return false;
+        }
+        unsynced.erase(block);
+        if (inRun && length == BLOCK_SIZE) overlay.erase(block);
+    }
+    if (ftruncate(f.fd, eof) != 0) return false;
+    f.eof = eof;
+    return true;
+}
+
+void HostVolume::detach(HostFile& f) {
+    // The guest keeps seeing the file as it was: its host-backed blocks
+    // move to the overlay before the host file is let go
+    uint8_t buffer[BLOCK_SIZE];
+    for (uint32_t block = f.keyBlock; block < f.endBlock(); block++) {
+        if (!overlay.count(block) && buildFileBlock(f, block, buffer)) {
+            overlay[block].assign(buffer, buffer + BLOCK_SIZE);
+        }
+    }
+    if (f.fd >= 0) {
+        ::close(f.fd);
+        f.fd = -1;
+    }
+    f.hostPath.clear();
+}
+
+bool HostVolume::writeBlock(uint32_t block, const uint8_t* buffer) {
+    if (writeProtected || block >= MAX_BLOCKS) return false;
+
+    int index = findFile(block);
+    if (index >= 0 && block >= files[index].firstData()) {
+        HostFile& f = files[index];
+        int fd = openFile(f);
+        if (fd < 0) return false;
+
+        // Only bytes inside EOF reach the host file; a partial last block is
+        // also kept whole in the overlay until the directory entry catches up
+        off_t offset = (off_t)(block - f.firstData()) * BLOCK_SIZE;
+        size_t length = BLOCK_SIZE;
+        if ((uint32_t)offset + length > f.eof) {
+            length = (f.eof > (uint32_t)offset) ? f.eof - offset : 0;
+            overlay[block].assign(buffer, buffer + BLOCK_SIZE);
+            unsynced.insert(block);
+        } else {
+            overlay.erase(block);
+            unsynced.erase(block);
+        }
+        return length == 0 || pwrite(fd, buffer, length, offset) == (ssize_t)length;
+    }
+
+    overlay[block].assign(buffer, buffer + BLOCK_SIZE);
+    if (block >= VOLUME_DIR_BLOCK && block < bitmapBlock) {
+        syncDirectoryBlock(block, buffer);
+    } else if (block >= bitmapBlock + bitmapBlocks) {
+        unsynced.insert(block);
+    }
+    return true;
+}
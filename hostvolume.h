@@ -0,0 +1,101 @@
+// hostvolume.h - Host directory presented as a ProDOS volume
+#ifndef HOSTVOLUME_H
+#define HOSTVOLUME_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "blockdev.h"
+
+// The host directory is scanned once (names and sizes only) and every file
+// is given a contiguous run of block numbers. Directory, bitmap, index and
+// data blocks are then synthesised only when the emulated machine reads
+// them; data blocks come straight from the host file with pread.
+//
+// Writes to a file's data blocks go back to the host file, and EOF changes
+// written to its directory entry resize it. A file that grows past its run
+// gets its new blocks from free space; whenever its directory entry is
+// written, the file is followed through its index blocks and those
+// blocks are written back too. A file whose entry is deleted, or moved
+// off its run, is let go before its blocks can be reused. Anything else
+// the guest writes (new files, renames, bitmap updates) is kept in
+// memory for the session. Subdirectories and files over 16 MB are skipped.
+class HostVolume : public BlockDevice {
+public:
+    static const int ENTRY_LENGTH = 0x27;
+    static const int ENTRIES_PER_BLOCK = 0x0D;
+    static const uint32_t VOLUME_DIR_BLOCK = 2;
+    static const uint32_t MAX_FILE_SIZE = 0xFFFFFF;
+
+    HostVolume();
+    ~HostVolume();
+
+    bool open(const std::string& path);
+
+    uint32_t getBlockCount() const override { return MAX_BLOCKS; }
+    bool isWriteProtected() const override { return writeProtected; }
+    bool readBlock(uint32_t block, uint8_t* buffer) override;
+    bool writeBlock(uint32_t block, const uint8_t* buffer) override;
+
+private:
+    enum StorageType {
+        SEEDLING = 1,
+        SAPLING = 2,
+        TREE = 3
+    };
+
+    struct HostFile {
+        std::string hostPath;
+        std::string name;               // ProDOS name
+        uint8_t fileType;
+        uint16_t auxType;
+        uint32_t eof;
+        uint8_t storageType;
+        uint32_t keyBlock;              // First block of the file's run
+        uint32_t indexBlocks;           // Index (and master index) blocks
+        uint32_t dataBlocks;
+        time_t modified;
+        uint32_t dirBlock;              // Block and entry holding the
+        int dirEntry;                   // file's directory entry
+        int fd;                         // Opened on first access
+
+        uint32_t firstData() const { return keyBlock + indexBlocks; }
+        uint32_t blocksUsed() const { return indexBlocks + dataBlocks; }
+        uint32_t endBlock() const { return keyBlock + blocksUsed(); }
+    };
+
+    std::string root;
+    std::string volumeName;
+    std::vector<HostFile> files;        // Sorted by keyBlock
+    uint32_t dirBlocks;
+    uint32_t bitmapBlock;
+    uint32_t bitmapBlocks;
+    uint32_t firstFree;
+    bool writeProtected;
+    time_t created;
+
+    // Guest writes that have no host file behind them, and those of them
+    // not yet written back to a file that has grown into them
+    std::unordered_map<uint32_t, std::vector<uint8_t>> overlay;
+    std::unordered_set<uint32_t> unsynced;
+
+    int findFile(uint32_t block) const;
+    int openFile(HostFile& file);
+    void buildDirectoryBlock(uint32_t index, uint8_t* buffer) const;
+    void buildBitmapBlock(uint32_t index, uint8_t* buffer) const;
+    bool buildFileBlock(HostFile& file, uint32_t block, uint8_t* buffer);
+    bool isFree(uint32_t block);
+    void syncDirectoryBlock(uint32_t block, const uint8_t* buffer);
+    bool fileBlocks(uint8_t storageType, uint32_t key, uint32_t eof, std::vector<uint32_t>& blocks);
+    bool writeBack(HostFile& file, uint8_t storageType, uint32_t key, uint32_t eof);
+    void detach(HostFile& file);
+
+    static std::string prodosName(const std::string& hostName, uint8_t& fileType, uint16_t& auxType);
+    static std::string sanitizeName(const std::string& base);
+    static void putDateTime(uint8_t* entry, time_t t);
+};
+
+#endif
@@ -1,9 +1,7 @@
 #include "cpu.h"
-#include <fstream>
+#include "debuglog.h"
 #include <iostream>
 
-extern std::ofstream debugLog;
-
 const uint8_t CPU6502::instructionCycles[256] = {
     7, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6,
     2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
@@ -25,94 +23,119 @@ const uint8_t CPU6502::instructionCycles[256] = {
 
 // Memory access
 uint8_t CPU6502::readByte(uint16_t address) {
+    // RAM, including the video pages the renderer reads in place
+    uint8_t flags = pageFlags[address >> 8];
+    if (!(flags & (PAGE_IO | PAGE_AUX))) {
+        return ram[address];
+    }
+
+    // 80STORE + PAGE2 + HIRES banks aux memory into $2000-$3FFF
+    if (flags & PAGE_AUX) {
+        return video->auxHiResPage1[address - AppleIIVideo::HIRES_PAGE1_START];
+    }
+
     // Keyboard input
     if (address == 0xC000 || address == 0xC001) {
         return keyboard->readKeyboard();
     }
-    
-    /*if (address >= 0xC0D0 && address <= 0xC0DF) {
-        return diskController->ioRead(address);
-    }*/
 
-    // Disk II ROM ($C600-$C6FF)
-   /*if (address >= 0xC600 && address < 0xC700) {
-        return diskController->readROM(address);
-   }*/
- 
-    // Video memory reads
-    if (address >= 0x400 && address < 0x800) {
-        return video->readByte(address);
+    // Reading the strobe clears it too
+    if (address == 0xC010) {
+        uint8_t key = keyboard->readKeyboard();
+        keyboard->strobeKeyboard();
+        return key;
     }
     
-    if (address >= 0xC050 && address <= 0xC057) {
-        video->handleGraphicsSoftSwitch(address);
-        return 0;
+    // Peripheral slots: one table lookup, empty slots fall through to RAM
+    if (address >= SlotBus::IO_BASE) {
+        if (address < SlotBus::ROM_BASE) {
+            Card* card = slots.ioCard(address);
+            if (card) return card->ioRead(address);
+        } else {
+            const uint8_t* rom = slots.romByte(address);
+            if (rom) return *rom;
+        }
     }
 
-    // Hi-Res Page 1 reads
-    if (address >= 0x2000 && address < 0x4000) {
-        return video->readByte(address);
-    }
-    
-    // Hi-Res Page 2 reads
-    if (address >= 0x4000 && address < 0x6000) {
-        return video->readByte(address);
+    if (address >= 0xC050 && address <= 0xC05F) {
+        softSwitch(address);
+        return 0;
     }
 
     return ram[address];
-
-
 }
 
 void CPU6502::writeByte(uint16_t address, uint8_t value) {
-
-    // Keyboard strobe
-    if (address == 0xC010 || address == 0xC011) { 
-        keyboard->strobeKeyboard(); 
-        return; 
+    uint8_t flags = pageFlags[address >> 8];
+    if (!flags) {
+        ram[address] = value;
+        return;
     }
 
-    // Graphics soft switches ($C050-$C057)
-    if (address >= 0xC050 && address <= 0xC057) {
-        debugLog << "Graphics soft switch write: address=$" << std::hex << address 
-                 << " (mode control)" << std::dec << "\n";
-        video->handleGraphicsSoftSwitch(address);
+    if (flags & PAGE_AUX) {
+        uint8_t& cell = video->auxHiResPage1[address - AppleIIVideo::HIRES_PAGE1_START];
+        if (cell != value) {
+            cell = value;
+            video->noteWrite(address);
+        }
         return;
     }
 
-    // Disk controller I/O ($C0D0-$C0DF)
-    if (address >= 0xC0D0 && address <= 0xC0DF) {
-        diskController->ioWrite(address, value);
+    // Video pages: only a changed byte needs redrawing
+    if (flags & PAGE_VIDEO) {
+        if (ram[address] != value) {
+            ram[address] = value;
+            video->noteWrite(address);
+        }
         return;
     }
-    
-    // Video memory (text and lo-res)
-    if (address >= 0x400 && address < 0x800) { 
-        //debugLog << "Video memory low res" << std::endl;
-        //debugLog << "Low-Res Page 1 write: address=$" << std::hex << address << " value=$" << (int)value << std::dec << "\n";
-        video->writeByte(address, value); 
+
+    // Keyboard strobe
+    if (address == 0xC010 || address == 0xC011) { 
+        keyboard->strobeKeyboard(); 
         return; 
     }
-    
-    // Hi-Res Page 1
-    if (address >= 0x2000 && address < 0x4000) {
-        static int hiResWrites = 0;
-        //debugLog << "Hi-Res Page 1 write: address=$" << std::hex << address << " value=$" << (int)value << std::dec << "\n";
-        video->writeByte(address, value);
+
+    // 80STORE and 80-column switches (write only)
+    if (address == 0xC000 || address == 0xC001 || address == 0xC00C || address == 0xC00D) {
+        softSwitch(address);
         return;
     }
-    
-    // Hi-Res Page 2
-    if (address >= 0x4000 && address < 0x6000) {
-        static int hiResWrites2 = 0;
-        //debugLog << "Hi-Res Page 2 write: address=$" << std::hex << address << " value=$" << (int)value << std::dec << "\n";
-        video->writeByte(address, value);
+
+    // Graphics soft switches ($C050-$C05F)
+    if (address >= 0xC050 && address <= 0xC05F) {
+        debugLog << "Graphics soft switch write: address=$" << std::hex << address 
+                 << " (mode control)" << std::dec << "\n";
+        softSwitch(address);
         return;
     }
+
+    // Peripheral slots
+    if (address >= SlotBus::IO_BASE) {
+        if (address < SlotBus::ROM_BASE) {
+            Card* card = slots.ioCard(address);
+            if (card) {
+                card->ioWrite(address, value);
+                return;
+            }
+        } else {
+            slots.romWrite(address);
+        }
+    }
     
     ram[address] = value;
 }
 
+void CPU6502::softSwitch(uint16_t address) {
+    video->handleGraphicsSoftSwitch(address);
+
+    // Re-point $2000-$3FFF when the aux bank switches in or out
+    bool aux = video->store80 && video->displayPage2 && video->hiResMode;
+    for (int page = AppleIIVideo::HIRES_PAGE1_START >> 8; page < AppleIIVideo::HIRES_PAGE1_END >> 8; page++) {
+        pageFlags[page] = aux ? (pageFlags[page] | PAGE_AUX) : (pageFlags[page] & ~PAGE_AUX);
+    }
+}
+
 uint16_t CPU6502::readWord(uint16_t address) {
     return readByte(address) | (readByte(address + 1) << 8);
 }
@@ -122,6 +145,34 @@ void CPU6502::writeWord(uint16_t address, uint16_t value) {
     writeByte(address + 1, value >> 8);
 }
 
+// True when no page in the range has any of `mask` set
+bool CPU6502::isPlainRAM(uint32_t start, uint32_t end, uint8_t mask) const {
+    for (uint32_t page = start >> 8; page <= (end - 1) >> 8; page++) {
+        if (pageFlags[page] & mask) return false;
+    }
+    return true;
+}
+
+void CPU6502::readMemory(uint16_t address, uint8_t* data, size_t length) {
+    if (isPlainRAM(address, (uint32_t)address + length, PAGE_IO | PAGE_AUX)) {
+        memcpy(data, ram + address, length);
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        data[i] = readByte(address + i);
+    }
+}
+
+void CPU6502::writeMemory(uint16_t address, const uint8_t* data, size_t length) {
+    if (isPlainRAM(address, (uint32_t)address + length, PAGE_IO | PAGE_AUX | PAGE_VIDEO)) {
+        memcpy(ram + address, data, length);
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        writeByte(address + i, data[i]);
+    }
+}
+
 // Stack
 void CPU6502::pushByte(uint8_t value) { writeByte(0x100 + regSP, value); regSP--; }
 uint8_t CPU6502::pullByte() { regSP++; return readByte(0x100 + regSP); }
@@ -223,7 +274,106 @@ void CPU6502::TXA() { regA = regX; updateZN(regA); }
 void CPU6502::TXS() { regSP = regX; }
 void CPU6502::TYA() { regA = regY; updateZN(regA); }
 
+// Loop idioms
+//
+// The loops programs copy and clear memory with:
+//   LDA (src),Y / STA (dst),Y / INY or DEY / BNE
+//   STA abs,X / DEX or INX / BNE  (and abs,Y with DEY or INY)
+// Met at their first instruction (PC past the opcode, its cycles
+// charged), every remaining pass runs as one copy or fill, charged what
+// the passes would have cost. Memory the video shows is written byte by
+// byte so it sees each change; a loop touching I/O, aux banks, its own
+// pointers or its own code runs pass by pass instead.
+
+// The index values a loop stepping by `step` visits from `first` until
+// it comes back round to 0: `count` of them, from `low` to `high`
+static void loopSpan(uint8_t first, int step, int& count, int& low, int& high) {
+    if (step > 0) {
+        count = 256 - first;
+        low = first;
+        high = 255;
+    } else {
+        count = first ? first : 256;
+        low = first ? 1 : 0;
+        high = first ? first : 255;
+    }
+}
+
+bool CPU6502::runCopyLoop() {
+    uint32_t start = (uint16_t)(regPC - 1);
+    if (!bulkLoops || start + 7 > 0x10000 || !isPlainRAM(start, start + 7, PAGE_IO | PAGE_AUX)) return false;
+    const uint8_t* code = ram + start;
+    if (code[2] != 0x91 || (code[4] != 0xC8 && code[4] != 0x88) || code[5] != 0xD0 || code[6] != 0xF9) return false;
+
+    int step = code[4] == 0xC8 ? 1 : -1;
+    int count, low, high;
+    loopSpan(regY, step, count, low, high);
+    uint32_t from = ram[code[1]] | (ram[(code[1] + 1) & 0xFF] << 8);
+    uint32_t to = ram[code[3]] | (ram[(code[3] + 1) & 0xFF] << 8);
+    if (from + high > 0xFFFF || to + high > 0xFFFF || to + low < 0x200 ||
+        !isPlainRAM(from + low, from + high + 1, PAGE_IO | PAGE_AUX) ||
+        !isPlainRAM(to + low, to + high + 1, PAGE_IO | PAGE_AUX) ||
+        (to + low < start + 7 && start < to + high + 1)) {
+        return false;
+    }
+
+    // Overlapping, the loop's byte order decides what lands where
+    bool overlap = to + low <= from + high && from + low <= to + high;
+    if (!overlap && isPlainRAM(to + low, to + high + 1, PAGE_VIDEO)) {
+        memcpy(ram + to + low, ram + from + low, high - low + 1);
+    } else {
+        uint8_t y = regY;
+        do {
+            writeByte(to + y, ram[from + y]);
+            y += step;
+        } while (y != 0);
+    }
+
+    regA = ram[from + (step > 0 ? 255 : 1)];
+    regY = 0;
+    updateZN(regY);
+    regPC = start + 7;
+    totalCycles += count * (instructionCycles[0xB1] + instructionCycles[0x91] +
+                            instructionCycles[code[4]] + instructionCycles[0xD0]) - instructionCycles[0xB1];
+    return true;
+}
+
+bool CPU6502::runFillLoop(uint8_t& index, uint8_t increment, uint8_t decrement) {
+    uint32_t start = (uint16_t)(regPC - 1);
+    if (!bulkLoops || start + 6 > 0x10000 || !isPlainRAM(start, start + 6, PAGE_IO | PAGE_AUX)) return false;
+    const uint8_t* code = ram + start;
+    if ((code[3] != increment && code[3] != decrement) || code[4] != 0xD0 || code[5] != 0xFA) return false;
+
+    int step = code[3] == increment ? 1 : -1;
+    int count, low, high;
+    loopSpan(index, step, count, low, high);
+    uint32_t base = code[1] | (code[2] << 8);
+    if (base + high > 0xFFFF || !isPlainRAM(base + low, base + high + 1, PAGE_IO | PAGE_AUX) ||
+        (base + low < start + 6 && start < base + high + 1)) {
+        return false;
+    }
+
+    if (isPlainRAM(base + low, base + high + 1, PAGE_VIDEO)) {
+        memset(ram + base + low, regA, high - low + 1);
+    } else {
+        for (uint32_t address = base + low; address <= base + high; address++) {
+            writeByte(address, regA);
+        }
+    }
+
+    index = 0;
+    updateZN(index);
+    regPC = start + 6;
+    totalCycles += count * (instructionCycles[code[0]] + instructionCycles[code[3]] +
+                            instructionCycles[0xD0]) - instructionCycles[code[0]];
+    return true;
+}
+
 void CPU6502::executeInstruction() {
+    if (hooks.isHooked(regPC) && hooks.run(*this)) {
+        return;
+    }
+
     uint8_t opcode = fetchByte();
     uint8_t cycles = instructionCycles[opcode];
     totalCycles += cycles;
@@ -307,7 +457,7 @@ void CPU6502::executeInstruction() {
     case 0x20: JSR(addrAbsolute()); break;
     case 0xA9: LDA(addrImmediate()); break; case 0xA5: LDA(addrZeroPage()); break; case 0xB5: LDA(addrZeroPageX()); break;
     case 0xAD: LDA(addrAbsolute()); break; case 0xBD: LDA(addrAbsoluteX()); break; case 0xB9: LDA(addrAbsoluteY()); break;
-    case 0xA1: LDA(addrIndirectX()); break; case 0xB1: LDA(addrIndirectY()); break;
+    case 0xA1: LDA(addrIndirectX()); break; case 0xB1: if (!runCopyLoop()) LDA(addrIndirectY()); break;
     case 0xA2: LDX(addrImmediate()); break; case 0xA6: LDX(addrZeroPage()); break; case 0xB6: LDX(addrZeroPageY()); break;
     case 0xAE: LDX(addrAbsolute()); break; case 0xBE: LDX(addrAbsoluteY()); break;
     case 0xA0: LDY(addrImmediate()); break; case 0xA4: LDY(addrZeroPage()); break; case 0xB4: LDY(addrZeroPageX()); break;
@@ -330,7 +480,8 @@ void CPU6502::executeInstruction() {
     case 0xE1: SBC(addrIndirectX()); break; case 0xF1: SBC(addrIndirectY()); break;
     case 0x38: SEC(); break; case 0xF8: SED(); break; case 0x78: SEI(); break;
     case 0x85: STA(addrZeroPage()); break; case 0x95: STA(addrZeroPageX()); break; case 0x8D: STA(addrAbsolute()); break;
-    case 0x9D: STA(addrAbsoluteX()); break; case 0x99: STA(addrAbsoluteY()); break; case 0x81: STA(addrIndirectX()); break;
+    case 0x9D: if (!runFillLoop(regX, 0xE8, 0xCA)) STA(addrAbsoluteX()); break;
+    case 0x99: if (!runFillLoop(regY, 0xC8, 0x88)) STA(addrAbsoluteY()); break; case 0x81: STA(addrIndirectX()); break;
     case 0x91: STA(addrIndirectY()); break;
     case 0x86: STX(addrZeroPage()); break; case 0x96: STX(addrZeroPageY()); break; case 0x8E: STX(addrAbsolute()); break;
     case 0x84: STY(addrZeroPage()); break; case 0x94: STY(addrZeroPageX()); break; case 0x8C: STY(addrAbsolute()); break;
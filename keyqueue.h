@@ -0,0 +1,56 @@
+// keyqueue.h - Lock-free key event queue from the UI thread to the CPU thread
+#ifndef KEYQUEUE_H
+#define KEYQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct KeyEvent {
+  uint8_t key;                     // ASCII, high bit clear
+  std::chrono::steady_clock::time_point time;  // When it was typed
+};
+
+// Bounded single-producer/single-consumer ring. The producer only writes
+// `tail` and the consumer only writes `head`, so neither side takes a
+// lock; each index is published with release and read with acquire.
+class KeyQueue {
+public:
+  static const unsigned CAPACITY = 256;      // Power of two
+
+  KeyQueue() : head(0), tail(0) {}
+
+  // Producer. False when the queue is full and the event was dropped.
+  bool push(const KeyEvent &event) {
+    unsigned t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == CAPACITY) return false;
+    events[t & (CAPACITY - 1)] = event;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer. False when there is nothing to take.
+  bool pop(KeyEvent &event) {
+    unsigned h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return false;
+    event = events[h & (CAPACITY - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Either side; exact only on the consumer
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  unsigned size() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+
+private:
+  KeyEvent events[CAPACITY];
+  std::atomic<unsigned> head;      // Next event to pop
+  std::atomic<unsigned> tail;      // Next free slot
+};
+
+#endif
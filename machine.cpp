@@ -0,0 +1,195 @@
+#include "machine.h"
+#include "applesoft.h"
+#include "hostvolume.h"
+#include "monitorhooks.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+Machine::Machine() : cpu(&video, &keyboard) {
+  hardDisk.attach(&cpu);
+}
+
+// ========== Loading ==========
+
+bool Machine::loadROM(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Error: Cannot open " << filename << "\n";
+    return false;
+  }
+  debugLog << "Loading ROM: " << filename << "\n";
+
+  std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return loadROMImage(image.data(), image.size());
+}
+
+bool Machine::loadROMImage(const uint8_t *data, size_t size) {
+  if (size > 0x10000) {
+    std::cerr << "Error: ROM too large\n";
+    return false;
+  }
+
+  disableFastMath();
+  MonitorHooks::remove(cpu);
+  cpu.memory.clear();
+  video.attachMemory(cpu.ram);     // Blank text page again, redrawn in full
+
+  // $C000-$FFFF is built once per distinct ROM and mapped into every
+  // machine that loads it; only pages a program writes become private.
+  // Empty slots read back whatever is here: RTS, unless the ROM image
+  // covers $C100-$CFFF with its own firmware.
+  const uint32_t LOAD = 0x10000 - size;
+  const uint32_t skip = LOAD < FIRMWARE_BASE ? FIRMWARE_BASE - LOAD : 0;
+  std::vector<uint8_t> firmware(0x10000 - FIRMWARE_BASE, 0);
+  std::fill(firmware.begin() + 0x100, firmware.begin() + 0x1000, 0x60);
+  memcpy(firmware.data() + (LOAD + skip - FIRMWARE_BASE), data + skip, size - skip);
+  cpu.memory.map(FIRMWARE_BASE, SharedImage::intern(firmware.data(), firmware.size()));
+
+  // An image reaching below $C000 loads that part privately
+  memcpy(cpu.ram + LOAD, data, skip);
+
+  uint16_t resetAddr = cpu.ram[0xFFFC] | (cpu.ram[0xFFFD] << 8);
+
+  cpu.regPC = resetAddr;
+  cpu.regSP = 0xFF;
+  cpu.regP = 0x24;
+
+  debugLog << "Loaded " << size << " bytes at $" << std::hex << LOAD
+           << std::dec << "\n";
+  debugLog << "Reset vector at $FFFC: $" << std::hex << resetAddr << std::dec
+           << "\n";
+  debugLog << "Monitor routines hooked: " << MonitorHooks::install(cpu) << "\n";
+  debugLog.flush();
+  return true;
+}
+
+bool Machine::loadDisk(int drive, const std::string &filename) {
+  if (drive < 0 || drive >= 2) {
+    std::cerr << "Error: Invalid drive number: " << drive << "\n";
+    return false;
+  }
+
+  debugLog << "Loading disk " << drive << ": " << filename << "\n";
+  debugLog.flush();
+
+  if (!diskController.loadDisk(drive, filename)) {
+    std::cerr << "Error: Failed to load disk: " << filename << "\n";
+    return false;
+  }
+
+  // The controller only goes into its slot once there is a disk to boot;
+  // an empty slot 6 would otherwise spin the boot ROM forever
+  cpu.slots.insert(DiskII::DEFAULT_SLOT, &diskController);
+  return true;
+}
+
+bool Machine::loadHardDisk(int drive, const std::string &filename) {
+  if (drive < 0 || drive >= HardDisk::NUM_DRIVES) {
+    std::cerr << "Error: Invalid hard disk number: " << drive << "\n";
+    return false;
+  }
+
+  debugLog << "Mounting hard disk " << drive << " in slot " << hardDisk.getSlot()
+           << ": " << filename << "\n";
+  debugLog.flush();
+
+  // A directory is served as a virtual ProDOS volume, anything else is an image
+  bool opened;
+  if (std::filesystem::is_directory(filename)) {
+    HostVolume *volume = new HostVolume();
+    hardDiskDevices[drive].reset(volume);
+    opened = volume->open(filename);
+  } else {
+    ImageBlockDevice *image = new ImageBlockDevice();
+    hardDiskDevices[drive].reset(image);
+    opened = image->open(filename);
+  }
+
+  if (!opened) {
+    std::cerr << "Error: Failed to mount hard disk: " << filename << "\n";
+    hardDiskDevices[drive].reset();
+    return false;
+  }
+
+  hardDisk.setDevice(drive, hardDiskDevices[drive].get());
+  cpu.slots.insert(hardDisk.getSlot(), &hardDisk);
+  return true;
+}
+
+// ========== Programs and Input ==========
+
+bool Machine::setProgram(const std::string &listing, std::string &error) {
+  // Tokenized now only to report errors early
+  std::vector<uint8_t> program;
+  if (!Applesoft::tokenize(listing, Applesoft::PROGRAM_START, program, error)) {
+    return false;
+  }
+  pendingProgram = listing;
+  return true;
+}
+
+void Machine::setInput(const std::string &text) {
+  if (pendingProgram.empty()) {
+    keyboard.paste(text);
+  } else {
+    inputAfterLoad = text;
+  }
+}
+
+void Machine::loadPendingProgram() {
+  std::string error;
+  if (Applesoft::load(cpu.ram, pendingProgram, error)) {
+    debugLog << "Loaded Applesoft program at $" << std::hex << Applesoft::PROGRAM_START << std::dec << "\n";
+  } else {
+    debugLog << "Applesoft load failed: " << error << "\n";
+  }
+  pendingProgram.clear();
+  keyboard.paste(inputAfterLoad);
+  inputAfterLoad.clear();
+}
+
+// ========== Fast Math ==========
+
+void Machine::enableFastMath(int cases, uint32_t seed, FastMath::Report reports[FastMath::ROUTINE_COUNT]) {
+  disableFastMath();
+  fastMath.verify(cpu, cases, seed, reports);
+
+  FastMath *math = &fastMath;
+  for (int routine = 0; routine < FastMath::ROUTINE_COUNT; routine++) {
+    if (fastMath.isEnabled(routine)) {
+      cpu.hooks.add(FastMath::ENTRY[routine], FastMath::NAMES[routine],
+                    [math](CPU6502 &cpu) { return math->execute(cpu); });
+    }
+  }
+}
+
+void Machine::disableFastMath() {
+  fastMath.disable();
+  for (int routine = 0; routine < FastMath::ROUTINE_COUNT; routine++) {
+    cpu.hooks.remove(FastMath::ENTRY[routine]);
+  }
+}
+
+// ========== Running ==========
+
+void Machine::runFrame() {
+  for (uint64_t i = 0; i < INSTRUCTIONS_PER_FRAME; i++) {
+    cpu.executeInstruction();
+  }
+  if (!pendingProgram.empty() && keyboard.isWaitingForKey()) {
+    loadPendingProgram();
+  }
+}
+
+void Machine::runCycles(uint64_t cycles) {
+  uint64_t end = cpu.totalCycles + cycles;
+  while (cpu.totalCycles < end) {
+    cpu.executeInstruction();
+  }
+  if (!pendingProgram.empty() && keyboard.isWaitingForKey()) {
+    loadPendingProgram();
+  }
+}
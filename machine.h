@@ -0,0 +1,79 @@
+// machine.h - One emulated Apple IIe: CPU, memory, video, keyboard and cards
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "cpu.h"
+#include "disk.h"
+#include "fastmath.h"
+#include "harddisk.h"
+#include "blockdev.h"
+#include "ppu.h"
+#include "videoframe.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Everything a running Apple IIe needs and nothing a frontend does: no
+// display, no threads, no pacing. Whoever owns the machine decides how
+// and where it runs (the CPU thread of the emulator, a script, ...).
+class Machine {
+public:
+  static const uint64_t INSTRUCTIONS_PER_FRAME = 20000;
+  static const uint32_t FIRMWARE_BASE = 0xC000;     // Shared from here up (see loadROMImage)
+
+  AppleIIVideo video;              // Emulated video; pages point into cpu.ram
+  AppleIIKeyboard keyboard;
+  DiskII diskController;
+  HardDisk hardDisk;
+  CPU6502 cpu;
+  FastMath fastMath;               // Hooked once enableFastMath() verifies it
+
+  Machine();
+
+  // Firmware image, loaded at the top of memory, then reset
+  bool loadROM(const std::string &filename);
+  bool loadROMImage(const uint8_t *data, size_t size);
+
+  // ROM routines run natively (see hooks.h), and copy and fill loops
+  // as one memory operation (see CPU6502::runCopyLoop). Loading a ROM
+  // hooks the monitor routines it holds (see monitorhooks.h); disabled,
+  // everything runs instruction by instruction.
+  void setHooksEnabled(bool on) {
+    cpu.hooks.setEnabled(on);
+    cpu.bulkLoops = on;
+  }
+
+  // Native Applesoft arithmetic (see fastmath.h). Each routine is first
+  // compared with the loaded ROM on `cases` random inputs, and only the
+  // ones that match it bit for bit are hooked. Loading a ROM turns
+  // every routine off again.
+  void enableFastMath(int cases, uint32_t seed, FastMath::Report reports[FastMath::ROUTINE_COUNT]);
+  void disableFastMath();
+
+  bool loadDisk(int drive, const std::string &filename);
+  bool loadHardDisk(int drive, const std::string &filename);
+
+  // Applesoft listing written into memory once the machine first waits
+  // for a key (the ROM's cold start would clear it any earlier). Text
+  // from setInput() is typed after it.
+  bool setProgram(const std::string &listing, std::string &error);
+  void setInput(const std::string &text);
+  bool hasPendingProgram() const { return !pendingProgram.empty(); }
+
+  // Run one frame's worth of instructions, or at least `cycles` cycles;
+  // either way a pending program goes in once the machine is at a prompt
+  void runFrame();
+  void runCycles(uint64_t cycles);
+
+  uint64_t cycles() const { return cpu.totalCycles; }
+  bool isWaitingForKey() const { return keyboard.isWaitingForKey(); }
+
+private:
+  std::unique_ptr<BlockDevice> hardDiskDevices[HardDisk::NUM_DRIVES];
+  std::string pendingProgram;
+  std::string inputAfterLoad;
+
+  void loadPendingProgram();
+};
+
+#endif
@@ -1,20 +1,84 @@
-#include "cpu.h"
+#include "applesoft.h"
+#include "frameexport.h"
+#include "machine.h"
+#include "ncursesview.h"
+#include "screen.h"
+#include "script.h"
+#include "videoframe.h"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
+#include <clocale>
+#include <csignal>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 #include <ncurses.h>
 #include <unistd.h>
 
-std::ofstream debugLog;
-AppleIIVideo *g_video;
+DebugLog debugLog;
+AppleIIVideo *g_video;             // Display side: renders published frames
 AppleIIKeyboard *g_keyboard;
 CPU6502 *g_cpu;
-DiskII *g_disk;
-bool g_running = true;
+FrameExchange *g_frames;
+std::atomic<bool> g_running{true};
 bool g_use_ncurses = false;
+bool g_warp = false;               // Run flat out instead of in real time
+bool g_headless = false;           // No display; frames only go to the exporter
+uint64_t g_stop_cycles = 0;        // Stop once the CPU has run this long (0: never)
+bool g_print_screen = false;       // Print the final text page and frame hash
+
+// ========== CPU Thread ==========
+
+const auto FRAME_TIME = std::chrono::milliseconds(16);
+const int FAST_MATH_CASES = 1000;  // -fastmath: random inputs per routine checked against the ROM
+
+// Runs the emulation at its own pace and publishes a snapshot of the
+// video after each frame's worth of instructions; drawing happens on the
+// UI thread and never holds the CPU up. While pasted or -input text is
+// being typed (or with -warp) frames run back to back, so bulk input
+// takes emulated time rather than wall time. The exporter, if any, gets
+// a copy of every frame for snapshots and video streams.
+void runCPU(Machine *machine, FrameExchange *frames, FrameExporter *exporter) {
+  auto deadline = std::chrono::steady_clock::now();
+
+  while (g_running) {
+    machine->runFrame();
+
+    machine->video.capture(frames->backBuffer());
+    if (exporter) {
+      exporter->submit(frames->backBuffer(), machine->cycles());
+    }
+    frames->publish();
+
+    if (g_stop_cycles && machine->cycles() >= g_stop_cycles) {
+      g_running = false;
+    }
+
+    // Flat out means no faster than the exporter takes frames; in real
+    // time it always keeps up, and a frame it can't take is dropped
+    auto now = std::chrono::steady_clock::now();
+    if (g_warp || machine->keyboard.isFeeding()) {
+      while (exporter && exporter->isBacklogged() && g_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      deadline = std::chrono::steady_clock::now();
+      continue;
+    }
+
+    // Keep to real time, but don't try to catch up after a stall
+    deadline += FRAME_TIME;
+    if (deadline < now - FRAME_TIME) {
+      deadline = now;
+    }
+    std::this_thread::sleep_until(deadline);
+  }
+}
 
 #ifdef WITH_GTK
 #include <gtk/gtk.h>
@@ -34,6 +98,16 @@ gboolean on_key_press(GtkWidget *widget, GdkEventKey *event, gpointer data) {
     return TRUE;
   }
 
+  // Paste is typed as fast as the program reads the keyboard
+  if ((event->state & GDK_CONTROL_MASK) && (event->keyval == 'v' || event->keyval == 'V')) {
+    char *text = gtk_clipboard_wait_for_text(gtk_clipboard_get(GDK_SELECTION_CLIPBOARD));
+    if (text) {
+      g_keyboard->paste(text);
+      g_free(text);
+    }
+    return TRUE;
+  }
+
   if ((event->state & GDK_CONTROL_MASK) && (event->keyval == 'q' || event->keyval == 'Q')) {
     g_running = false;
     gtk_main_quit();
@@ -56,38 +130,28 @@ gboolean on_key_press(GtkWidget *widget, GdkEventKey *event, gpointer data) {
 
   if (shouldInject) {
     g_keyboard->injectKey(key);
-    gtk_widget_queue_draw(widget);
   }
 
   return TRUE;
 }
 
-std::ifstream *g_input_file = nullptr;
-auto g_last_file_input_time = std::chrono::high_resolution_clock::now();
-const auto FILE_INPUT_DELAY = std::chrono::milliseconds(50);
-
-gboolean cpu_tick(gpointer data) {
-  const uint64_t CYCLES_PER_TICK = 20000;
-  
-  for (uint64_t i = 0; i < CYCLES_PER_TICK && g_running; i++) {
-    g_cpu->executeInstruction();
-  }
-
-  // Check for file input with delay between characters
-  auto now = std::chrono::high_resolution_clock::now();
-  if (g_input_file && g_input_file->is_open() && g_input_file->peek() != EOF &&
-      (now - g_last_file_input_time) >= FILE_INPUT_DELAY) {
-    int ch = g_input_file->get();
-    if (ch == '\n' || ch == '\r') {
-      g_keyboard->injectKey('\r');
-    } else if (ch >= 32 && ch < 127) {
-      g_keyboard->injectKey((uint8_t)ch);
-    }
-    g_last_file_input_time = now;
+const int MAX_DIRTY_RECTS = 32;
+
+gboolean display_tick(gpointer data) {
+  VideoFrame *frame = g_frames->acquire();
+  if (frame) {
+    g_video->showFrame(*frame);
   }
-  
-  gtk_widget_queue_draw((GtkWidget *)data);
-  
+
+  // Redraw only what the CPU changed; an idle screen queues nothing
+  AppleIIVideo::DirtyRect rects[MAX_DIRTY_RECTS];
+  int count = g_video->textMemory ? g_video->getDirtyRects(rects, MAX_DIRTY_RECTS) : 0;
+  const int scale = AppleIIVideo::FRAME_SCALE;
+  for (int i = 0; i < count; i++) {
+    gtk_widget_queue_draw_area((GtkWidget *)data, rects[i].x * scale, rects[i].y * scale,
+                               rects[i].w * scale, rects[i].h * scale);
+  }
+
   return g_running ? TRUE : FALSE;
 }
 
@@ -109,105 +173,78 @@ void runGTK(int argc, char *argv[]) {
   gtk_widget_grab_focus(drawing_area);
   gtk_widget_show_all(window);
 
-  g_timeout_add(16, cpu_tick, drawing_area);
+  g_timeout_add(16, display_tick, drawing_area);
 
   gtk_main();
 }
 #endif
 
+// ========== Headless ==========
+
+void on_stop_signal(int) {
+  g_running = false;
+}
+
+// No display: the CPU thread runs until -cycles, the last snapshot, or
+// SIGINT/SIGTERM, and the exporter does the drawing
+void runHeadless() {
+  signal(SIGINT, on_stop_signal);
+  signal(SIGTERM, on_stop_signal);
+  while (g_running) {
+    std::this_thread::sleep_for(FRAME_TIME);
+  }
+}
+
 class BasicSystem {
 private:
-  AppleIIVideo video;
-  AppleIIKeyboard keyboard;
-  DiskII diskController;
-  CPU6502 cpu;
-  std::ifstream inputFileStream;
+  Machine machine;                 // Run by the CPU thread
+  AppleIIVideo monitor;            // Draws published frames on the UI thread
+  FrameExchange frames;
+  FrameExporter exporter;          // Snapshots and video streams, on its own thread
 
 public:
-  BasicSystem() : cpu(&video, &keyboard, &diskController) {}
-
   bool loadROM(const std::string &filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-      std::cerr << "Error: Cannot open " << filename << "\n";
-      return false;
-    }
-
-    debugLog.open("debug.log", std::ios::trunc);
-    debugLog << "Loading ROM: " << filename << "\n";
-
-    memset(cpu.ram, 0, sizeof(cpu.ram));
-
-    for (uint16_t i = 0xC100; i < 0xD000; i++) {
-      cpu.ram[i] = 0x60;
-    }
-
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    if (size > 0x10000) {
-      std::cerr << "Error: ROM too large\n";
+    debugLog.open("debug.log");
+    if (!machine.loadROM(filename)) {
       return false;
     }
 
-    uint8_t buffer[0x10000];
-    file.read((char *)buffer, size);
-    file.close();
-
-    const uint16_t LOAD = 0x10000 - size;
-
-    for (size_t i = 0; i < size; i++) {
-      cpu.ram[LOAD + i] = buffer[i];
-    }
-
-    uint16_t resetAddr = cpu.ram[0xFFFC] | (cpu.ram[0xFFFD] << 8);
-
-    cpu.regPC = resetAddr;
-    cpu.regSP = 0xFF;
-    cpu.regP = 0x24;
-
-    debugLog << "Loaded " << size << " bytes at $" << std::hex << LOAD
-             << std::dec << "\n";
-    debugLog << "Reset vector at $FFFC: $" << std::hex << resetAddr << std::dec
-             << "\n";
-    debugLog.flush();
-
-    g_video = &video;
-    g_keyboard = &keyboard;
-    g_cpu = &cpu;
-    g_disk = &diskController;
+    g_video = &monitor;
+    g_frames = &frames;
+    g_keyboard = &machine.keyboard;
+    g_cpu = &machine.cpu;
 
     return true;
   }
 
-  bool loadDisk(int drive, const std::string &filename) {
-    if (drive < 0 || drive >= 2) {
-      std::cerr << "Error: Invalid drive number: " << drive << "\n";
-      return false;
-    }
-
-    debugLog << "Loading disk " << drive << ": " << filename << "\n";
-    debugLog.flush();
+  bool loadDisk(int drive, const std::string &filename) { return machine.loadDisk(drive, filename); }
 
-    if (!diskController.loadDisk(drive, filename)) {
-      std::cerr << "Error: Failed to load disk: " << filename << "\n";
-      return false;
-    }
+  bool loadHardDisk(int drive, const std::string &filename) { return machine.loadHardDisk(drive, filename); }
 
-    return true;
+  void setPalette(AppleIIVideo::Palette palette) {
+    monitor.setPalette(palette);
+    exporter.setPalette(palette);
   }
 
+  bool setVideoStream(const std::string &path) { return exporter.openStream(path); }
+
+  void addSnapshot(uint64_t cycle, const std::string &path) { exporter.addSnapshot(cycle, path); }
+
+  // The whole file is typed in, one key per keyboard strobe
   void setInputFile(const std::string &filename) {
-    inputFileStream.open(filename);
-    if (!inputFileStream.is_open()) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
       std::cerr << "Warning: Could not open input file: " << filename << "\n";
-    } else {
-      g_input_file = &inputFileStream;
+      return;
     }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // With -load, typing starts once the program is in memory
+    machine.setInput(text);
   }
 
   void runNCurses() {
+    setlocale(LC_ALL, "");        // UTF-8 half blocks and braille
     initscr();
     raw();
     noecho();
@@ -216,20 +253,17 @@ public:
     curs_set(0);
     set_escdelay(0);
 
-    if (has_colors()) {
-      start_color();
-      init_pair(1, COLOR_GREEN, COLOR_BLACK);
-      attron(COLOR_PAIR(1));
-    }
+    NCursesView view;
+    view.init();
 
-    const uint64_t CYCLES_PER_FRAME = 20000;
     auto lastTime = std::chrono::high_resolution_clock::now();
-    const auto FRAME_TIME = std::chrono::milliseconds(16);
 
     while (g_running) {
       int ch;
       while ((ch = getch()) != ERR) {
-        if (ch == 3) { // Ctrl+C
+        if (ch == KEY_RESIZE) {
+          view.invalidate();
+        } else if (ch == 3) { // Ctrl+C
           g_cpu->requestIRQ();
         } else if (ch == 17) { // Ctrl+Q to exit
           g_running = false;
@@ -242,32 +276,15 @@ public:
         }
       }
 
-      // Also check for input from file
-      if (inputFileStream.is_open() && inputFileStream.peek() != EOF) {
-        ch = inputFileStream.get();
-        if (ch == '\n' || ch == '\r') {
-          g_keyboard->injectKey('\r');
-        } else if (ch >= 32 && ch < 127) {
-          g_keyboard->injectKey((uint8_t)ch);
-        }
-        // Small delay to ensure character is processed
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-      }
-
-      for (uint64_t i = 0; i < CYCLES_PER_FRAME && g_running; i++) {
-        g_cpu->executeInstruction();
+      // Only cells that changed are sent to the terminal; flashing text
+      // can change without a new frame
+      VideoFrame *frame = frames.acquire();
+      if (frame) {
+        monitor.showFrame(*frame);
       }
-
-      erase();
-      for (int row = 0; row < 24; row++) {
-        for (int col = 0; col < 40; col++) {
-          int idx = row * 40 + col;
-          uint8_t c = g_video->textMemory[idx];
-          if (c < 32 || c > 126) c = ' ';
-          mvaddch(row, col, c);
-        }
+      if (monitor.textMemory) {
+        view.update(monitor);
       }
-      refresh();
 
       auto now = std::chrono::high_resolution_clock::now();
       auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastTime);
@@ -280,8 +297,117 @@ public:
     endwin();
   }
 
+  // Native floating point for the routines that match this ROM bit for
+  // bit (see fastmath.h). The report goes to the debug log, and to
+  // `out` as well when asked for or when some routine stays interpreted.
+  bool enableFastMath(int cases, uint32_t seed, std::ostream *out) {
+    FastMath::Report reports[FastMath::ROUTINE_COUNT];
+    machine.enableFastMath(cases, seed, reports);
+
+    std::ostringstream report;
+    FastMath::printReport(report, reports);
+    bool exact = true;
+    for (int routine = 0; routine < FastMath::ROUTINE_COUNT; routine++) {
+      exact = exact && machine.fastMath.isEnabled(routine);
+    }
+
+    debugLog << "Fast math, seed " << seed << ":\n" << report.str();
+    if (!out && !exact) {
+      std::cerr << "Warning: only routines that match this ROM run natively (seed " << seed << "):\n";
+      out = &std::cerr;
+    } else if (out) {
+      *out << "seed " << seed << "\n";
+    }
+    if (out) {
+      *out << report.str();
+    }
+    return exact;
+  }
+
+  void setHooksEnabled(bool on) { machine.setHooksEnabled(on); }
+
+  void logHooks() {
+    if (!machine.cpu.hooks.isEnabled()) return;
+    debugLog << "Hook calls:";
+    for (const HookTable::Hook &hook : machine.cpu.hooks.list()) {
+      debugLog << " " << hook.name << " " << hook.calls;
+    }
+    debugLog << "\n";
+  }
+
+  // Tokenized now to report errors; written into RAM at the first prompt
+  bool setProgramFile(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+      std::cerr << "Error: Cannot open " << filename << "\n";
+      return false;
+    }
+    std::string listing((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::string error;
+    if (!machine.setProgram(listing, error)) {
+      std::cerr << "Error: " << filename << ": " << error << "\n";
+      return false;
+    }
+    return true;
+  }
+
+  // The final screen for scripts: the text page, then the frame hash
+  // (after the CPU thread has stopped)
+  void printScreen() {
+    std::unique_ptr<VideoFrame> frame(new VideoFrame);
+    machine.video.capture(*frame);
+
+    Screen screen;
+    screen.setPalette(monitor.palette);
+    screen.update(*frame);
+    std::cout << screen.text();
+    printf("hash %016llx\n", (unsigned long long)screen.hash());
+  }
+
+  // Detokenize the program in memory (after the CPU thread has stopped)
+  bool saveProgram(const std::string &filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+      std::cerr << "Error: Cannot write " << filename << "\n";
+      return false;
+    }
+    file << Applesoft::save(machine.cpu.ram);
+    return true;
+  }
+
+  // Run a -script on this thread instead of the CPU thread and frontend.
+  // The machine goes flat out; only the script decides how long.
+  bool runScript(const std::string &filename) {
+    Script script;
+    script.setPalette(monitor.palette);
+    script.setCycleLimit(g_stop_cycles);
+    std::string error;
+    if (!script.load(filename, error)) {
+      std::cerr << "Error: " << error << "\n";
+      return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool passed = script.run(machine, std::cout, error);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!passed) {
+      std::cerr << error << "\n" << script.screen().text();
+    }
+    debugLog << "Script " << filename << ": " << (passed ? "passed" : "failed") << ", "
+             << script.cyclesRun() << " cycles in " << seconds << " s ("
+             << (seconds > 0 ? script.cyclesRun() / seconds / 1e6 : 0) << " MHz)\n";
+    return passed;
+  }
+
   void run(int argc, char *argv[]) {
-    if (g_use_ncurses) {
+    exporter.start();
+    std::thread cpuThread(runCPU, &machine, &frames, exporter.isActive() ? &exporter : nullptr);
+
+    if (g_headless) {
+      runHeadless();
+    } else if (g_use_ncurses) {
       runNCurses();
     }
 #ifdef WITH_GTK
@@ -294,13 +420,31 @@ public:
       runNCurses();
     }
 #endif
+
+    g_running = false;
+    cpuThread.join();
+    exporter.stop();
+    if (!g_headless) {
+      debugLog << "Average frame render time: " << monitor.frameMicros << " us\n";
+    }
   }
 };
 
 int main(int argc, char *argv[]) {
   bool use_ncurses = false;
-  int rom_idx = -1;
   std::string input_file = "";
+  std::string load_file;
+  std::string save_file;
+  std::string y4m_file;
+  std::string script_file;
+  std::vector<std::pair<uint64_t, std::string>> snapshots;
+  AppleIIVideo::Palette palette = AppleIIVideo::PALETTE_NTSC;
+  std::vector<std::string> hard_disks;
+  std::vector<std::string> positional;
+  int fast_math_cases = 0;         // -fastmath: inputs per routine compared with the ROM
+  bool fast_math_verify = false;   // Compare and report, then exit
+  uint32_t fast_math_seed = std::random_device()();
+  bool hooks = true;               // -nohooks: every ROM routine interpreted
 
   for (int i = 1; i < argc; i++) {
     std::string arg = argv[i];
@@ -309,39 +453,143 @@ int main(int argc, char *argv[]) {
       g_use_ncurses = true;
     } else if (arg == "-input" && i + 1 < argc) {
       input_file = argv[++i];
-    } else if (arg[0] != '-' && rom_idx == -1) {
-      rom_idx = i;
+    } else if (arg == "-palette" && i + 1 < argc) {
+      std::string name = argv[++i];
+      if (name == "mono") {
+        palette = AppleIIVideo::PALETTE_MONO;
+      } else if (name == "rgb") {
+        palette = AppleIIVideo::PALETTE_RGB;
+      } else if (name == "ntsc") {
+        palette = AppleIIVideo::PALETTE_NTSC;
+      } else {
+        std::cerr << "Unknown palette: " << name << " (use mono, rgb or ntsc)\n";
+        return 1;
+      }
+    } else if (arg == "-load" && i + 1 < argc) {
+      load_file = argv[++i];
+    } else if (arg == "-save" && i + 1 < argc) {
+      save_file = argv[++i];
+    } else if (arg == "-warp") {
+      g_warp = true;
+    } else if (arg == "-script" && i + 1 < argc) {
+      script_file = argv[++i];
+    } else if (arg == "-print-screen") {
+      g_print_screen = true;
+    } else if (arg == "-headless") {
+      g_headless = true;
+    } else if (arg == "-cycles" && i + 1 < argc) {
+      g_stop_cycles = strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "-y4m" && i + 1 < argc) {
+      y4m_file = argv[++i];
+    } else if (arg == "-snapshot" && i + 1 < argc) {
+      // CYCLE:file.png or CYCLE:file.ppm
+      std::string spec = argv[++i];
+      size_t colon = spec.find(':');
+      char *end = nullptr;
+      uint64_t cycle = strtoull(spec.c_str(), &end, 0);
+      if (colon == std::string::npos || colon == 0 || end != spec.c_str() + colon || colon + 1 == spec.size()) {
+        std::cerr << "Bad snapshot: " << spec << " (use CYCLE:file.png or CYCLE:file.ppm)\n";
+        return 1;
+      }
+      snapshots.push_back({cycle, spec.substr(colon + 1)});
+    } else if (arg == "-fastmath") {
+      fast_math_cases = std::max(fast_math_cases, FAST_MATH_CASES);
+    } else if (arg == "-fastmath-verify" && i + 1 < argc) {
+      fast_math_cases = std::max(1, atoi(argv[++i]));
+      fast_math_verify = true;
+    } else if (arg == "-fastmath-seed" && i + 1 < argc) {
+      fast_math_seed = strtoul(argv[++i], nullptr, 0);
+    } else if (arg == "-nohooks") {
+      hooks = false;
+    } else if (arg == "-hd" && i + 1 < argc) {
+      hard_disks.push_back(argv[++i]);
+    } else if (arg[0] != '-') {
+      positional.push_back(arg);
     }
   }
 
   BasicSystem system;
 
-  if (rom_idx == -1) {
-    std::cerr << "Usage: " << argv[0] << " [-ncurses] [-input file.bas] <rom.bin> [disk1.dsk] [disk2.dsk]\n";
+  if (positional.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [-ncurses] [-input file.bas] [-load file.bas] [-save file.bas] [-warp] [-headless] [-cycles N] [-snapshot CYCLE:file.png] [-y4m file|-] [-script file] [-print-screen] [-palette mono|rgb|ntsc] [-hd volume.po|dir] [-fastmath] [-fastmath-verify N] [-nohooks] <rom.bin> [disk1.dsk] [disk2.dsk]\n";
     std::cerr << "Example: " << argv[0] << " appleii.rom dos33.dsk\n";
     std::cerr << "Example: " << argv[0] << " -ncurses -input hello.bas appleii.rom\n";
+    std::cerr << "Example: " << argv[0] << " -load game.bas -save game-edited.bas appleii.rom\n";
+    std::cerr << "Example: " << argv[0] << " -headless -warp -snapshot 5000000:boot.png appleii.rom dos33.dsk\n";
+    std::cerr << "Example: " << argv[0] << " -headless -cycles 60000000 -y4m - appleii.rom game.dsk | ffmpeg -i - game.mp4\n";
+    std::cerr << "Example: " << argv[0] << " -script test.txt -load game.bas appleii.rom\n";
+    std::cerr << "Example: " << argv[0] << " -hd prodos32m.hdv appleii.rom\n";
+    std::cerr << "Example: " << argv[0] << " -hd boot.po -hd ./programs appleii.rom\n";
+    std::cerr << "Example: " << argv[0] << " -fastmath -script bench.txt -load mandel.bas appleii.rom\n";
+    return 1;
+  }
+
+  if (!y4m_file.empty() && !system.setVideoStream(y4m_file)) {
     return 1;
   }
+  for (const auto &snapshot : snapshots) {
+    system.addSnapshot(snapshot.first, snapshot.second);
+  }
 
-  if (!system.loadROM(argv[rom_idx])) {
+  if (!system.loadROM(positional[0])) {
     return 1;
   }
+  system.setHooksEnabled(hooks);
 
-  for (int i = rom_idx + 1; i < argc; i++) {
-    std::string arg = argv[i];
-    if (arg != "-ncurses" && arg != "-input") {
-      int disk_num = i - rom_idx - 1;
-      if (disk_num >= 2) break;
-      if (!system.loadDisk(disk_num, arg)) {
-        std::cerr << "Warning: Could not load disk " << (disk_num + 1) << "\n";
-      }
+  if (fast_math_verify) {
+    return system.enableFastMath(fast_math_cases, fast_math_seed, &std::cout) ? 0 : 1;
+  }
+  if (fast_math_cases) {
+    system.enableFastMath(fast_math_cases, fast_math_seed, nullptr);
+  }
+
+  for (size_t i = 1; i < positional.size(); i++) {
+    int disk_num = i - 1;
+    if (disk_num >= 2) break;
+    if (!system.loadDisk(disk_num, positional[i])) {
+      std::cerr << "Warning: Could not load disk " << (disk_num + 1) << "\n";
     }
   }
 
+  for (size_t i = 0; i < hard_disks.size(); i++) {
+    if (i >= HardDisk::NUM_DRIVES) break;
+    if (!system.loadHardDisk(i, hard_disks[i])) {
+      std::cerr << "Warning: Could not mount hard disk " << (i + 1) << "\n";
+    }
+  }
+
+  if (!load_file.empty() && !system.setProgramFile(load_file)) {
+    return 1;
+  }
+
   if (!input_file.empty()) {
     system.setInputFile(input_file);
   }
 
-  system.run(argc, argv);
-  return 0;
+  system.setPalette(palette);
+
+  // A headless run with nothing else to stop it ends after its last snapshot
+  if (g_headless && !g_stop_cycles && y4m_file.empty() && !snapshots.empty()) {
+    g_stop_cycles = 1;
+    for (const auto &snapshot : snapshots) {
+      g_stop_cycles = std::max(g_stop_cycles, snapshot.first);
+    }
+  }
+
+  bool passed = true;
+  if (!script_file.empty()) {
+    passed = system.runScript(script_file);
+  } else {
+    system.run(argc, argv);
+  }
+
+  if (g_print_screen) {
+    system.printScreen();
+  }
+  system.logHooks();
+
+  if (!save_file.empty() && !system.saveProgram(save_file)) {
+    return 1;
+  }
+  return passed ? 0 : 1;
 }
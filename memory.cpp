@@ -0,0 +1,127 @@
+#include "memory.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t hostPageSize() {
+    static const size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+// ========== SharedImage ==========
+
+static std::mutex internLock;
+static std::multimap<size_t, std::weak_ptr<const SharedImage>> interned;    // By content hash
+
+SharedImage::SharedImage() : fd(-1), bytes(nullptr), length(0), mappedLength(0) {}
+
+SharedImage::~SharedImage() {
+    if (fd >= 0) {
+        munmap(bytes, mappedLength);
+        close(fd);
+    } else {
+        delete[] bytes;
+    }
+}
+
+std::shared_ptr<const SharedImage> SharedImage::intern(const uint8_t* data, size_t size) {
+    size_t key = std::hash<std::string_view>()(std::string_view((const char*)data, size));
+
+    std::lock_guard<std::mutex> guard(internLock);
+    auto range = interned.equal_range(key);
+    for (auto it = range.first; it != range.second;) {
+        std::shared_ptr<const SharedImage> image = it->second.lock();
+        if (!image) {
+            it = interned.erase(it);
+            continue;
+        }
+        if (image->length == size && memcmp(image->bytes, data, size) == 0) {
+            return image;
+        }
+        ++it;
+    }
+
+    std::shared_ptr<SharedImage> image(new SharedImage);
+    image->length = size;
+    image->mappedLength = (size + hostPageSize() - 1) / hostPageSize() * hostPageSize();
+
+#ifdef __linux__
+    // A sealed memfd: no one, this process included, can change it
+    // after this, which is what makes mapping it everywhere safe
+    int fd = memfd_create("appleiie-image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0 && ftruncate(fd, image->mappedLength) == 0 &&
+        pwrite(fd, data, size, 0) == (ssize_t)size &&
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) == 0) {
+        void* view = mmap(nullptr, image->mappedLength, PROT_READ, MAP_SHARED, fd, 0);
+        if (view != MAP_FAILED) {
+            image->fd = fd;
+            image->bytes = (uint8_t*)view;
+        }
+    }
+    if (fd >= 0 && image->fd < 0) {
+        close(fd);
+    }
+#endif
+
+    // No memfd: a plain copy, which address spaces copy in turn
+    if (image->fd < 0) {
+        image->bytes = new uint8_t[size];
+        memcpy(image->bytes, data, size);
+    }
+
+    interned.emplace(key, image);
+    return image;
+}
+
+// ========== AddressSpace ==========
+
+AddressSpace::AddressSpace() : base(nullptr), mapped(false) {
+    void* map = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map != MAP_FAILED) {
+        base = (uint8_t*)map;
+        mapped = true;
+    } else {
+        base = new uint8_t[SIZE]();
+    }
+}
+
+AddressSpace::~AddressSpace() {
+    if (mapped) {
+        munmap(base, SIZE);
+    } else {
+        delete[] base;
+    }
+}
+
+void AddressSpace::clear() {
+    sharedImage.reset();
+
+    // Fresh anonymous pages in place (the address must not move: the
+    // video holds pointers into it), which also returns private copies
+    if (mapped && mmap(base, SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+        return;
+    }
+    memset(base, 0, SIZE);
+}
+
+void AddressSpace::map(uint32_t address, std::shared_ptr<const SharedImage> image) {
+    if (address >= SIZE) return;
+
+    if (mapped && image->fd >= 0 && address % hostPageSize() == 0 &&
+        address + image->mappedLength <= SIZE) {
+        void* view = mmap(base + address, image->mappedLength, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_FIXED, image->fd, 0);
+        if (view != MAP_FAILED) {
+            sharedImage = image;
+            return;
+        }
+    }
+    memcpy(base + address, image->data(), std::min<size_t>(image->size(), SIZE - address));
+}
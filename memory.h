@@ -0,0 +1,67 @@
+// memory.h - 64 KB address spaces whose firmware is shared between machines
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Immutable bytes that any number of address spaces map copy-on-write.
+// Images are interned by content, so every machine in the process that
+// loads the same ROM maps one copy, freed with the last reference.
+class SharedImage {
+public:
+    ~SharedImage();
+
+    static std::shared_ptr<const SharedImage> intern(const uint8_t* data, size_t size);
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    friend class AddressSpace;
+
+    int fd;                     // Sealed memfd, or -1 if the host has none
+    uint8_t* bytes;             // Read-only view (the mapping or a heap copy)
+    size_t length;
+    size_t mappedLength;        // Rounded up to host pages
+
+    SharedImage();
+    SharedImage(const SharedImage&) = delete;
+    SharedImage& operator=(const SharedImage&) = delete;
+};
+
+// The CPU's 64 KB, one contiguous block so `ram[address]` stays a plain
+// index. It starts as untouched anonymous memory: pages cost nothing
+// until written. A SharedImage mapped over part of it stays shared
+// until a page of it is written, when the kernel gives this space its
+// own copy of that page alone.
+class AddressSpace {
+public:
+    static const uint32_t SIZE = 0x10000;
+
+    AddressSpace();
+    ~AddressSpace();
+
+    uint8_t* data() { return base; }
+    const uint8_t* data() const { return base; }
+
+    // Back to all zeroes, dropping any mapped image
+    void clear();
+
+    // Place `image` at `address`. Shared when `address` is host page
+    // aligned and the image has a memfd; otherwise copied in.
+    void map(uint32_t address, std::shared_ptr<const SharedImage> image);
+
+    bool isShared() const { return sharedImage != nullptr; }
+
+private:
+    uint8_t* base;
+    bool mapped;                // base is an mmap (not a heap fallback)
+    std::shared_ptr<const SharedImage> sharedImage;
+
+    AddressSpace(const AddressSpace&) = delete;
+    AddressSpace& operator=(const AddressSpace&) = delete;
+};
+
+#endif
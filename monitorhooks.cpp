@@ -0,0 +1,377 @@
+#include "monitorhooks.h"
+#include "cpu.h"
+#include <cstring>
+
+// The monitor's zero page
+static const uint8_t WNDLFT = 0x20;
+static const uint8_t WNDWDTH = 0x21;
+static const uint8_t WNDTOP = 0x22;
+static const uint8_t WNDBTM = 0x23;
+static const uint8_t CH = 0x24;
+static const uint8_t CV = 0x25;
+static const uint8_t BASL = 0x28;
+static const uint8_t BASH = 0x29;
+static const uint8_t BAS2L = 0x2A;
+static const uint8_t BAS2H = 0x2B;
+
+// ========== Signatures ==========
+
+// The Autostart monitor's code for each routine and what it calls
+struct Code {
+    uint16_t address;
+    const uint8_t* bytes;
+    size_t length;
+};
+
+static const uint8_t BASCALC_BYTES[] = {        // $FBC1
+    0x48, 0x4A, 0x29, 0x03, 0x09, 0x04, 0x85, 0x29, 0x68, 0x29, 0x18, 0x90,
+    0x02, 0x69, 0x7F, 0x85, 0x28, 0x0A, 0x0A, 0x05, 0x28, 0x85, 0x28, 0x60
+};
+static const uint8_t VTAB_BYTES[] = {           // $FC22, VTABZ at $FC24
+    0xA5, 0x25, 0x20, 0xC1, 0xFB, 0x65, 0x20, 0x85, 0x28, 0x60
+};
+static const uint8_t CLREOP_HOME_BYTES[] = {    // $FC42, HOME at $FC58
+    0xA4, 0x24, 0xA5, 0x25, 0x48, 0x20, 0x24, 0xFC, 0x20, 0x9E, 0xFC, 0xA0,
+    0x00, 0x68, 0x69, 0x00, 0xC5, 0x23, 0x90, 0xF0, 0xB0, 0xCA, 0xA5, 0x22,
+    0x85, 0x25, 0xA0, 0x00, 0x84, 0x24, 0xF0, 0xE4
+};
+static const uint8_t SCROLL_BYTES[] = {         // $FC70
+    0xA5, 0x22, 0x48, 0x20, 0x24, 0xFC, 0xA5, 0x28, 0x85, 0x2A, 0xA5, 0x29,
+    0x85, 0x2B, 0xA4, 0x21, 0x88, 0x68, 0x69, 0x01, 0xC5, 0x23, 0xB0, 0x0D,
+    0x48, 0x20, 0x24, 0xFC, 0xB1, 0x28, 0x91, 0x2A, 0x88, 0x10, 0xF9, 0x30,
+    0xE1, 0xA0, 0x00, 0x20, 0x9E, 0xFC, 0xB0, 0x86
+};
+static const uint8_t CLREOL_BYTES[] = {         // $FC9C, CLEOLZ at $FC9E
+    0xA4, 0x24, 0xA9, 0xA0, 0x91, 0x28, 0xC8, 0xC4, 0x21, 0x90, 0xF9, 0x60
+};
+static const uint8_t WAIT_BYTES[] = {           // $FCA8
+    0x38, 0x48, 0xE9, 0x01, 0xD0, 0xFC, 0x68, 0xE9, 0x01, 0xD0, 0xF6, 0x60
+};
+
+static const Code SCREEN_CODE[] = {
+    {0xFBC1, BASCALC_BYTES, sizeof(BASCALC_BYTES)},
+    {0xFC22, VTAB_BYTES, sizeof(VTAB_BYTES)},
+    {0xFC42, CLREOP_HOME_BYTES, sizeof(CLREOP_HOME_BYTES)},
+    {0xFC70, SCROLL_BYTES, sizeof(SCROLL_BYTES)},
+    {0xFC9C, CLREOL_BYTES, sizeof(CLREOL_BYTES)}
+};
+static const Code WAIT_CODE[] = {
+    {0xFCA8, WAIT_BYTES, sizeof(WAIT_BYTES)}
+};
+
+template <size_t N>
+static bool matches(const CPU6502& cpu, const Code (&code)[N]) {
+    for (const Code& part : code) {
+        if (memcmp(cpu.ram + part.address, part.bytes, part.length) != 0) return false;
+    }
+    return true;
+}
+
+// ========== Native 6502 ==========
+
+// The monitor's instructions on the CPU's own registers and memory:
+// each is the instruction of the same name, flagged the way
+// instructions.cpp flags it and charged what the interpreter charges.
+// Branches only say whether they are taken.
+//
+// The inner loops also have bulk forms that leave exactly what the
+// instructions would, without a call per instruction. They only cover
+// memory where the video is all there is to tell (not I/O, aux banks or
+// the zero page and stack the routines read themselves); anywhere else
+// the loop runs instruction by instruction.
+struct Native {
+    CPU6502& cpu;
+    uint64_t cycles;
+
+    explicit Native(CPU6502& c) : cpu(c), cycles(0) {}
+
+    void tick(uint8_t opcode) { cycles += CPU6502::instructionCycles[opcode]; }
+    bool flag(uint8_t f) const { return cpu.getFlag(f); }
+    uint16_t pointer(uint8_t zp) { return cpu.readByte(zp) | (cpu.readByte((zp + 1) & 0xFF) << 8); }
+    uint16_t indirectY(uint8_t zp) { return pointer(zp) + cpu.regY; }
+
+    bool isBulk(uint32_t start, uint32_t end) const {
+        return start >= 0x200 && end <= 0x10000 &&
+               cpu.isPlainRAM(start, end, CPU6502::PAGE_IO | CPU6502::PAGE_AUX);
+    }
+    void store(uint16_t address, uint8_t value) {
+        if (cpu.ram[address] != value) {
+            cpu.ram[address] = value;
+            if (cpu.pageFlags[address >> 8] & CPU6502::PAGE_VIDEO) cpu.video->noteWrite(address);
+        }
+    }
+
+    void LDA_zp(uint8_t zp) { tick(0xA5); cpu.LDA(zp); }
+    void LDA_imm(uint8_t v) { tick(0xA9); cpu.regA = v; cpu.updateZN(v); }
+    void LDA_indy(uint8_t zp) { tick(0xB1); cpu.LDA(indirectY(zp)); }
+    void STA_zp(uint8_t zp) { tick(0x85); cpu.STA(zp); }
+    void STA_indy(uint8_t zp) { tick(0x91); cpu.STA(indirectY(zp)); }
+    void LDY_zp(uint8_t zp) { tick(0xA4); cpu.LDY(zp); }
+    void LDY_imm(uint8_t v) { tick(0xA0); cpu.regY = v; cpu.updateZN(v); }
+    void STY_zp(uint8_t zp) { tick(0x84); cpu.STY(zp); }
+    void CMP_zp(uint8_t zp) { tick(0xC5); cpu.CMP(zp); }
+    void CPY_zp(uint8_t zp) { tick(0xC4); cpu.CPY(zp); }
+    void ORA_zp(uint8_t zp) { tick(0x05); cpu.ORA(zp); }
+    void ORA_imm(uint8_t v) { tick(0x09); cpu.regA |= v; cpu.updateZN(cpu.regA); }
+    void AND_imm(uint8_t v) { tick(0x29); cpu.regA &= v; cpu.updateZN(cpu.regA); }
+    void ADC_zp(uint8_t zp) { tick(0x65); cpu.ADC(zp); }
+    void ADC_imm(uint8_t v) {
+        tick(0x69);
+        uint16_t r = cpu.regA + v + (flag(CPU6502::FLAG_CARRY) ? 1 : 0);
+        cpu.setFlag(CPU6502::FLAG_CARRY, r > 0xFF);
+        cpu.setFlag(CPU6502::FLAG_OVERFLOW, ((cpu.regA ^ r) & (v ^ r) & 0x80) != 0);
+        cpu.regA = r & 0xFF;
+        cpu.updateZN(cpu.regA);
+    }
+    void SBC_imm(uint8_t v) {
+        tick(0xE9);
+        uint16_t r = cpu.regA - v - (flag(CPU6502::FLAG_CARRY) ? 0 : 1);
+        cpu.setFlag(CPU6502::FLAG_CARRY, r <= 0xFF);
+        cpu.setFlag(CPU6502::FLAG_OVERFLOW, ((cpu.regA ^ r) & (~v ^ r) & 0x80) != 0);
+        cpu.regA = r & 0xFF;
+        cpu.updateZN(cpu.regA);
+    }
+    void LSR() { tick(0x4A); cpu.LSR_ACC(); }
+    void ASL() { tick(0x0A); cpu.ASL_ACC(); }
+    void PHA() { tick(0x48); cpu.PHA(); }
+    void PLA() { tick(0x68); cpu.PLA(); }
+    void DEY() { tick(0x88); cpu.DEY(); }
+    void INY() { tick(0xC8); cpu.INY(); }
+    void SEC() { tick(0x38); cpu.SEC(); }
+
+    bool BCC() { tick(0x90); return !flag(CPU6502::FLAG_CARRY); }
+    bool BCS() { tick(0xB0); return flag(CPU6502::FLAG_CARRY); }
+    bool BNE() { tick(0xD0); return !flag(CPU6502::FLAG_ZERO); }
+    bool BEQ() { tick(0xF0); return flag(CPU6502::FLAG_ZERO); }
+    bool BPL() { tick(0x10); return !flag(CPU6502::FLAG_NEGATIVE); }
+    bool BMI() { tick(0x30); return flag(CPU6502::FLAG_NEGATIVE); }
+
+    // Into a subroutine, whose RTS comes back to `next`; the return
+    // address is left on the stack page just as the ROM leaves it
+    void JSR(uint16_t next) { tick(0x20); cpu.pushWord(next - 1); }
+    void RTS() { tick(0x60); cpu.pullWord(); }
+
+    // The routine's own RTS, back to whoever called it
+    void finish() {
+        tick(0x60);
+        cpu.RTS();
+        cpu.totalCycles += cycles;
+    }
+};
+
+// ========== Routines ==========
+
+// BASCALC: BASL/BASH = start of text row A
+static void bascalc(Native& n) {
+    n.PHA();
+    n.LSR();
+    n.AND_imm(0x03);
+    n.ORA_imm(0x04);
+    n.STA_zp(BASH);
+    n.PLA();
+    n.AND_imm(0x18);
+    if (!n.BCC()) {
+        n.ADC_imm(0x7F);
+    }
+    n.STA_zp(BASL);
+    n.ASL();
+    n.ASL();
+    n.ORA_zp(BASL);
+    n.STA_zp(BASL);
+    n.RTS();
+}
+
+// VTABZ, up to its RTS: row A, then the window's left edge added
+static void vtabz(Native& n) {
+    n.JSR(0xFC27);
+    bascalc(n);
+    n.ADC_zp(WNDLFT);
+    n.STA_zp(BASL);
+}
+
+// CLEOLZ: spaces from column Y to the window's right edge
+static void cleolz(Native& n) {
+    n.LDA_imm(0xA0);
+    CPU6502& cpu = n.cpu;
+    uint8_t width = cpu.ram[WNDWDTH];
+    uint32_t row = n.pointer(BASL);
+    if (cpu.regY < width && n.isBulk(row + cpu.regY, row + width)) {
+        for (uint32_t address = row + cpu.regY; address < row + width; address++) {
+            n.store(address, 0xA0);
+        }
+        n.cycles += (width - cpu.regY) * (CPU6502::instructionCycles[0x91] + CPU6502::instructionCycles[0xC8] +
+                                          CPU6502::instructionCycles[0xC4] + CPU6502::instructionCycles[0x90]);
+        cpu.regY = width;
+        cpu.updateZN(0);                // CPY WNDWDTH, equal
+        cpu.SEC();
+    } else {
+        do {
+            n.STA_indy(BASL);
+            n.INY();
+            n.CPY_zp(WNDWDTH);
+        } while (n.BCC());
+    }
+    n.RTS();
+}
+
+// SCRL2: the row at BASL copied into the one at BAS2L, from column Y
+// down to 0
+static void copyRow(Native& n) {
+    CPU6502& cpu = n.cpu;
+    uint8_t last = cpu.regY;
+    uint32_t from = n.pointer(BASL);
+    uint32_t to = n.pointer(BAS2L);
+    if (last >= 0x80 || !n.isBulk(from, from + last + 1) || !n.isBulk(to, to + last + 1)) {
+        do {
+            n.LDA_indy(BASL);
+            n.STA_indy(BAS2L);
+            n.DEY();
+        } while (n.BPL());
+        return;
+    }
+    for (int column = last; column >= 0; column--) {
+        cpu.regA = cpu.ram[from + column];
+        n.store(to + column, cpu.regA);
+    }
+    n.cycles += (last + 1) * (CPU6502::instructionCycles[0xB1] + CPU6502::instructionCycles[0x91] +
+                              CPU6502::instructionCycles[0x88] + CPU6502::instructionCycles[0x10]);
+    cpu.regY = 0xFF;
+    cpu.updateZN(cpu.regY);             // DEY's flags; LDA's are overwritten
+}
+
+// CLEOP1 on: clear row A from column Y, then each row below it, and
+// VTAB back to CV on the way out
+static void clearToBottom(Native& n) {
+    do {
+        n.PHA();
+        n.JSR(0xFC4A);
+        vtabz(n);
+        n.RTS();
+        n.JSR(0xFC4D);
+        cleolz(n);
+        n.LDY_imm(0x00);
+        n.PLA();
+        n.ADC_imm(0x00);
+        n.CMP_zp(WNDBTM);
+    } while (n.BCC());
+    n.BCS();                            // Taken: the carry just ended the loop
+    n.LDA_zp(CV);
+    vtabz(n);
+    n.finish();
+}
+
+static bool clreop(CPU6502& cpu) {
+    if (!matches(cpu, SCREEN_CODE)) return false;
+    Native n(cpu);
+    n.LDY_zp(CH);
+    n.LDA_zp(CV);
+    clearToBottom(n);
+    return true;
+}
+
+static bool home(CPU6502& cpu) {
+    if (!matches(cpu, SCREEN_CODE)) return false;
+    Native n(cpu);
+    n.LDA_zp(WNDTOP);
+    n.STA_zp(CV);
+    n.LDY_imm(0x00);
+    n.STY_zp(CH);
+    n.BEQ();                            // Taken: Y is 0
+    clearToBottom(n);
+    return true;
+}
+
+static bool scroll(CPU6502& cpu) {
+    // A window reaching past the screen can send the ROM's row count
+    // round forever, which must stay the interpreter's problem
+    if (cpu.ram[WNDBTM] > 24 || !matches(cpu, SCREEN_CODE)) return false;
+    Native n(cpu);
+    n.LDA_zp(WNDTOP);
+    n.PHA();
+    n.JSR(0xFC76);
+    vtabz(n);
+    n.RTS();
+    for (;;) {
+        // The row below, copied right to left into this one
+        n.LDA_zp(BASL);
+        n.STA_zp(BAS2L);
+        n.LDA_zp(BASH);
+        n.STA_zp(BAS2H);
+        n.LDY_zp(WNDWDTH);
+        n.DEY();
+        n.PLA();
+        n.ADC_imm(0x01);
+        n.CMP_zp(WNDBTM);
+        if (n.BCS()) break;
+        n.PHA();
+        n.JSR(0xFC8C);
+        vtabz(n);
+        n.RTS();
+        copyRow(n);
+        n.BMI();                        // Taken: BPL just fell through
+    }
+
+    // The bottom row blanked, then VTAB
+    n.LDY_imm(0x00);
+    n.JSR(0xFC9A);
+    cleolz(n);
+    n.BCS();                            // Taken: CLEOLZ ends with the carry set
+    n.LDA_zp(CV);
+    vtabz(n);
+    n.finish();
+    return true;
+}
+
+// WAIT3: SBC #1 until A is 0. With the carry set and A not 0 yet, that
+// is A passes that each take one off, ending on 1 - 1.
+static void countDown(Native& n) {
+    CPU6502& cpu = n.cpu;
+    if (!cpu.getFlag(CPU6502::FLAG_CARRY) || cpu.regA == 0) {
+        do {
+            n.SBC_imm(0x01);
+        } while (n.BNE());
+        return;
+    }
+    n.cycles += cpu.regA * (CPU6502::instructionCycles[0xE9] + CPU6502::instructionCycles[0xD0]);
+    cpu.regA = 0;
+    cpu.updateZN(0);
+    cpu.setFlag(CPU6502::FLAG_OVERFLOW, false);
+}
+
+static bool wait(CPU6502& cpu) {
+    if (!matches(cpu, WAIT_CODE)) return false;
+    Native n(cpu);
+    n.SEC();
+    do {
+        n.PHA();
+        countDown(n);
+        n.PLA();
+        n.SBC_imm(0x01);
+    } while (n.BNE());
+    n.finish();
+    return true;
+}
+
+// ========== Installing ==========
+
+int MonitorHooks::install(CPU6502& cpu) {
+    int installed = 0;
+    if (matches(cpu, SCREEN_CODE)) {
+        cpu.hooks.add(CLREOP, "CLREOP", clreop);
+        cpu.hooks.add(HOME, "HOME", home);
+        cpu.hooks.add(SCROLL, "SCROLL", scroll);
+        installed += 3;
+    }
+    if (matches(cpu, WAIT_CODE)) {
+        cpu.hooks.add(WAIT, "WAIT", wait);
+        installed++;
+    }
+    return installed;
+}
+
+void MonitorHooks::remove(CPU6502& cpu) {
+    cpu.hooks.remove(CLREOP);
+    cpu.hooks.remove(HOME);
+    cpu.hooks.remove(SCROLL);
+    cpu.hooks.remove(WAIT);
+}
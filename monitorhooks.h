@@ -0,0 +1,32 @@
+// monitorhooks.h - Native SCROLL, HOME, CLREOP and WAIT for the monitor ROM
+#ifndef MONITORHOOKS_H
+#define MONITORHOOKS_H
+
+#include <cstdint>
+
+class CPU6502;
+
+// Hooks (see hooks.h) for the monitor routines that spend their time on
+// simple memory work: SCROLL moves the text window up a line, HOME and
+// CLREOP blank it, WAIT burns the delay set by A. Each runs the
+// monitor's own instructions natively, reading and writing through the
+// CPU so the video sees every changed cell, and charges the cycles the
+// interpreter would: only the fetching and decoding is gone.
+//
+// They follow the Autostart monitor's code. A hook is installed, and
+// takes over, only while the bytes at its address and in the
+// subroutines it calls are exactly that code, so a ROM with different
+// routines there, or a program that patches them, runs its own.
+class MonitorHooks {
+public:
+    static const uint16_t CLREOP = 0xFC42;
+    static const uint16_t HOME = 0xFC58;
+    static const uint16_t SCROLL = 0xFC70;
+    static const uint16_t WAIT = 0xFCA8;
+
+    // Hook each routine the memory in `cpu` holds; returns how many
+    static int install(CPU6502& cpu);
+    static void remove(CPU6502& cpu);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "ncursesview.h"
+#include <cstring>
+#include <langinfo.h>
+
+static const int TEXT_ROWS = AppleIIVideo::TEXT_HEIGHT;
+static const int TEXT_COLS = AppleIIVideo::TEXT_WIDTH;
+static const int MIXED_TEXT_ROWS = 4;
+static const int MIXED_LINES = AppleIIVideo::HIRES_HEIGHT - MIXED_TEXT_ROWS * 8;
+static const int BRAILLE_LINES = 4;                  // Scanlines per terminal row
+static const int MAX_DIRTY_RECTS = 64;
+
+static const char *const UPPER_HALF_BLOCK = "▀";
+
+// Braille dot bits for (column, row) within a 2x4 cell
+static const uint8_t BRAILLE_BITS[4][2] = {
+  {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}
+};
+
+static std::string brailleGlyph(uint8_t dots) {
+  // U+2800 + dots, as UTF-8
+  int code = 0x2800 + dots;
+  std::string glyph;
+  glyph += (char)(0xE0 | (code >> 12));
+  glyph += (char)(0x80 | ((code >> 6) & 0x3F));
+  glyph += (char)(0x80 | (code & 0x3F));
+  return glyph;
+}
+
+NCursesView::NCursesView()
+    : unicode(false), colors256(false), layout(-1), hiResScale(1), shadowCols(0),
+      nextPair(1), touched(false) {}
+
+void NCursesView::init() {
+  unicode = strcmp(nl_langinfo(CODESET), "UTF-8") == 0;
+  if (has_colors()) {
+    start_color();
+    colors256 = COLORS >= 256;
+  }
+}
+
+// ========== Colours ==========
+
+int NCursesView::terminalColor(uint32_t argb) const {
+  int r = (argb >> 16) & 0xFF;
+  int g = (argb >> 8) & 0xFF;
+  int b = argb & 0xFF;
+  if (colors256) {
+    // xterm 6x6x6 cube
+    return 16 + 36 * ((r * 5 + 127) / 255) + 6 * ((g * 5 + 127) / 255) + (b * 5 + 127) / 255;
+  }
+  return (r > 127 ? COLOR_RED : 0) | (g > 127 ? COLOR_GREEN : 0) | (b > 127 ? COLOR_BLUE : 0);
+}
+
+short NCursesView::colorPair(int fg, int bg) {
+  if (!has_colors()) return 0;
+  int key = fg << 8 | bg;
+  auto it = pairs.find(key);
+  if (it != pairs.end()) return it->second;
+
+  // Out of pairs: fall back to the terminal's default colours
+  if (nextPair >= COLOR_PAIRS) return 0;
+  init_pair(nextPair, fg, bg);
+  pairs[key] = nextPair;
+  return nextPair++;
+}
+
+// ========== Cells ==========
+
+void NCursesView::put(int row, int col, const Cell &cell) {
+  if (row >= LINES || col >= COLS) return;
+  Cell &shown = shadow[row * shadowCols + col];
+  if (!(shown != cell)) return;
+
+  shown = cell;
+  attrset(cell.attr | COLOR_PAIR(cell.pair));
+  mvaddstr(row, col, cell.glyph.c_str());
+  touched = true;
+}
+
+void NCursesView::drawText(AppleIIVideo &video, int row, int col, int screenRow) {
+  uint8_t code = video.textMemory[AppleIIVideo::textOffset(row, col)];
+  Cell cell;
+  char c = AppleIIVideo::glyphChar(code);
+  cell.glyph = std::string(1, c == 0x7F ? ' ' : c);
+  cell.attr = (AppleIIVideo::isInverse(code) || (AppleIIVideo::isFlashing(code) && video.flashOn)) ? A_REVERSE : A_NORMAL;
+  cell.pair = colorPair(video.palette == AppleIIVideo::PALETTE_MONO ? COLOR_GREEN : COLOR_WHITE, COLOR_BLACK);
+  put(screenRow, col, cell);
+}
+
+void NCursesView::drawLoRes(AppleIIVideo &video, const uint32_t *colors, int row, int col) {
+  uint8_t byte = video.textMemory[AppleIIVideo::textOffset(row, col)];
+  int top = terminalColor(colors[byte & 0x0F]);
+  int bottom = terminalColor(colors[byte >> 4]);
+  Cell cell;
+  cell.attr = A_NORMAL;
+  if (unicode) {
+    cell.glyph = UPPER_HALF_BLOCK;
+    cell.pair = colorPair(top, bottom);
+  } else {
+    cell.glyph = " ";
+    cell.pair = colorPair(top, top);
+  }
+  put(row, col, cell);
+}
+
+void NCursesView::drawHiRes(AppleIIVideo &video, int row, int col) {
+  // Dots are lit by any non-black pixel under them; the cell takes the
+  // colour most of its lit pixels share
+  uint8_t dots = 0;
+  uint32_t seen[8];
+  int counts[8];
+  int distinct = 0;
+  for (int dy = 0; dy < BRAILLE_LINES; dy++) {
+    const uint32_t *line = video.frameBuffer + (row * BRAILLE_LINES + dy) * AppleIIVideo::HIRES_WIDTH;
+    for (int dx = 0; dx < 2; dx++) {
+      for (int k = 0; k < hiResScale; k++) {
+        int x = (col * 2 + dx) * hiResScale + k;
+        if (x >= AppleIIVideo::HIRES_WIDTH) continue;
+        uint32_t pixel = line[x] & 0xFFFFFF;
+        if (!pixel) continue;
+        dots |= BRAILLE_BITS[dy][dx];
+        int i = 0;
+        while (i < distinct && seen[i] != pixel) i++;
+        if (i == distinct && distinct < 8) {
+          seen[distinct] = pixel;
+          counts[distinct++] = 0;
+        }
+        if (i < distinct) counts[i]++;
+      }
+    }
+  }
+
+  Cell cell;
+  cell.attr = A_NORMAL;
+  if (!dots) {
+    cell.glyph = " ";
+    cell.pair = colorPair(COLOR_WHITE, COLOR_BLACK);
+  } else {
+    int best = 0;
+    for (int i = 1; i < distinct; i++) {
+      if (counts[i] > counts[best]) best = i;
+    }
+    cell.glyph = unicode ? brailleGlyph(dots) : "#";
+    cell.pair = colorPair(terminalColor(seen[best]), COLOR_BLACK);
+  }
+  put(row, col, cell);
+}
+
+// ========== Update ==========
+
+bool NCursesView::update(AppleIIVideo &video) {
+  AppleIIVideo::DirtyRect rects[MAX_DIRTY_RECTS];
+  int count = video.getDirtyRects(rects, MAX_DIRTY_RECTS);
+
+  // Hi-res needs 140 columns at full resolution; halve it on narrower terminals
+  int scale = COLS >= AppleIIVideo::HIRES_WIDTH / 2 ? 1 : 2;
+  int newLayout = video.currentMode | video.fullScreen << 2 | scale << 3 | video.isDoubleHiRes() << 5;
+  if (newLayout != layout || (int)shadow.size() != LINES * COLS) {
+    layout = newLayout;
+    hiResScale = scale;
+    shadowCols = COLS;
+    shadow.assign(LINES * COLS, Cell{"", -1, A_NORMAL});
+    erase();
+    touched = true;
+    rects[0] = {0, 0, AppleIIVideo::HIRES_WIDTH, AppleIIVideo::HIRES_HEIGHT};
+    count = 1;
+  }
+  if (count == 0) {
+    return false;
+  }
+
+  video.render();
+
+  uint32_t colors[16];
+  video.loResColors(colors);
+  bool hiRes = video.currentMode == AppleIIVideo::HIRES_MODE;
+  int graphicsLines = (video.currentMode == AppleIIVideo::TEXT_MODE) ? 0
+                      : video.fullScreen ? AppleIIVideo::HIRES_HEIGHT : MIXED_LINES;
+
+  for (int i = 0; i < count; i++) {
+    const AppleIIVideo::DirtyRect &r = rects[i];
+    int bottom = r.y + r.h;
+
+    // Graphics part of the rectangle
+    if (r.y < graphicsLines) {
+      int lastLine = bottom < graphicsLines ? bottom : graphicsLines;
+      if (hiRes) {
+        int cellWidth = 2 * hiResScale;
+        for (int row = r.y / BRAILLE_LINES; row <= (lastLine - 1) / BRAILLE_LINES; row++) {
+          for (int col = r.x / cellWidth; col <= (r.x + r.w - 1) / cellWidth; col++) {
+            drawHiRes(video, row, col);
+          }
+        }
+      } else {
+        for (int row = r.y / 8; row <= (lastLine - 1) / 8; row++) {
+          for (int col = r.x / 7; col <= (r.x + r.w - 1) / 7; col++) {
+            drawLoRes(video, colors, row, col);
+          }
+        }
+      }
+    }
+
+    // Text part; under hi-res it sits below the braille rows
+    if (bottom > graphicsLines) {
+      int firstLine = r.y > graphicsLines ? r.y : graphicsLines;
+      int textTop = hiRes ? graphicsLines / BRAILLE_LINES - graphicsLines / 8 : 0;
+      for (int row = firstLine / 8; row <= (bottom - 1) / 8 && row < TEXT_ROWS; row++) {
+        for (int col = r.x / 7; col <= (r.x + r.w - 1) / 7 && col < TEXT_COLS; col++) {
+          drawText(video, row, col, textTop + row);
+        }
+      }
+    }
+  }
+
+  if (!touched) {
+    return false;
+  }
+  touched = false;
+  refresh();
+  return true;
+}
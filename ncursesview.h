@@ -0,0 +1,62 @@
+// ncursesview.h - Differential terminal display for text, lo-res and hi-res
+#ifndef NCURSESVIEW_H
+#define NCURSESVIEW_H
+
+#include "ppu.h"
+#include <cstdint>
+#include <map>
+#include <ncurses.h>
+#include <string>
+#include <vector>
+
+// Draws an AppleIIVideo into the terminal, touching only cells whose
+// content changed since the last update:
+//   text   - one character per cell, inverse/flash as reverse video
+//   lo-res - one cell per byte, an upper half block coloured top/bottom
+//   hi-res - braille, 2x4 dots per cell (2 pixels per dot on narrow
+//            terminals), coloured with the dominant dot colour
+// Colours use the 256-colour cube when the terminal has it.
+class NCursesView {
+public:
+  NCursesView();
+
+  // Call after initscr(); sets up colours and the glyph set
+  void init();
+
+  // Redraw what changed in `video` (which is rendered as a side effect).
+  // Returns false, without calling refresh(), if nothing changed.
+  bool update(AppleIIVideo &video);
+
+  // Forget the screen contents, e.g. after a terminal resize
+  void invalidate() { layout = -1; }
+
+private:
+  struct Cell {
+    std::string glyph;             // UTF-8
+    short pair;
+    attr_t attr;
+    bool operator!=(const Cell &other) const {
+      return pair != other.pair || attr != other.attr || glyph != other.glyph;
+    }
+  };
+
+  bool unicode;                    // Locale can show half blocks and braille
+  bool colors256;
+  int layout;                      // Mode, mixed, hi-res scale
+  int hiResScale;                  // Pixels per braille dot horizontally
+  std::vector<Cell> shadow;        // What the terminal shows
+  int shadowCols;
+  std::map<int, short> pairs;      // fg << 8 | bg -> colour pair
+  short nextPair;
+  bool touched;
+
+  short colorPair(int fg, int bg);
+  int terminalColor(uint32_t argb) const;
+  void put(int row, int col, const Cell &cell);
+
+  void drawText(AppleIIVideo &video, int row, int col, int screenRow);
+  void drawLoRes(AppleIIVideo &video, const uint32_t *colors, int row, int col);
+  void drawHiRes(AppleIIVideo &video, int row, int col);
+};
+
+#endif
@@ -1,16 +1,287 @@
 #include "ppu.h"
+#include "videoframe.h"
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 
+// ========== Hi-Res Lookup Tables ==========
+
+// Hi-res colours per palette: black, white, then the four artifact
+// colours indexed by (pixel column parity | high bit << 1)
+static const uint32_t HIRES_COLORS[AppleIIVideo::NUM_PALETTES][6] = {
+  // Mono: every lit pixel is green
+  {0xFF000000, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00},
+  // RGB: violet, green, blue, orange
+  {0xFF000000, 0xFFFFFFFF, 0xFFFF44FD, 0xFF14F53C, 0xFF14CFFD, 0xFFFF6A3C},
+  // NTSC composite
+  {0xFF000000, 0xFFFFFFFF, 0xFFD043E5, 0xFF2FBC1A, 0xFF2F95E5, 0xFFD06A1A},
+};
+
+// Each byte's 7 pixels depend on its 7 data bits, its high bit, the last
+// pixel of the byte to its left, the first pixel of the byte to its right
+// and whether it starts on an odd column:
+//
+//   index = data | hibit << 7 | prev << 8 | next << 9 | odd << 10
+//
+// Entries are padded to 8 pixels to keep them aligned; a byte is
+// expanded with one fixed 7-pixel copy, the same cost as monochrome.
+static const int HIRES_WINDOWS = 2048;
+
+struct HiResPixels {
+  uint32_t pixels[AppleIIVideo::NUM_PALETTES][HIRES_WINDOWS][8];
+
+  HiResPixels() {
+    for (int palette = 0; palette < AppleIIVideo::NUM_PALETTES; palette++) {
+      const uint32_t *colors = HIRES_COLORS[palette];
+      for (int index = 0; index < HIRES_WINDOWS; index++) {
+        int hibit = (index >> 7) & 1;
+        int odd = (index >> 10) & 1;
+
+        // Bits -1..7 of the window: neighbour, 7 data bits, neighbour
+        int window = ((index >> 8) & 1) | ((index & 0x7F) << 1) | (((index >> 9) & 1) << 8);
+
+        for (int bit = 0; bit < 8; bit++) {
+          bool on = bit < 7 && ((window >> (bit + 1)) & 1);
+          bool left = (window >> bit) & 1;
+          bool right = (window >> (bit + 2)) & 1;
+          int parity = (odd + bit) & 1;
+
+          uint32_t color = colors[0];
+          if (on) {
+            color = (left || right) ? colors[1] : colors[2 + (parity | hibit << 1)];
+          } else if (bit < 7 && palette == AppleIIVideo::PALETTE_NTSC && left && right) {
+            // A one-pixel gap between two dots shows their colour
+            color = colors[2 + ((parity ^ 1) | hibit << 1)];
+          }
+          pixels[palette][index][bit] = color;
+        }
+      }
+    }
+  }
+};
+
+static const HiResPixels HIRES_PIXELS;
+
+// Offset of each screen row within a hi-res page: rows interleave by
+// 8 (bits 10-12), by 64 (bits 7-9) and in thirds 40 bytes apart
+struct HiResRows {
+  uint16_t offset[AppleIIVideo::HIRES_HEIGHT];
+
+  constexpr HiResRows() : offset() {
+    for (int y = 0; y < AppleIIVideo::HIRES_HEIGHT; y++) {
+      offset[y] = ((y & 7) << 10) | (((y >> 3) & 7) << 7) | ((y >> 6) * 40);
+    }
+  }
+};
+
+static constexpr HiResRows HIRES_ROWS;
+
+// ========== Address Translation Tables ==========
+
+// Inverse maps from a page offset to the screen position it shows, built
+// at compile time. Screen holes (the last 8 bytes of every 128) map to
+// TEXT_HOLE / HIRES_HOLE.
+static const uint16_t TEXT_HOLE = 0xFFFF;
+static const uint8_t HIRES_HOLE = 0xFF;
+
+struct TextCells {
+  uint16_t cell[0x400];            // row * 40 + col
+
+  constexpr TextCells() : cell() {
+    for (int i = 0; i < 0x400; i++) cell[i] = TEXT_HOLE;
+    for (int row = 0; row < AppleIIVideo::TEXT_HEIGHT; row++) {
+      for (int col = 0; col < AppleIIVideo::TEXT_WIDTH; col++) {
+        cell[AppleIIVideo::textOffset(row, col)] = row * AppleIIVideo::TEXT_WIDTH + col;
+      }
+    }
+  }
+};
+
+static constexpr TextCells TEXT_CELLS;
+
+struct HiResLines {
+  uint8_t line[0x2000];
+
+  constexpr HiResLines() : line() {
+    for (int i = 0; i < 0x2000; i++) line[i] = HIRES_HOLE;
+    for (int y = 0; y < AppleIIVideo::HIRES_HEIGHT; y++) {
+      for (int col = 0; col < 40; col++) {
+        line[HIRES_ROWS.offset[y] + col] = y;
+      }
+    }
+  }
+};
+
+static constexpr HiResLines HIRES_LINES;
+
+// ========== Text Glyph Atlas ==========
+
+// 7x8 character cells, ASCII $20-$7F. Bit 0 is the leftmost pixel, the
+// same order as a hi-res byte, so glyph rows expand through a pixel table.
+static const uint8_t TEXT_FONT[96][8] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // ' '
+  {0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x08, 0x00},  // '!'
+  {0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00},  // '"'
+  {0x14, 0x14, 0x3E, 0x14, 0x3E, 0x14, 0x14, 0x00},  // '#'
+  {0x08, 0x3C, 0x0A, 0x1C, 0x28, 0x1E, 0x08, 0x00},  // '$'
+  {0x06, 0x26, 0x10, 0x08, 0x04, 0x32, 0x30, 0x00},  // '%'
+  {0x04, 0x0A, 0x0A, 0x04, 0x2A, 0x12, 0x2C, 0x00},  // '&'
+  {0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00},  // '\''
+  {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08, 0x00},  // '('
+  {0x08, 0x10, 0x20, 0x20, 0x20, 0x10, 0x08, 0x00},  // ')'
+  {0x08, 0x2A, 0x1C, 0x08, 0x1C, 0x2A, 0x08, 0x00},  // '*'
+  {0x00, 0x08, 0x08, 0x3E, 0x08, 0x08, 0x00, 0x00},  // '+'
+  {0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x04, 0x00},  // ','
+  {0x00, 0x00, 0x00, 0x3E, 0x00, 0x00, 0x00, 0x00},  // '-'
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00},  // '.'
+  {0x00, 0x20, 0x10, 0x08, 0x04, 0x02, 0x00, 0x00},  // '/'
+  {0x1C, 0x22, 0x32, 0x2A, 0x26, 0x22, 0x1C, 0x00},  // '0'
+  {0x08, 0x0C, 0x08, 0x08, 0x08, 0x08, 0x1C, 0x00},  // '1'
+  {0x1C, 0x22, 0x20, 0x18, 0x04, 0x02, 0x3E, 0x00},  // '2'
+  {0x3E, 0x20, 0x10, 0x18, 0x20, 0x22, 0x1C, 0x00},  // '3'
+  {0x10, 0x18, 0x14, 0x12, 0x3E, 0x10, 0x10, 0x00},  // '4'
+  {0x3E, 0x02, 0x1E, 0x20, 0x20, 0x22, 0x1C, 0x00},  // '5'
+  {0x38, 0x04, 0x02, 0x1E, 0x22, 0x22, 0x1C, 0x00},  // '6'
+  {0x3E, 0x20, 0x10, 0x08, 0x04, 0x04, 0x04, 0x00},  // '7'
+  {0x1C, 0x22, 0x22, 0x1C, 0x22, 0x22, 0x1C, 0x00},  // '8'
+  {0x1C, 0x22, 0x22, 0x3C, 0x20, 0x10, 0x0E, 0x00},  // '9'
+  {0x00, 0x00, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00},  // ':'
+  {0x00, 0x00, 0x08, 0x00, 0x08, 0x08, 0x04, 0x00},  // ';'
+  {0x10, 0x08, 0x04, 0x02, 0x04, 0x08, 0x10, 0x00},  // '<'
+  {0x00, 0x00, 0x3E, 0x00, 0x3E, 0x00, 0x00, 0x00},  // '='
+  {0x04, 0x08, 0x10, 0x20, 0x10, 0x08, 0x04, 0x00},  // '>'
+  {0x1C, 0x22, 0x10, 0x08, 0x08, 0x00, 0x08, 0x00},  // '?'
+  {0x1C, 0x22, 0x2A, 0x3A, 0x1A, 0x02, 0x3C, 0x00},  // '@'
+  {0x08, 0x14, 0x22, 0x22, 0x3E, 0x22, 0x22, 0x00},  // 'A'
+  {0x1E, 0x22, 0x22, 0x1E, 0x22, 0x22, 0x1E, 0x00},  // 'B'
+  {0x1C, 0x22, 0x02, 0x02, 0x02, 0x22, 0x1C, 0x00},  // 'C'
+  {0x1E, 0x22, 0x22, 0x22, 0x22, 0x22, 0x1E, 0x00},  // 'D'
+  {0x3E, 0x02, 0x02, 0x1E, 0x02, 0x02, 0x3E, 0x00},  // 'E'
+  {0x3E, 0x02, 0x02, 0x1E, 0x02, 0x02, 0x02, 0x00},  // 'F'
+  {0x3C, 0x02, 0x02, 0x02, 0x32, 0x22, 0x3C, 0x00},  // 'G'
+  {0x22, 0x22, 0x22, 0x3E, 0x22, 0x22, 0x22, 0x00},  // 'H'
+  {0x1C, 0x08, 0x08, 0x08, 0x08, 0x08, 0x1C, 0x00},  // 'I'
+  {0x20, 0x20, 0x20, 0x20, 0x20, 0x22, 0x1C, 0x00},  // 'J'
+  {0x22, 0x12, 0x0A, 0x06, 0x0A, 0x12, 0x22, 0x00},  // 'K'
+  {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x3E, 0x00},  // 'L'
+  {0x22, 0x36, 0x2A, 0x2A, 0x22, 0x22, 0x22, 0x00},  // 'M'
+  {0x22, 0x22, 0x26, 0x2A, 0x32, 0x22, 0x22, 0x00},  // 'N'
+  {0x1C, 0x22, 0x22, 0x22, 0x22, 0x22, 0x1C, 0x00},  // 'O'
+  {0x1E, 0x22, 0x22, 0x1E, 0x02, 0x02, 0x02, 0x00},  // 'P'
+  {0x1C, 0x22, 0x22, 0x22, 0x2A, 0x12, 0x2C, 0x00},  // 'Q'
+  {0x1E, 0x22, 0x22, 0x1E, 0x0A, 0x12, 0x22, 0x00},  // 'R'
+  {0x1C, 0x22, 0x02, 0x1C, 0x20, 0x22, 0x1C, 0x00},  // 'S'
+  {0x3E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00},  // 'T'
+  {0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x1C, 0x00},  // 'U'
+  {0x22, 0x22, 0x22, 0x22, 0x22, 0x14, 0x08, 0x00},  // 'V'
+  {0x22, 0x22, 0x22, 0x2A, 0x2A, 0x36, 0x22, 0x00},  // 'W'
+  {0x22, 0x22, 0x14, 0x08, 0x14, 0x22, 0x22, 0x00},  // 'X'
+  {0x22, 0x22, 0x14, 0x08, 0x08, 0x08, 0x08, 0x00},  // 'Y'
+  {0x3E, 0x20, 0x10, 0x08, 0x04, 0x02, 0x3E, 0x00},  // 'Z'
+  {0x3E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x3E, 0x00},  // '['
+  {0x00, 0x02, 0x04, 0x08, 0x10, 0x20, 0x00, 0x00},  // '\\'
+  {0x3E, 0x30, 0x30, 0x30, 0x30, 0x30, 0x3E, 0x00},  // ']'
+  {0x00, 0x00, 0x08, 0x14, 0x22, 0x00, 0x00, 0x00},  // '^'
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x00},  // '_'
+  {0x04, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00},  // '`'
+  {0x00, 0x00, 0x1C, 0x20, 0x3C, 0x22, 0x3C, 0x00},  // 'a'
+  {0x02, 0x02, 0x1E, 0x22, 0x22, 0x22, 0x1E, 0x00},  // 'b'
+  {0x00, 0x00, 0x3C, 0x02, 0x02, 0x02, 0x3C, 0x00},  // 'c'
+  {0x20, 0x20, 0x3C, 0x22, 0x22, 0x22, 0x3C, 0x00},  // 'd'
+  {0x00, 0x00, 0x1C, 0x22, 0x3E, 0x02, 0x3C, 0x00},  // 'e'
+  {0x18, 0x24, 0x04, 0x0E, 0x04, 0x04, 0x04, 0x00},  // 'f'
+  {0x00, 0x1C, 0x22, 0x22, 0x3C, 0x20, 0x1C, 0x00},  // 'g'
+  {0x02, 0x02, 0x1E, 0x22, 0x22, 0x22, 0x22, 0x00},  // 'h'
+  {0x08, 0x00, 0x0C, 0x08, 0x08, 0x08, 0x1C, 0x00},  // 'i'
+  {0x10, 0x00, 0x18, 0x10, 0x10, 0x12, 0x0C, 0x00},  // 'j'
+  {0x02, 0x02, 0x22, 0x12, 0x0E, 0x12, 0x22, 0x00},  // 'k'
+  {0x0C, 0x08, 0x08, 0x08, 0x08, 0x08, 0x1C, 0x00},  // 'l'
+  {0x00, 0x00, 0x16, 0x2A, 0x2A, 0x2A, 0x2A, 0x00},  // 'm'
+  {0x00, 0x00, 0x1E, 0x22, 0x22, 0x22, 0x22, 0x00},  // 'n'
+  {0x00, 0x00, 0x1C, 0x22, 0x22, 0x22, 0x1C, 0x00},  // 'o'
+  {0x00, 0x00, 0x1E, 0x22, 0x1E, 0x02, 0x02, 0x00},  // 'p'
+  {0x00, 0x00, 0x3C, 0x22, 0x3C, 0x20, 0x20, 0x00},  // 'q'
+  {0x00, 0x00, 0x3A, 0x06, 0x02, 0x02, 0x02, 0x00},  // 'r'
+  {0x00, 0x00, 0x3C, 0x02, 0x1C, 0x20, 0x1E, 0x00},  // 's'
+  {0x04, 0x04, 0x1E, 0x04, 0x04, 0x24, 0x18, 0x00},  // 't'
+  {0x00, 0x00, 0x22, 0x22, 0x22, 0x32, 0x2C, 0x00},  // 'u'
+  {0x00, 0x00, 0x22, 0x22, 0x22, 0x14, 0x08, 0x00},  // 'v'
+  {0x00, 0x00, 0x22, 0x22, 0x2A, 0x2A, 0x14, 0x00},  // 'w'
+  {0x00, 0x00, 0x22, 0x14, 0x08, 0x14, 0x22, 0x00},  // 'x'
+  {0x00, 0x00, 0x22, 0x22, 0x3C, 0x20, 0x1C, 0x00},  // 'y'
+  {0x00, 0x00, 0x3E, 0x10, 0x08, 0x04, 0x3E, 0x00},  // 'z'
+  {0x30, 0x08, 0x08, 0x04, 0x08, 0x08, 0x30, 0x00},  // '{'
+  {0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00},  // '|'
+  {0x06, 0x08, 0x08, 0x10, 0x08, 0x08, 0x06, 0x00},  // '}'
+  {0x34, 0x1A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // '~'
+  {0x00, 0x14, 0x2A, 0x14, 0x2A, 0x14, 0x00, 0x00},  // DEL
+};
+
+static const int FLASH_MILLIS = 267;    // ~1.9 Hz flash cycle
+static const int FRAMES_PER_SECOND = 60;
+
+// Row masks for every screen code in both flash phases, with inverse
+// already applied: rows[flashOn][code][row]
+struct TextGlyphs {
+  uint8_t rows[2][256][8];
+
+  TextGlyphs() {
+    for (int phase = 0; phase < 2; phase++) {
+      for (int code = 0; code < 256; code++) {
+        const uint8_t *glyph = TEXT_FONT[AppleIIVideo::glyphChar(code) - 0x20];
+        bool inverse = AppleIIVideo::isInverse(code) || (AppleIIVideo::isFlashing(code) && phase);
+        for (int row = 0; row < 8; row++) {
+          rows[phase][code][row] = inverse ? (glyph[row] ^ 0x7F) : glyph[row];
+        }
+      }
+    }
+  }
+};
+
+static const TextGlyphs TEXT_GLYPHS;
+
+// Glyph row mask -> 7 pixels (padded to 8 for alignment), green or white text
+struct TextPixels {
+  uint32_t pixels[2][128][8];
+
+  TextPixels() {
+    static const uint32_t ink[2] = {0xFF00FF00, 0xFFFFFFFF};
+    for (int color = 0; color < 2; color++) {
+      for (int mask = 0; mask < 128; mask++) {
+        for (int bit = 0; bit < 8; bit++) {
+          pixels[color][mask][bit] = (bit < 7 && (mask & (1 << bit))) ? ink[color] : 0xFF000000;
+        }
+      }
+    }
+  }
+};
+
+static const TextPixels TEXT_PIXELS;
+
 // ========== AppleIIVideo ==========
 
 AppleIIVideo::AppleIIVideo() 
-    : currentMode(TEXT_MODE), displayPage2(false), fullScreen(true), hiResMode(false), 
-      pageFlip(false), surface(nullptr), cr(nullptr), cursorPos(0) {
-  memset(textMemory, 0x20, sizeof(textMemory));
-  memset(loResMemory, 0, sizeof(loResMemory));
-  memset(hiResPage1, 0, sizeof(hiResPage1));
-  memset(hiResPage2, 0, sizeof(hiResPage2));
+    : currentMode(TEXT_MODE), textMemory(nullptr), hiResPage1(nullptr), hiResPage2(nullptr),
+      auxHiResPage1(auxMemory),
+      displayPage2(false), fullScreen(true), hiResMode(false), 
+      pageFlip(false), store80(false), col80(false), doubleHiRes(false), palette(PALETTE_NTSC),
+#ifdef WITH_GTK
+      surface(nullptr), cr(nullptr),
+#endif
+      cursorPos(0), frameMicros(0),
+      frameValid(false), shownState(0), frameSequence(0), flashOn(false), frameClock(false) {
+  // frameBuffer is left untouched: the first render() draws all of it,
+  // and machines that never render never pay for its pages
+  memset(auxMemory, 0, sizeof(auxMemory));
+  clearDirty();
+}
+
+AppleIIVideo::~AppleIIVideo() {
+#ifdef WITH_GTK
+  if (surface) {
+    cairo_surface_destroy(surface);
+  }
+#endif
 }
 
 // ========== Mode Control ==========
@@ -70,7 +341,19 @@ void AppleIIVideo::handleGraphicsSoftSwitch(uint16_t address) {
   // $C055 - PAGE 2 (display $4000-$5FFF for hi-res)
   // $C056 - LO-RES mode
   // $C057 - HI-RES mode
+  // $C05E - AN3 off: double hi-res (with 80-column on)
+  // $C05F - AN3 on: normal hi-res
+  // $C000/$C001 (write) - 80STORE off/on
+  // $C00C/$C00D (write) - 80-column off/on
   switch (address & 0xFF) {
+    case 0x00:
+    case 0x01:
+      store80 = address & 1;
+      break;
+    case 0x0C:
+    case 0x0D:
+      col80 = address & 1;
+      break;
     case 0x50:  // Graphics Mode
       debugLog << "Soft switch at $c050 -> GRAPHICS mode (LO-RES)\n";
       setLoResMode(); 
@@ -105,6 +388,12 @@ void AppleIIVideo::handleGraphicsSoftSwitch(uint16_t address) {
       setHiResMode();
       hiResMode = true;
       break;
+    case 0x5E:  // AN3 off
+      doubleHiRes = true;
+      break;
+    case 0x5F:  // AN3 on
+      doubleHiRes = false;
+      break;
   }
   debugLog.flush();
 }
@@ -112,70 +401,30 @@ void AppleIIVideo::handleGraphicsSoftSwitch(uint16_t address) {
 // ========== Text Mode Address Mapping ==========
 
 int AppleIIVideo::getRowFromAddress(uint16_t address) {
-  static const uint16_t rowStarts[24] = {
-      0x0400, 0x0480, 0x0500, 0x0580, 0x0600, 0x0680, 0x0700, 0x0780, 0x0428,
-      0x04A8, 0x0528, 0x05A8, 0x0628, 0x06A8, 0x0728, 0x07A8, 0x0450, 0x04D0,
-      0x0550, 0x05D0, 0x0650, 0x06D0, 0x0750, 0x07D0};
-
-  for (int row = 0; row < 24; ++row) {
-    uint16_t start = rowStarts[row];
-    if (address >= start && address < start + 0x28) {
-      return row;
-    }
-  }
-  return -1;
+  int linear = screenAddrToLinear(address);
+  return linear == TEXT_HOLE ? -1 : linear / TEXT_WIDTH;
 }
 
 int AppleIIVideo::getColumnFromAddress(uint16_t address) {
-  static const uint16_t rowStarts[24] = {
-      0x0400, 0x0480, 0x0500, 0x0580, 0x0600, 0x0680, 0x0700, 0x0780,
-      0x0428, 0x04A8, 0x0528, 0x05A8, 0x0628, 0x06A8, 0x0728, 0x07A8,
-      0x0450, 0x04D0, 0x0550, 0x05D0, 0x0650, 0x06D0, 0x0750, 0x07D0};
-
-  for (int row = 0; row < 24; ++row) {
-    uint16_t start = rowStarts[row];
-    if (address >= start && address < start + 0x28) {
-      return address - start;
-    }
-  }
-  return -1;
+  int linear = screenAddrToLinear(address);
+  return linear == TEXT_HOLE ? -1 : linear % TEXT_WIDTH;
 }
 
 uint16_t AppleIIVideo::screenAddrToLinear(uint16_t screenAddr) {
-  if (screenAddr < 0x400 || screenAddr >= 0x800)
-    return 0;
-
-  uint16_t row = getRowFromAddress(screenAddr);
-  uint16_t col = getColumnFromAddress(screenAddr);
-
-  if (col < 0x28) {
-    return row * 0x28 + col;
-  }
-  return 0;
+  if (screenAddr < TEXT_START || screenAddr >= TEXT_END)
+    return TEXT_HOLE;
+  return TEXT_CELLS.cell[screenAddr - TEXT_START];
 }
 
 // ========== Hi-Res Mode Address Mapping ==========
 
 int AppleIIVideo::getHiResRow(uint16_t address) {
-  uint16_t offset = address & 0x1FFF;
-  
-  int section = (offset >> 10) & 0x7;      // Bits 10-12: section (0-7)
-  int offset_in_section = offset & 0x3FF; // Bits 0-9: offset within section
-  int row_in_section = (offset_in_section >> 7) & 0x7; // Bits 7-9: row in section
-  
-  // Map section to base row using the three-way interleave
-  static const int base_rows[8] = {0, 64, 128, 8, 72, 136, 16, 80};
-  int row = base_rows[section] + row_in_section;
-  
-  if (row >= HIRES_HEIGHT) row = HIRES_HEIGHT - 1;
-  return row;
+  uint8_t y = HIRES_LINES.line[address & 0x1FFF];
+  return y == HIRES_HOLE ? -1 : y;
 }
 
 int AppleIIVideo::getHiResCol(uint16_t address) {
-  uint16_t offset = address & 0x1FFF;
-  int posInPage = offset % 0x100;
-  int colByte = posInPage % 0x80;  // 0-127 (128 bytes = 280 pixels at 7 bits per byte)
-  return colByte * 7;  // Each byte holds 7 pixels
+  return ((address & 0x7F) % 40) * 7;     // Each byte holds 7 pixels
 }
 
 uint16_t AppleIIVideo::hiResAddrToLinear(uint16_t address) {
@@ -184,64 +433,68 @@ uint16_t AppleIIVideo::hiResAddrToLinear(uint16_t address) {
 
 // ========== Memory Access ==========
 
-void AppleIIVideo::writeByte(uint16_t address, uint8_t value) {
-  // Text/Lo-Res mode writes
-  if (address >= TEXT_START && address < TEXT_END) {
-    uint16_t linearAddr = screenAddrToLinear(address);
-    if (linearAddr < 0x3C0) {
-      uint8_t displayChar = value & 0x7F;
-      textMemory[linearAddr] = displayChar;
-      // Also write to lo-res memory for graphics mode
-      loResMemory[linearAddr] = value;
-    }
-    return;
-  }
-  
-  // Hi-Res Page 1 writes
- if (address >= HIRES_PAGE1_START && address < HIRES_PAGE1_END) {
-    uint16_t offset = address - HIRES_PAGE1_START;
-    if (offset < 0x2000) {
-      hiResPage1[offset] = value;
-    }
-    return;
-  }
-  
-  // Hi-Res Page 2 writes
-  if (address >= HIRES_PAGE2_START && address < HIRES_PAGE2_END) {
-    uint16_t offset = address - HIRES_PAGE2_START;
-    if (offset < 0x2000) {
-      hiResPage2[offset] = value;
-    }
-    return;
-  }
+void AppleIIVideo::attachMemory(uint8_t *ram) {
+  textMemory = ram + TEXT_START;
+  hiResPage1 = ram + HIRES_PAGE1_START;
+  hiResPage2 = ram + HIRES_PAGE2_START;
+  memset(textMemory, 0xA0, TEXT_PAGE_BYTES);        // Normal spaces
+  frameValid = false;
 }
 
-uint8_t AppleIIVideo::readByte(uint16_t address) {
+void AppleIIVideo::noteWrite(uint16_t address) {
+  // Memory is in Apple layout, holes included; only the cell or line it
+  // shows needs looking up
   if (address >= TEXT_START && address < TEXT_END) {
-    uint16_t linearAddr = screenAddrToLinear(address);
-    if (linearAddr < 0x3C0) {
-      return textMemory[linearAddr];
-    }
-    return 0;
-  }
-  
- if (address >= HIRES_PAGE1_START && address < HIRES_PAGE1_END) {
-    uint16_t offset = address - HIRES_PAGE1_START;
-    if (offset < 0x2000) {
-      return hiResPage1[offset];
-    }
-    return 0;
+    uint16_t cell = TEXT_CELLS.cell[address - TEXT_START];
+    if (cell != TEXT_HOLE) markTextDirty(cell);
+  } else if (address >= HIRES_PAGE1_START && address < HIRES_PAGE1_END) {
+    markHiResDirty(0, address);          // Main or aux; both feed page 1
+  } else if (address >= HIRES_PAGE2_START && address < HIRES_PAGE2_END) {
+    markHiResDirty(1, address);
   }
-  
-  if (address >= HIRES_PAGE2_START && address < HIRES_PAGE2_END) {
-    uint16_t offset = address - HIRES_PAGE2_START;
-    if (offset < 0x2000) {
-      return hiResPage2[offset];
-    }
-    return 0;
+}
+
+void AppleIIVideo::capture(VideoFrame &frame) {
+  frame.sequence = ++frameSequence;
+  frame.mode = currentMode;
+  frame.displayPage2 = displayPage2;
+  frame.fullScreen = fullScreen;
+  frame.hiResMode = hiResMode;
+  frame.store80 = store80;
+  frame.col80 = col80;
+  frame.doubleHiRes = doubleHiRes;
+
+  memcpy(frame.dirtyCells, dirtyCells, sizeof(dirtyCells));
+  memcpy(frame.dirtyLines, dirtyLines, sizeof(dirtyLines));
+  clearDirty();
+
+  memcpy(frame.textMemory, textMemory, TEXT_PAGE_BYTES);
+  memcpy(frame.hiResPage1, hiResPage1, HIRES_PAGE_BYTES);
+  memcpy(frame.hiResPage2, hiResPage2, HIRES_PAGE_BYTES);
+  memcpy(frame.auxHiResPage1, auxHiResPage1, HIRES_PAGE_BYTES);
+}
+
+void AppleIIVideo::showFrame(VideoFrame &frame) {
+  textMemory = frame.textMemory;
+  hiResPage1 = frame.hiResPage1;
+  hiResPage2 = frame.hiResPage2;
+  auxHiResPage1 = frame.auxHiResPage1;
+  currentMode = frame.mode;
+  displayPage2 = frame.displayPage2;
+  fullScreen = frame.fullScreen;
+  hiResMode = frame.hiResMode;
+  store80 = frame.store80;
+  col80 = frame.col80;
+  doubleHiRes = frame.doubleHiRes;
+
+  // A skipped frame's dirty areas are lost, so redraw everything
+  if (frame.sequence == frameSequence + 1) {
+    for (int row = 0; row < TEXT_HEIGHT; row++) dirtyCells[row] |= frame.dirtyCells[row];
+    for (int i = 0; i < 6; i++) dirtyLines[i / 3][i % 3] |= frame.dirtyLines[i / 3][i % 3];
+  } else {
+    frameValid = false;
   }
-  
-  return 0;
+  frameSequence = frame.sequence;
 }
 
 // ========== Color Utilities ==========
@@ -269,147 +522,223 @@ void AppleIIVideo::getRGBForLoResColor(LoResColor color, double &r, double &g, d
 
 // ========== Display Functions ==========
 
-void AppleIIVideo::displayTextMode() {
-  if (!cr) return;
+// ========== Dirty Tracking ==========
 
-  cairo_set_source_rgb(cr, 0, 0, 0);
-  cairo_paint(cr);
+void AppleIIVideo::markTextDirty(int linear) {
+  dirtyCells[linear / TEXT_WIDTH] |= 1ULL << (linear % TEXT_WIDTH);
+}
 
-  cairo_set_source_rgb(cr, 0.0, 1.0, 0.0);
-  cairo_select_font_face(cr, "Courier", CAIRO_FONT_SLANT_NORMAL,
-                         CAIRO_FONT_WEIGHT_NORMAL);
-  cairo_set_font_size(cr, 14);
+void AppleIIVideo::markHiResDirty(int page, uint16_t address) {
+  uint8_t y = HIRES_LINES.line[address & 0x1FFF];
+  if (y != HIRES_HOLE) {
+    dirtyLines[page][y >> 6] |= 1ULL << (y & 63);
+  }
+}
 
-  double char_width = 8.5;
-  double line_height = 16.0;
-  double x_offset = 2;
-  double y_offset = 12;
+uint32_t AppleIIVideo::displayState() const {
+  // Everything that changes what the frame shows without a memory write
+  bool page2 = displayPage2 && !store80;
+  return currentMode | fullScreen << 2 | page2 << 3 | isDoubleHiRes() << 4 | palette << 5;
+}
 
-  for (int i = 0; i < 0x3C0; i++) {
-    int row = i / TEXT_WIDTH;
-    int col = i % TEXT_WIDTH;
+void AppleIIVideo::updateFlash() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  uint64_t millis = frameClock ? frameSequence * 1000 / FRAMES_PER_SECOND
+                               : std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+  bool flash = (millis / FLASH_MILLIS) & 1;
+  if (flash == flashOn) return;
+  flashOn = flash;
+
+  // Only text cells holding flashing characters change
+  for (int i = 0; i < 0x400; i++) {
+    if (isFlashing(textMemory[i]) && TEXT_CELLS.cell[i] != TEXT_HOLE) markTextDirty(TEXT_CELLS.cell[i]);
+  }
+}
 
-    uint8_t c = textMemory[i];
-    if (c < 32) c = ' ';
-    if (c > 126) c = c & 0x7F;
+int AppleIIVideo::getDirtyRects(DirtyRect *rects, int maxRects) {
+  updateFlash();
 
-    char buf[2] = {(char)c, 0};
-    double x = x_offset + (col * char_width);
-    double y = y_offset + (row * line_height);
+  if (!frameValid || displayState() != shownState) {
+    rects[0] = {0, 0, HIRES_WIDTH, HIRES_HEIGHT};
+    return 1;
+  }
 
-    cairo_move_to(cr, x, y);
-    cairo_show_text(cr, buf);
+  int count = 0;
+  bool mixed = !fullScreen;
+  int firstTextRow = (currentMode == HIRES_MODE) ? (mixed ? TEXT_HEIGHT - 4 : TEXT_HEIGHT) : 0;
+
+  // Text and lo-res: one rectangle spanning the dirty cells of each row
+  for (int row = firstTextRow; row < TEXT_HEIGHT; row++) {
+    uint64_t cells = dirtyCells[row];
+    if (!cells) continue;
+    if (count == maxRects) {
+      rects[0] = {0, 0, HIRES_WIDTH, HIRES_HEIGHT};
+      return 1;
+    }
+    int first = __builtin_ctzll(cells);
+    int last = 63 - __builtin_clzll(cells);
+    rects[count++] = {first * 7, row * 8, (last - first + 1) * 7, 8};
   }
+
+  // Hi-res: one full-width band per run of dirty scanlines
+  if (currentMode == HIRES_MODE) {
+    const uint64_t *lines = dirtyLines[(displayPage2 && !store80) ? 1 : 0];
+    int lastLine = mixed ? HIRES_HEIGHT - 32 : HIRES_HEIGHT;
+    for (int y = 0; y < lastLine; y++) {
+      if (!((lines[y >> 6] >> (y & 63)) & 1)) continue;
+      int start = y;
+      while (y + 1 < lastLine && ((lines[(y + 1) >> 6] >> ((y + 1) & 63)) & 1)) y++;
+      if (count == maxRects) {
+        rects[0] = {0, 0, HIRES_WIDTH, HIRES_HEIGHT};
+        return 1;
+      }
+      rects[count++] = {0, start, HIRES_WIDTH, y - start + 1};
+    }
+  }
+
+  return count;
 }
 
-void AppleIIVideo::displayLoResMode() {
-  if (!cr) return;
-  cairo_set_source_rgb(cr, 0, 0, 0);
-  cairo_paint(cr);
+void AppleIIVideo::clearDirty() {
+  memset(dirtyCells, 0, sizeof(dirtyCells));
+  memset(dirtyLines, 0, sizeof(dirtyLines));
+}
+
+// ========== Display Functions ==========
+
+char AppleIIVideo::glyphChar(uint8_t code) {
+  // $00-$3F inverse, $40-$7F flashing, $80-$FF normal; only $E0-$FF
+  // reach the lowercase glyphs
+  if (code >= 0xE0) return code - 0x80;
+  uint8_t c = code & 0x3F;
+  return c < 0x20 ? c + 0x40 : c;
+}
+
+void AppleIIVideo::loResColors(uint32_t *colors) {
+  for (int i = 0; i < 16; i++) {
+    double r, g, b;
+    getRGBForLoResColor((LoResColor)i, r, g, b);
+    colors[i] = 0xFF000000 | (uint32_t)(r * 255) << 16 | (uint32_t)(g * 255) << 8 | (uint32_t)(b * 255);
+    if (palette == PALETTE_MONO) colors[i] = i ? 0xFF00FF00 : 0xFF000000;
+  }
+}
+
+void AppleIIVideo::displayTextMode() {
+  renderText(0, TEXT_HEIGHT);
+}
+
+void AppleIIVideo::renderText(int firstRow, int lastRow) {
+  const uint8_t (*glyphs)[8] = TEXT_GLYPHS.rows[flashOn];
+  const uint32_t (*pixels)[8] = TEXT_PIXELS.pixels[palette == PALETTE_MONO ? 0 : 1];
+
+  // Only a cell's 7 pixels are stored, so it never touches its neighbours
+  for (int row = firstRow; row < lastRow; row++) {
+    uint64_t cells = frameValid ? dirtyCells[row] : (1ULL << TEXT_WIDTH) - 1;
+    for (; cells; cells &= cells - 1) {
+      int col = __builtin_ctzll(cells);
+      const uint8_t *glyph = glyphs[textMemory[textOffset(row, col)]];
+      uint32_t *dst = frameBuffer + row * 8 * HIRES_WIDTH + col * 7;
+      for (int y = 0; y < 8; y++, dst += HIRES_WIDTH) {
+        memcpy(dst, pixels[glyph[y]], 7 * sizeof(uint32_t));
+      }
+    }
+  }
+}
 
-  double pixel_size = 2.0;  // Scale up pixels for visibility
-  
+void AppleIIVideo::displayLoResMode() {
   // Apple II Lo-Res Memory Layout:
   // - 40 columns × 48 rows of lo-res pixels (7×4 blocks each = 280×192 display)
   // - Stored as 40 × 24 text rows (same $0400-$07FF text memory locations)
   // - Each byte contains 2 lo-res rows (4 bits each for color index)
   // - Text occupies rows 20-23 of lo-res (bottom 4 of 48 rows)
-  
-  for (int loResRow = 0; loResRow < LORES_HEIGHT; loResRow++) {
-    for (int col = 0; col < LORES_WIDTH; col++) {
-      // Convert lo-res row to text memory row
-      int textMemRow = loResRow / 2;  // 0-23
-      int nibbleInByte = loResRow & 1;  // 0=lower nibble, 1=upper nibble
-      
-      // Get the actual memory address using the text memory row start table
-      static const uint16_t rowStarts[24] = {
-          0x0400, 0x0480, 0x0500, 0x0580, 0x0600, 0x0680, 0x0700, 0x0780,
-          0x0428, 0x04A8, 0x0528, 0x05A8, 0x0628, 0x06A8, 0x0728, 0x07A8,
-          0x0450, 0x04D0, 0x0550, 0x05D0, 0x0650, 0x06D0, 0x0750, 0x07D0
-      };
-      
-      uint16_t address = rowStarts[textMemRow] + col;
-      uint16_t linearIndex = address - 0x0400;
-      if (linearIndex >= 0x400) continue;
-      
-      // Read the byte and extract the appropriate nibble
-      uint8_t byte = loResMemory[linearIndex];
-      uint8_t colorIndex = nibbleInByte ? (byte >> 4) : (byte & 0x0F);
-      
-      // Get the RGB color
-      double r, g, b;
-      getRGBForLoResColor((LoResColor)colorIndex, r, g, b);
-      cairo_set_source_rgb(cr, r, g, b);
-      
-      // Each lo-res block is 7 pixels wide × 4 pixels tall
-      double x = col * 7 * pixel_size;
-      double y = loResRow * 4 * pixel_size;
-      cairo_rectangle(cr, x, y, 7 * pixel_size, 4 * pixel_size);
-      cairo_fill(cr);
+  uint32_t colors[16];
+  loResColors(colors);
+
+  int lastRow = fullScreen ? TEXT_HEIGHT : TEXT_HEIGHT - 4;
+  for (int row = 0; row < lastRow; row++) {
+    uint64_t cells = frameValid ? dirtyCells[row] : (1ULL << TEXT_WIDTH) - 1;
+    for (; cells; cells &= cells - 1) {
+      int col = __builtin_ctzll(cells);
+      uint8_t byte = textMemory[textOffset(row, col)];
+      uint32_t *dst = frameBuffer + row * 8 * HIRES_WIDTH + col * 7;
+
+      // Lower nibble is the top 7x4 block, upper nibble the bottom one
+      for (int y = 0; y < 8; y++, dst += HIRES_WIDTH) {
+        uint32_t color = colors[(y < 4) ? (byte & 0x0F) : (byte >> 4)];
+        for (int x = 0; x < 7; x++) dst[x] = color;
+      }
     }
   }
 }
 
 void AppleIIVideo::displayHiResMode() {
-  if (!cr) return;
-  printf("High Res Mode\n");
+  int lastLine = fullScreen ? HIRES_HEIGHT : HIRES_HEIGHT - 32;
+
+  // With 80STORE on, PAGE2 banks aux memory in instead of flipping pages
+  if (isDoubleHiRes()) {
+    renderDoubleHiRes(lastLine);
+  } else {
+    bool page2 = displayPage2 && !store80;
+    renderHiRes(page2 ? hiResPage2 : hiResPage1, dirtyLines[page2 ? 1 : 0], lastLine);
+  }
+}
 
-  cairo_set_source_rgb(cr, 0, 0, 0);
-  cairo_paint(cr);
+void AppleIIVideo::renderHiRes(const uint8_t *page, const uint64_t *lines, int lastLine) {
+  const uint32_t (*pixels)[8] = HIRES_PIXELS.pixels[palette];
+
+  // Only each byte's 7 pixels are stored, so a line never touches the
+  // next one
+  for (int y = 0; y < lastLine; y++) {
+    if (frameValid && !((lines[y >> 6] >> (y & 63)) & 1)) continue;
+
+    const uint8_t *src = page + HIRES_ROWS.offset[y];
+    uint32_t *dst = frameBuffer + y * HIRES_WIDTH;
+    int prev = 0;
+    for (int col = 0; col < 40; col++) {
+      int next = (col < 39) ? (src[col + 1] & 1) : 0;
+      int index = src[col] | ((prev >> 6) & 1) << 8 | next << 9 | (col & 1) << 10;
+      memcpy(dst + col * 7, pixels[index], 7 * sizeof(uint32_t));
+      prev = src[col];
+    }
+  }
+}
 
-  // Select which page to display
-  uint8_t* displayBuffer = displayPage2 ? hiResPage2 : hiResPage1;
-  
-  cairo_set_source_rgb(cr, 0.0, 1.0, 0.0);  // Green monochrome display
-  double pixel_size = 1.0;  // 1 pixel = 1 pixel (280×192 fits in window)
-  
-  // Apple II Hi-Res Memory Layout (the THREE-WAY INTERLEAVE):
-  // The 8KB hi-res memory is organized into sections that together 
-  // cover the 192-row display. Rows are interleaved across the address space:
-  //
-  // $0000-$03FF (section 0): rows 0-7
-  // $0400-$07FF (section 1): rows 64-71
-  // $0800-$0BFF (section 2): rows 128-135
-  // $0C00-$0FFF (section 3): rows 8-15
-  // $1000-$13FF (section 4): rows 72-79
-  // $1400-$17FF (section 5): rows 136-143
-  // $1600-$1BFF (section 6): rows 16-23
-  // $1800-$1FFF (section 7): rows 80-87
-  // ... pattern continues to cover all 192 rows
-  for (int addr = 0; addr < 0x2000; addr++) {
-    uint8_t byte = displayBuffer[addr];
-    
-    // Decode the address to find which row and column this byte represents
-    int section = (addr >> 10) & 0x7;      // Bits 10-12: section (0-7)
-    int offset_in_section = addr & 0x3FF; // Bits 0-9: offset within section
-    int column = offset_in_section & 0x7F;     // Bits 0-6: column (0-127)
-    int row_in_section = (offset_in_section >> 7) & 0x7; // Bits 7-9: row in section
-    
-    // Map section number to the actual starting row for that section
-    // This implements the three-way interleave
-    static const int base_rows[8] = {0, 64, 128, 8, 72, 136, 16, 80};
-    int row = base_rows[section] + row_in_section;
-    
-    if (row >= HIRES_HEIGHT) continue;
-    
-    // Only render columns 0-39 (280 pixels / 7 bits per byte)
-    if (column >= 40) continue;
-    
-    // Render this byte's 7 pixels
-    for (int bit = 0; bit < 7; bit++) {
-      if (byte & (1 << bit)) {
-        double x = (column * 7 + bit) * pixel_size;
-        double y = row * pixel_size;
-        
-        cairo_rectangle(cr, x, y, pixel_size, pixel_size);
-        cairo_fill(cr);
+void AppleIIVideo::renderDoubleHiRes(int lastLine) {
+  // 560 dots per line: aux and main bytes alternate, 7 dots each. Every
+  // 4 dots form one of the 16 lo-res colours, drawn 2 pixels wide.
+  // Aux writes mark page 1 lines dirty.
+  uint32_t colors[16];
+  loResColors(colors);
+
+  for (int y = 0; y < lastLine; y++) {
+    if (frameValid && !((dirtyLines[0][y >> 6] >> (y & 63)) & 1)) continue;
+
+    const uint8_t *aux = auxHiResPage1 + HIRES_ROWS.offset[y];
+    const uint8_t *mainMem = hiResPage1 + HIRES_ROWS.offset[y];
+    uint32_t *dst = frameBuffer + y * HIRES_WIDTH;
+
+    // Two columns (28 dots) make a whole number of 4-dot colour cells
+    for (int col = 0; col < 40; col += 2) {
+      uint32_t dots = (aux[col] & 0x7F) | (mainMem[col] & 0x7F) << 7 |
+                      (aux[col + 1] & 0x7F) << 14 | (mainMem[col + 1] & 0x7F) << 21;
+      for (int cell = 0; cell < 7; cell++, dots >>= 4) {
+        uint32_t color = colors[dots & 0xF];
+        dst[0] = color;
+        dst[1] = color;
+        dst += 2;
       }
     }
   }
 }
 
-void AppleIIVideo::display() {
-  if (!cr) return;
+void AppleIIVideo::render() {
+  updateFlash();
+
+  uint32_t state = displayState();
+  if (state != shownState) {
+    frameValid = false;
+    shownState = state;
+  }
 
   switch (currentMode) {
     case TEXT_MODE:
@@ -422,57 +751,128 @@ void AppleIIVideo::display() {
       displayHiResMode();
       break;
   }
+
+  // Mixed mode: the bottom four text rows replace the graphics
+  if (currentMode != TEXT_MODE && !fullScreen) {
+    renderText(TEXT_HEIGHT - 4, TEXT_HEIGHT);
+  }
+
+  frameValid = true;
+  clearDirty();
+}
+
+#ifdef WITH_GTK
+void AppleIIVideo::blitFrame() {
+  if (!surface) {
+    surface = cairo_image_surface_create_for_data((unsigned char *)frameBuffer, CAIRO_FORMAT_ARGB32,
+                                                  HIRES_WIDTH, HIRES_HEIGHT, HIRES_WIDTH * sizeof(uint32_t));
+  }
+  cairo_surface_mark_dirty(surface);
+
+  cairo_set_source_rgb(cr, 0, 0, 0);
+  cairo_paint(cr);
+
+  cairo_save(cr);
+  cairo_scale(cr, FRAME_SCALE, FRAME_SCALE);
+  cairo_set_source_surface(cr, surface, 0, 0);
+  cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_NEAREST);
+  cairo_paint(cr);
+  cairo_restore(cr);
+}
+
+void AppleIIVideo::display() {
+  if (!cr || !textMemory) return;
+
+  // Only dirty cells and lines are rendered; the blit is clipped by GTK
+  // to the areas the frontend queued
+  auto start = std::chrono::steady_clock::now();
+  render();
+  blitFrame();
+
+  double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  frameMicros = frameMicros ? frameMicros * 0.95 + micros * 0.05 : micros;
 }
 
 void AppleIIVideo::initCairo(cairo_t *cairo_ctx) {
   cr = cairo_ctx;
 }
+#endif
 
 void AppleIIVideo::clear() {
-  memset(textMemory, 0x20, sizeof(textMemory));
-  memset(loResMemory, 0, sizeof(loResMemory));
-  memset(hiResPage1, 0, sizeof(hiResPage1));
-  memset(hiResPage2, 0, sizeof(hiResPage2));
+  memset(textMemory, 0xA0, TEXT_PAGE_BYTES);
+  memset(hiResPage1, 0, HIRES_PAGE_BYTES);
+  memset(hiResPage2, 0, HIRES_PAGE_BYTES);
   cursorPos = 0;
+  frameValid = false;
 }
 
 void AppleIIVideo::scrollUp() {
-  static const uint16_t rowStarts[24] = {
-      0x0400, 0x0480, 0x0500, 0x0580, 0x0600, 0x0680, 0x0700, 0x0780,
-      0x0428, 0x04A8, 0x0528, 0x05A8, 0x0628, 0x06A8, 0x0728, 0x07A8,
-      0x0450, 0x04D0, 0x0550, 0x05D0, 0x0650, 0x06D0, 0x0750, 0x07D0};
-
-  for (int page = 0; page < 3; page++) {
-    uint16_t pageBase = 0x0400 + (page * 0x100);
-
-    for (int rowInPage = 0; rowInPage < 3; rowInPage++) {
-      uint16_t currentRowOffset = pageBase + (rowInPage * 0x80);
-      uint16_t nextRowOffset = pageBase + ((rowInPage + 1) * 0x80);
-
-      memcpy((uint8_t *)textMemory + currentRowOffset,
-             (uint8_t *)textMemory + nextRowOffset, 0x28);
-    }
-
-    uint16_t lastRowOffset = pageBase + (3 * 0x80);
-    memset((uint8_t *)textMemory + lastRowOffset, 0x20, 0x28);
+  for (int row = 0; row < TEXT_HEIGHT - 1; row++) {
+    memcpy(textMemory + textOffset(row, 0), textMemory + textOffset(row + 1, 0), TEXT_WIDTH);
+  }
+  memset(textMemory + textOffset(TEXT_HEIGHT - 1, 0), 0xA0, TEXT_WIDTH);
+  for (int row = 0; row < TEXT_HEIGHT; row++) {
+    dirtyCells[row] = (1ULL << TEXT_WIDTH) - 1;
   }
 
-  cursorPos = rowStarts[23];
+  cursorPos = TEXT_START + textOffset(TEXT_HEIGHT - 1, 0);
 }
 
 // ========== AppleIIKeyboard ==========
 
-AppleIIKeyboard::AppleIIKeyboard() : lastKey(0), keyWaiting(false) {}
+AppleIIKeyboard::AppleIIKeyboard()
+    : lastKey(0), polledEmpty(false), pastePending(false), typingOverflowed(false), feedPos(0) {}
 
 uint8_t AppleIIKeyboard::readKeyboard() { 
+  // Latch the next key once the previous one has been strobed: typed
+  // keys first, then pasted text
+  if (!(lastKey & 0x80)) {
+    KeyEvent event;
+    uint8_t key;
+    if (queue.pop(event)) {
+      lastKey = event.key | 0x80;
+      auto waited = std::chrono::steady_clock::now() - event.time;
+      debugLog << "Key $" << std::hex << (int)event.key << std::dec << " latched after "
+               << std::chrono::duration_cast<std::chrono::microseconds>(waited).count() << " us\n";
+    } else if (nextFeedKey(key)) {
+      lastKey = key | 0x80;
+    }
+  }
+  polledEmpty = !(lastKey & 0x80);
   return lastKey; 
 }
 
+bool AppleIIKeyboard::nextFeedKey(uint8_t &key) {
+  if (feedPos == feed.size()) {
+    if (!pastePending && !typingOverflowed) return false;
+    std::lock_guard<std::mutex> guard(pasteLock);
+
+    // Keys queued before typing overflowed go first. The queue may have
+    // filled since readKeyboard() found it empty, but it cannot grow
+    // again until the flag is cleared below.
+    if (typingOverflowed && !queue.empty()) return false;
+    if (!pastePending) {
+      // Every overflowed key has been fed: typing can use the queue again
+      typingOverflowed = false;
+      return false;
+    }
+    feed.swap(pasteText);
+    pasteText.clear();
+    feedPos = 0;
+    pastePending = false;
+  }
+
+  // Text is already filtered to keys the Apple II can type
+  key = feed[feedPos++];
+  if (feedPos == feed.size()) {
+    feed.clear();
+    feedPos = 0;
+  }
+  return true;
+}
+
 void AppleIIKeyboard::strobeKeyboard() {
-  lastKey = lastKey & 0x7F;
-  keyWaiting = false;
-  debugLog << "Keyboard strobe: key cleared\n";
-  debugLog.flush();
+  lastKey &= 0x7F;
 }
 
 void AppleIIKeyboard::injectKey(uint8_t key) {
@@ -480,11 +880,36 @@ void AppleIIKeyboard::injectKey(uint8_t key) {
     key = '\r';
   }
 
-  lastKey = key | 0x80;
-  keyWaiting = true;
-  /*debugLog << "Key injected: $" << std::hex << (int)lastKey << std::dec
-           << " ('" << (char)(key & 0x7F) << "')\n";
-  debugLog.flush(); */
+  // Once typing has overflowed into the paste buffer it stays there
+  // until the CPU thread has fed all of it, so keys cannot overtake
+  // each other. The flag is only cleared under the lock, with nothing
+  // left to feed.
+  if (!typingOverflowed && queue.push(KeyEvent{(uint8_t)(key & 0x7F), std::chrono::steady_clock::now()})) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(pasteLock);
+  typingOverflowed = true;
+  pasteText += (char)(key & 0x7F);
+  pastePending = true;
+}
+
+void AppleIIKeyboard::paste(const std::string &text) {
+  std::string keys;
+  keys.reserve(text.size());
+  for (size_t i = 0; i < text.size(); i++) {
+    char c = text[i];
+    if (c == '\r' && i + 1 < text.size() && text[i + 1] == '\n') continue;
+    if (c == '\n' || c == '\r') {
+      keys += '\r';
+    } else if (c == 0x08 || c == 0x7F || (c >= 32 && c < 127)) {
+      keys += c;
+    }
+  }
+  if (keys.empty()) return;
+
+  std::lock_guard<std::mutex> guard(pasteLock);
+  pasteText += keys;
+  pastePending = true;
 }
 
 void AppleIIKeyboard::checkForInput() {
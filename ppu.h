@@ -1,14 +1,20 @@
 #ifndef PPU_HPP
 #define PPU_HPP
 
-#include <cairo.h>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
-#include <gtk/gtk.h>
+#ifdef WITH_GTK
+#include <cairo.h>
+#endif
+#include <atomic>
+#include <mutex>
 #include <queue>
+#include <string>
+#include "debuglog.h"
+#include "keyqueue.h"
 
-extern std::ofstream debugLog;
+struct VideoFrame;
 
 class AppleIIVideo {
 public:
@@ -19,6 +25,14 @@ public:
     HIRES_MODE = 2      // 280x192 high-res graphics (monochrome)
   };
 
+  // Hi-res colour rendering
+  enum Palette {
+    PALETTE_MONO = 0,   // Green monochrome monitor
+    PALETTE_RGB = 1,    // Idealised colours, no colour fringing
+    PALETTE_NTSC = 2,   // Composite colours; single-pixel gaps fill in
+    NUM_PALETTES = 3
+  };
+
   enum ScreenMode {
     SPLITSCREEN = 0,
     FULLSCREEN = 1
@@ -73,25 +87,60 @@ public:
     WHITE = 0xF
   };
 
-  // Video state
+  static const int TEXT_PAGE_BYTES = 0x400;
+  static const int HIRES_PAGE_BYTES = 0x2000;
+
+  // Video state. The pages are views: into the CPU's RAM for the
+  // emulated video (see attachMemory), or into a VideoFrame for the copy
+  // that draws on the UI thread (see showFrame). Only aux memory lives here.
   VideoMode currentMode;
-  uint8_t textMemory[0x400];       // Text memory (40x24 = 960 bytes, fits in 0x400)
-  uint8_t loResMemory[0x400];      // Lo-res graphics shares same space as text
-  uint8_t hiResPage1[0x2000];      // Hi-res page 1 (8KB)
-  uint8_t hiResPage2[0x2000];      // Hi-res page 2 (8KB)
+  uint8_t *textMemory;             // Text/lo-res page in Apple layout ($0400-$07FF)
+  uint8_t *hiResPage1;             // Hi-res page 1 ($2000-$3FFF)
+  uint8_t *hiResPage2;             // Hi-res page 2 ($4000-$5FFF)
+  uint8_t *auxHiResPage1;          // Aux hi-res page 1 (double hi-res)
+  uint8_t auxMemory[HIRES_PAGE_BYTES];
   
   bool displayPage2;               // True = show page 2, False = show page 1
   bool hiResMode;                  // Mixed/hi-res mode flag
   bool pageFlip;                   // Page 2 flag (soft switch $C05F)
   bool fullScreen;                 // Split or Fullscreen
+  bool store80;                    // 80STORE: PAGE2 selects aux memory ($C000/$C001)
+  bool col80;                      // 80-column hardware on ($C00C/$C00D)
+  bool doubleHiRes;                // AN3 off ($C05E) selects double hi-res
+  Palette palette;
 
   
-  // Rendering
-  cairo_surface_t *surface;
+  // Rendering. render() needs no display; headless builds leave out
+  // the Cairo blit.
+#ifdef WITH_GTK
+  cairo_surface_t *surface;        // Wraps frameBuffer for blitting
   cairo_t *cr;
+#endif
   uint16_t cursorPos;
 
+  // 280x192 ARGB frame
+  static const int FRAME_SCALE = 2;
+  uint32_t frameBuffer[HIRES_WIDTH * HIRES_HEIGHT];
+  double frameMicros;              // Average render + blit time
+
+  // Dirty tracking: memory writes that change a byte mark its text cell
+  // (40 bits per row) or hi-res scanline (192 bits per page). While the
+  // frame still shows the same mode, only those are redrawn, so a
+  // renderer must write nothing outside the cell or line it draws: the
+  // frame would then depend on which parts were redrawn when.
+  struct DirtyRect {
+    int x, y, w, h;                // In frame pixels (before FRAME_SCALE)
+  };
+  uint64_t dirtyCells[TEXT_HEIGHT];
+  uint64_t dirtyLines[2][3];
+  bool frameValid;                 // frameBuffer matches shownState
+  uint32_t shownState;
+  uint64_t frameSequence;          // Last frame captured or shown
+  bool flashOn;
+  bool frameClock;                 // Flash by frame sequence, not wall time
+
   AppleIIVideo();
+  ~AppleIIVideo();
 
   // Mode control
   void setTextMode();
@@ -105,6 +154,11 @@ public:
   void handleGraphicsSoftSwitch(uint16_t address);
 
   // Text mode functions (existing)
+  // Offset of a text cell in the page: rows interleave by 8 (bits 7-9)
+  // and in thirds 40 bytes apart, like hi-res
+  static constexpr int textOffset(int row, int col) {
+    return ((row & 7) << 7) + (row >> 3) * 40 + col;
+  }
   int getRowFromAddress(uint16_t address);
   int getColumnFromAddress(uint16_t address);
   uint16_t screenAddrToLinear(uint16_t screenAddr);
@@ -114,16 +168,47 @@ public:
   int getHiResCol(uint16_t address);
   uint16_t hiResAddrToLinear(uint16_t address);
   
-  // Memory access
-  void writeByte(uint16_t address, uint8_t value);
-  uint8_t readByte(uint16_t address);
+  // Memory access: the CPU stores straight into RAM and reports each
+  // changed byte in a video page so its cell or scanline is redrawn
+  void attachMemory(uint8_t *ram);
+  void noteWrite(uint16_t address);
+
+  // Frame hand-off between threads: capture() snapshots this video's
+  // memory, switches and dirty areas; showFrame() points a display-side
+  // video at a snapshot, merging its dirty areas when no frame was skipped
+  void capture(VideoFrame &frame);
+  void showFrame(VideoFrame &frame);
   
   // Rendering
+#ifdef WITH_GTK
   void initCairo(cairo_t *cairo_ctx);
   void display();
+  void blitFrame();
+#endif
+  void render();                   // Bring frameBuffer up to date
   void displayTextMode();
   void displayLoResMode();
   void displayHiResMode();
+  void renderHiRes(const uint8_t *page, const uint64_t *lines, int lastLine);
+  void renderDoubleHiRes(int lastLine);
+  void renderText(int firstRow, int lastRow);
+  void loResColors(uint32_t *colors);
+
+  // Areas changed since the last render(), or 0 when the screen is idle
+  int getDirtyRects(DirtyRect *rects, int maxRects);
+  void markTextDirty(int linear);
+  void markHiResDirty(int page, uint16_t address);
+  void clearDirty();
+  uint32_t displayState() const;
+  void updateFlash();
+  bool isDoubleHiRes() const { return doubleHiRes && col80 && hiResMode; }
+  void setPalette(Palette newPalette) { palette = newPalette; }
+  void setFrameClock(bool enabled) { frameClock = enabled; }
+
+  // Screen code -> ASCII character and display style
+  static char glyphChar(uint8_t code);
+  static bool isInverse(uint8_t code) { return code < 0x40; }
+  static bool isFlashing(uint8_t code) { return code >= 0x40 && code < 0x80; }
   void clear();
   void scrollUp();
   
@@ -132,17 +217,43 @@ public:
   void setFullScreen(bool screenmode);
 };
 
+// Keys typed on the UI thread wait in a lock-free queue. The CPU thread
+// latches the next one into $C000 once the program has cleared the
+// strobe at $C010, so fast typing and pastes are never lost.
+//
+// Bulk text (-input files, clipboard pastes, typing that overflows the
+// queue) goes to a paste buffer instead. It is fed one key per strobe,
+// as fast as the program reads it, after any typed keys. Typing that
+// has overflowed keeps going there until the buffer is drained.
 class AppleIIKeyboard {
 private:
-  uint8_t lastKey;
-  bool keyWaiting;
+  KeyQueue queue;
+  uint8_t lastKey;                 // $C000 latch; bit 7 is the strobe
+  bool polledEmpty;                // Last $C000 read found no key
+
+  // Paste buffer: handed over under the lock, drained by the CPU thread
+  std::mutex pasteLock;
+  std::string pasteText;
+  std::atomic<bool> pastePending;
+  std::atomic<bool> typingOverflowed;  // Typed keys go to the paste buffer
+  std::string feed;                // CPU thread only
+  size_t feedPos;
+
+  bool nextFeedKey(uint8_t &key);
 
 public:
   AppleIIKeyboard();
 
+  // CPU thread
   uint8_t readKeyboard();
   void strobeKeyboard();
+  bool isFeeding() const { return feedPos < feed.size() || pastePending; }
+  bool isWaitingForKey() const { return polledEmpty; }
+
+  // UI thread
   void injectKey(uint8_t key);
+  void paste(const std::string &text);
+  bool hasPendingKeys() const { return !queue.empty() || pastePending; }
   void checkForInput();
 };
 
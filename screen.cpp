@@ -0,0 +1,266 @@
+#include "screen.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCREEN_X86 1
+#endif
+
+static const char *const DEL_GLYPH = "\xE2\x96\x92";   // U+2592 medium shade
+
+// ========== Frame Hash ==========
+//
+// Four 64-bit lanes take one word each from every 32-byte block. Each
+// word is XORed with a per-lane key that steps every block (so a word's
+// position matters), and its two 32-bit halves are multiplied together
+// and added to the lane along with the word itself. Every 1 KB the lanes
+// are scrambled with a shift, XOR and multiply. Only 32x32->64 multiplies
+// and 64-bit adds are needed, which SSE2 and AVX2 both have, so the
+// vector paths compute exactly what the scalar one does.
+
+static const int LANES = 4;
+static const size_t BLOCK_BYTES = LANES * 8;
+static const size_t SCRAMBLE_BLOCKS = 32;
+static const uint64_t KEY_STEP = 0x9E3779B97F4A7C15ULL;
+static const uint64_t PRIME32 = 0x9E3779B1ULL;
+static const uint64_t PRIME64 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t SEED_KEYS[LANES] = {
+  0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL
+};
+
+enum SimdLevel { SIMD_SCALAR = 0, SIMD_SSE2 = 1, SIMD_AVX2 = 2 };
+
+static int detectSimdLevel() {
+#ifdef SCREEN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+  return SIMD_SCALAR;
+}
+
+static const int detectedLevel = detectSimdLevel();
+static int activeLevel = detectedLevel;
+
+static uint64_t fmix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Blocks [first, first + count) of `data`; acc and key carry over
+static void hashBlocksScalar(const uint8_t *data, size_t first, size_t count,
+                             uint64_t *acc, uint64_t *key) {
+  for (size_t b = first; b < first + count; b++) {
+    for (int i = 0; i < LANES; i++) {
+      uint64_t word;
+      memcpy(&word, data + (b - first) * BLOCK_BYTES + i * 8, 8);
+      uint64_t k = word ^ key[i];
+      acc[i] += (k & 0xFFFFFFFF) * (k >> 32) + word;
+      key[i] += KEY_STEP;
+    }
+    if ((b + 1) % SCRAMBLE_BLOCKS == 0) {
+      for (int i = 0; i < LANES; i++) acc[i] = (acc[i] ^ (acc[i] >> 47)) * PRIME32;
+    }
+  }
+}
+
+#ifdef SCREEN_X86
+
+__attribute__((target("sse2")))
+static void hashBlocksSSE2(const uint8_t *data, size_t count, uint64_t *acc, uint64_t *key) {
+  __m128i acc0 = _mm_loadu_si128((const __m128i *)acc);
+  __m128i acc1 = _mm_loadu_si128((const __m128i *)(acc + 2));
+  __m128i key0 = _mm_loadu_si128((const __m128i *)key);
+  __m128i key1 = _mm_loadu_si128((const __m128i *)(key + 2));
+  const __m128i step = _mm_set1_epi64x(KEY_STEP);
+  const __m128i prime = _mm_set1_epi64x(PRIME32);
+
+  for (size_t b = 0; b < count; b++) {
+    __m128i w0 = _mm_loadu_si128((const __m128i *)(data + b * BLOCK_BYTES));
+    __m128i w1 = _mm_loadu_si128((const __m128i *)(data + b * BLOCK_BYTES + 16));
+    __m128i k0 = _mm_xor_si128(w0, key0);
+    __m128i k1 = _mm_xor_si128(w1, key1);
+    acc0 = _mm_add_epi64(acc0, _mm_add_epi64(_mm_mul_epu32(k0, _mm_srli_epi64(k0, 32)), w0));
+    acc1 = _mm_add_epi64(acc1, _mm_add_epi64(_mm_mul_epu32(k1, _mm_srli_epi64(k1, 32)), w1));
+    key0 = _mm_add_epi64(key0, step);
+    key1 = _mm_add_epi64(key1, step);
+
+    if ((b + 1) % SCRAMBLE_BLOCKS == 0) {
+      // x * PRIME32 mod 2^64 from two 32x32 multiplies
+      __m128i x0 = _mm_xor_si128(acc0, _mm_srli_epi64(acc0, 47));
+      __m128i x1 = _mm_xor_si128(acc1, _mm_srli_epi64(acc1, 47));
+      acc0 = _mm_add_epi64(_mm_mul_epu32(x0, prime),
+                           _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x0, 32), prime), 32));
+      acc1 = _mm_add_epi64(_mm_mul_epu32(x1, prime),
+                           _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x1, 32), prime), 32));
+    }
+  }
+
+  _mm_storeu_si128((__m128i *)acc, acc0);
+  _mm_storeu_si128((__m128i *)(acc + 2), acc1);
+  _mm_storeu_si128((__m128i *)key, key0);
+  _mm_storeu_si128((__m128i *)(key + 2), key1);
+}
+
+__attribute__((target("avx2")))
+static void hashBlocksAVX2(const uint8_t *data, size_t count, uint64_t *acc, uint64_t *key) {
+  __m256i a = _mm256_loadu_si256((const __m256i *)acc);
+  __m256i k = _mm256_loadu_si256((const __m256i *)key);
+  const __m256i step = _mm256_set1_epi64x(KEY_STEP);
+  const __m256i prime = _mm256_set1_epi64x(PRIME32);
+
+  for (size_t b = 0; b < count; b++) {
+    __m256i w = _mm256_loadu_si256((const __m256i *)(data + b * BLOCK_BYTES));
+    __m256i x = _mm256_xor_si256(w, k);
+    a = _mm256_add_epi64(a, _mm256_add_epi64(_mm256_mul_epu32(x, _mm256_srli_epi64(x, 32)), w));
+    k = _mm256_add_epi64(k, step);
+
+    if ((b + 1) % SCRAMBLE_BLOCKS == 0) {
+      __m256i s = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+      a = _mm256_add_epi64(_mm256_mul_epu32(s, prime),
+                           _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(s, 32), prime), 32));
+    }
+  }
+
+  _mm256_storeu_si256((__m256i *)acc, a);
+  _mm256_storeu_si256((__m256i *)key, k);
+}
+
+#endif
+
+uint64_t Screen::hashBytes(const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint64_t acc[LANES] = {0, 0, 0, 0};
+  uint64_t key[LANES];
+  memcpy(key, SEED_KEYS, sizeof(key));
+
+  size_t blocks = size / BLOCK_BYTES;
+  switch (activeLevel) {
+#ifdef SCREEN_X86
+    case SIMD_AVX2: hashBlocksAVX2(bytes, blocks, acc, key); break;
+    case SIMD_SSE2: hashBlocksSSE2(bytes, blocks, acc, key); break;
+#endif
+    default:        hashBlocksScalar(bytes, 0, blocks, acc, key); break;
+  }
+
+  // The tail goes through as one zero-padded block
+  size_t tail = size % BLOCK_BYTES;
+  if (tail) {
+    uint8_t last[BLOCK_BYTES] = {0};
+    memcpy(last, bytes + blocks * BLOCK_BYTES, tail);
+    hashBlocksScalar(last, blocks, 1, acc, key);
+  }
+
+  uint64_t h = size * PRIME64;
+  for (int i = 0; i < LANES; i++) {
+    h ^= fmix64(acc[i]);
+    h = ((h << 27) | (h >> 37)) * PRIME64;
+  }
+  return fmix64(h);
+}
+
+const char *Screen::simdLevel() {
+  switch (activeLevel) {
+    case SIMD_AVX2: return "avx2";
+    case SIMD_SSE2: return "sse2";
+    default:        return "scalar";
+  }
+}
+
+void Screen::setScalarOnly(bool scalarOnly) {
+  activeLevel = scalarOnly ? SIMD_SCALAR : detectedLevel;
+}
+
+// ========== Screen ==========
+
+Screen::Screen() : lastSequence(0), textValid(false), hashValid(false), hashCache(0) {
+  view.setFrameClock(true);
+}
+
+void Screen::update(VideoFrame &frame) {
+  // Only written cells make the text stale; the hash has the view's
+  // own dirty tracking (mode switches, flash) to go by
+  bool consecutive = frame.sequence == lastSequence + 1;
+  if (textValid && consecutive) {
+    for (int row = 0; row < AppleIIVideo::TEXT_HEIGHT; row++) {
+      if (frame.dirtyCells[row]) {
+        textValid = false;
+        break;
+      }
+    }
+  } else {
+    textValid = false;
+  }
+
+  view.showFrame(frame);
+  lastSequence = frame.sequence;
+}
+
+void Screen::scrapeText() {
+  textCache.clear();
+  attributeCache.clear();
+  if (!view.textMemory) return;
+
+  for (int row = 0; row < AppleIIVideo::TEXT_HEIGHT; row++) {
+    for (int col = 0; col < AppleIIVideo::TEXT_WIDTH; col++) {
+      uint8_t code = view.textMemory[AppleIIVideo::textOffset(row, col)];
+      char c = AppleIIVideo::glyphChar(code);
+      if (c == 0x7F) {
+        textCache += DEL_GLYPH;
+      } else {
+        textCache += c;
+      }
+      attributeCache += AppleIIVideo::isInverse(code) ? INVERSE
+                        : AppleIIVideo::isFlashing(code) ? FLASH : NORMAL;
+    }
+    textCache += '\n';
+    attributeCache += '\n';
+  }
+  textValid = true;
+}
+
+const std::string &Screen::text() {
+  if (!textValid) scrapeText();
+  return textCache;
+}
+
+const std::string &Screen::attributes() {
+  if (!textValid) scrapeText();
+  return attributeCache;
+}
+
+std::string Screen::line(int row) {
+  if (row < 0 || row >= AppleIIVideo::TEXT_HEIGHT) return "";
+  const std::string &all = text();
+
+  // Rows are 40 characters but not 40 bytes once a DEL glyph is in them
+  size_t start = 0;
+  for (int r = 0; r < row; r++) start = all.find('\n', start) + 1;
+  size_t end = all.find('\n', start);
+  while (end > start && all[end - 1] == ' ') end--;
+  return all.substr(start, end - start);
+}
+
+const uint32_t *Screen::pixels() {
+  if (!view.textMemory) return nullptr;
+  hash();
+  return view.frameBuffer;
+}
+
+uint64_t Screen::hash() {
+  if (!view.textMemory) return 0;
+
+  AppleIIVideo::DirtyRect rect;
+  if (hashValid && view.getDirtyRects(&rect, 1) == 0) {
+    return hashCache;
+  }
+
+  view.render();
+  hashCache = hashBytes(view.frameBuffer, AppleIIVideo::HIRES_WIDTH * AppleIIVideo::HIRES_HEIGHT * sizeof(uint32_t));
+  hashValid = true;
+  return hashCache;
+}
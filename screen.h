@@ -0,0 +1,71 @@
+// screen.h - What is on screen: text scraping and frame hashes for tests
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include "ppu.h"
+#include "videoframe.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Answers "what is on screen now?" from published frames. Text and hash
+// are cached and only recomputed after a frame that changed them, so
+// polling an idle screen costs a couple of compares. The hash covers the
+// rendered pixels, so it works in every mode and changes with the palette
+// and the flash phase (which follows the frame count, not the host clock).
+class Screen {
+public:
+  // Per-cell attributes, as returned by attributes()
+  static const char NORMAL = ' ';
+  static const char INVERSE = 'I';
+  static const char FLASH = 'F';
+
+  Screen();
+
+  void setPalette(AppleIIVideo::Palette palette) { view.setPalette(palette); }
+
+  // Show a new frame. It must stay valid until the next update(), as
+  // frames from FrameExchange::acquire() do.
+  void update(VideoFrame &frame);
+  bool hasFrame() const { return view.textMemory != nullptr; }
+
+  // The text page, 24 lines of 40 characters each ending in '\n', as
+  // UTF-8 (the DEL checkerboard is U+2592). Shown whatever the mode.
+  const std::string &text();
+
+  // Same shape as text(): NORMAL, INVERSE or FLASH per cell
+  const std::string &attributes();
+
+  // One text row with trailing spaces removed
+  std::string line(int row);
+
+  bool contains(const std::string &needle) { return text().find(needle) != std::string::npos; }
+
+  // 64-bit hash of the visible 280x192 frame
+  uint64_t hash();
+
+  // The rendered frame itself, 280x192 ARGB (nullptr before any frame)
+  const uint32_t *pixels();
+
+  // The hash function itself; identical results on every code path
+  static uint64_t hashBytes(const void *data, size_t size);
+
+  // Name of the hash code path selected at startup ("avx2", "sse2" or "scalar")
+  static const char *simdLevel();
+
+  // Force the scalar path (used when comparing implementations)
+  static void setScalarOnly(bool scalarOnly);
+
+private:
+  AppleIIVideo view;
+  uint64_t lastSequence;
+  bool textValid;
+  bool hashValid;
+  std::string textCache;
+  std::string attributeCache;
+  uint64_t hashCache;
+
+  void scrapeText();
+};
+
+#endif
@@ -0,0 +1,337 @@
+#include "script.h"
+#include "applesoft.h"
+#include "frameexport.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+
+Script::Script()
+    : frame(new VideoFrame), timeout(DEFAULT_TIMEOUT), cycles(0), cycleLimit(0), runStart(0) {}
+
+// ========== Parsing ==========
+
+bool Script::parseNumber(const std::string &text, uint64_t &value) {
+  const char *digits = text.c_str();
+  int base = 10;
+  if (text.size() > 1 && text[0] == '$') {
+    digits++;
+    base = 16;
+  } else if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+    digits += 2;
+    base = 16;
+  }
+  if (!*digits) return false;
+
+  char *end;
+  value = strtoull(digits, &end, base);
+  return *end == 0;
+}
+
+bool Script::tokenizeLine(const std::string &text, std::vector<std::string> &words, std::string &error) {
+  size_t i = 0;
+  while (i < text.size()) {
+    char c = text[i];
+    if (c == '#') break;
+    if (isspace((unsigned char)c)) {
+      i++;
+      continue;
+    }
+
+    std::string word;
+    if (c != '"') {
+      while (i < text.size() && !isspace((unsigned char)text[i])) word += text[i++];
+      words.push_back(word);
+      continue;
+    }
+
+    for (i++; i < text.size() && text[i] != '"'; i++) {
+      if (text[i] != '\\' || i + 1 == text.size()) {
+        word += text[i];
+        continue;
+      }
+      char e = text[++i];
+      switch (e) {
+        case 'n': word += '\n'; break;
+        case 'r': word += '\r'; break;
+        case 't': word += '\t'; break;
+        case 'x':
+          if (i + 2 < text.size() && isxdigit((unsigned char)text[i + 1]) && isxdigit((unsigned char)text[i + 2])) {
+            word += (char)std::stoi(text.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+          } else {
+            error = "bad \\x escape";
+            return false;
+          }
+          break;
+        default: word += e; break;
+      }
+    }
+    if (i == text.size()) {
+      error = "unterminated string";
+      return false;
+    }
+    i++;
+    words.push_back(word);
+  }
+  return true;
+}
+
+bool Script::parse(const std::string &text, const std::string &scriptName, std::string &error) {
+  name = scriptName;
+  commands.clear();
+
+  size_t pos = 0;
+  int lineNumber = 0;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    if (eol == std::string::npos) eol = text.size();
+    std::string line = text.substr(pos, eol - pos);
+    pos = eol + 1;
+    lineNumber++;
+
+    Command command;
+    command.line = lineNumber;
+    std::string message;
+    if (!tokenizeLine(line, command.words, message)) {
+      error = name + ":" + std::to_string(lineNumber) + ": " + message;
+      return false;
+    }
+    if (!command.words.empty()) commands.push_back(command);
+  }
+  return true;
+}
+
+bool Script::load(const std::string &filename, std::string &error) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    error = "cannot open " + filename;
+    return false;
+  }
+  std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return parse(text, filename, error);
+}
+
+// ========== Running ==========
+
+// Capture the machine's video only when it has written something since
+// the last look (or when asked), so polling an idle screen is a few compares
+void Script::sync(Machine &machine, bool force) {
+  bool changed = force || !view.hasFrame();
+  for (int row = 0; row < AppleIIVideo::TEXT_HEIGHT && !changed; row++) {
+    changed = machine.video.dirtyCells[row] != 0;
+  }
+  for (int i = 0; i < 6 && !changed; i++) {
+    changed = machine.video.dirtyLines[i / 3][i % 3] != 0;
+  }
+  if (!changed) return;
+
+  machine.video.capture(*frame);
+  view.update(*frame);
+}
+
+// Cycles left under the run's cycle limit
+uint64_t Script::remaining(Machine &machine) const {
+  if (!cycleLimit) return UINT64_MAX;
+  uint64_t used = machine.cycles() - runStart;
+  return used < cycleLimit ? cycleLimit - used : 0;
+}
+
+// Run in POLL_CYCLES steps until `done` or `limit` cycles have passed
+bool Script::runUntil(Machine &machine, uint64_t limit, const std::function<bool()> &done) {
+  uint64_t start = machine.cycles();
+  limit = std::min(limit, remaining(machine));
+  while (!done()) {
+    if (machine.cycles() - start >= limit) return false;
+    machine.runCycles(POLL_CYCLES);
+  }
+  return true;
+}
+
+bool Script::execute(Machine &machine, const Command &command, std::ostream &out, std::string &error) {
+  const std::vector<std::string> &w = command.words;
+  const std::string &op = w[0];
+
+  auto optionalTimeout = [&](size_t index, uint64_t &limit) {
+    limit = timeout;
+    if (w.size() <= index) return true;
+    if (w.size() > index + 1 || !parseNumber(w[index], limit)) {
+      error = "bad timeout";
+      return false;
+    }
+    return true;
+  };
+
+  if (op == "wait" && w.size() >= 2) {
+    uint64_t limit;
+    if (!optionalTimeout(2, limit)) return false;
+    const std::string &needle = w[1];
+    bool found = runUntil(machine, limit, [&] {
+      sync(machine, false);
+      return view.contains(needle);
+    });
+    if (!found) error = "timed out after " + std::to_string(limit) + " cycles waiting for \"" + needle + "\"";
+    return found;
+  }
+
+  if (op == "wait-input") {
+    uint64_t limit;
+    if (!optionalTimeout(1, limit)) return false;
+    bool waiting = runUntil(machine, limit, [&] {
+      return machine.isWaitingForKey() && !machine.keyboard.isFeeding() && !machine.hasPendingProgram();
+    });
+    if (!waiting) error = "timed out after " + std::to_string(limit) + " cycles waiting for a key read";
+    return waiting;
+  }
+
+  if (op == "type" && w.size() >= 2) {
+    uint64_t limit;
+    if (!optionalTimeout(2, limit)) return false;
+    machine.keyboard.paste(w[1]);
+    bool typed = runUntil(machine, limit, [&] { return !machine.keyboard.isFeeding(); });
+    if (!typed) error = "timed out after " + std::to_string(limit) + " cycles typing \"" + w[1] + "\"";
+    return typed;
+  }
+
+  if (op == "run" && w.size() == 2) {
+    uint64_t count;
+    if (!parseNumber(w[1], count)) {
+      error = "bad cycle count";
+      return false;
+    }
+    uint64_t left = remaining(machine);
+    machine.runCycles(std::min(count, left));
+    if (count > left) error = "stopped " + std::to_string(count - left) + " cycles short";
+    return count <= left;
+  }
+
+  if (op == "timeout" && w.size() == 2) {
+    if (!parseNumber(w[1], timeout)) {
+      error = "bad timeout";
+      return false;
+    }
+    return true;
+  }
+
+  if (op == "load" && w.size() == 2) {
+    std::ifstream file(w[1], std::ios::binary);
+    if (!file.is_open()) {
+      error = "cannot open " + w[1];
+      return false;
+    }
+    std::string listing((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!Applesoft::load(machine.cpu.ram, listing, error)) {
+      error = w[1] + ": " + error;
+      return false;
+    }
+    return true;
+  }
+
+  if (op == "assert" && w.size() >= 3) {
+    const std::string &what = w[1];
+    if (what == "screen" && w.size() == 3) {
+      sync(machine, false);
+      if (view.contains(w[2])) return true;
+      error = "screen does not contain \"" + w[2] + "\"";
+      return false;
+    }
+
+    uint64_t number;
+    if (what == "line" && w.size() == 4 && parseNumber(w[2], number)) {
+      sync(machine, false);
+      std::string line = view.line(number);
+      if (line == w[3]) return true;
+      error = "line " + w[2] + " is \"" + line + "\", expected \"" + w[3] + "\"";
+      return false;
+    }
+
+    if (what == "mem" && w.size() >= 4 && parseNumber(w[2], number) && number <= 0xFFFF) {
+      for (size_t i = 3; i < w.size(); i++) {
+        uint64_t expected;
+        uint16_t address = number + i - 3;
+        if (!parseNumber(w[i].find_first_of("$x") == std::string::npos ? "$" + w[i] : w[i], expected) || expected > 0xFF) {
+          error = "bad byte " + w[i];
+          return false;
+        }
+        if (machine.cpu.ram[address] != expected) {
+          char message[80];
+          snprintf(message, sizeof(message), "memory at $%04X is $%02X, expected $%02X",
+                   address, machine.cpu.ram[address], (unsigned)expected);
+          error = message;
+          return false;
+        }
+      }
+      return true;
+    }
+
+    if (what == "hash" && w.size() == 3) {
+      sync(machine, true);
+      char actual[17];
+      snprintf(actual, sizeof(actual), "%016llx", (unsigned long long)view.hash());
+      if (w[2] == actual) return true;
+      error = std::string("frame hash is ") + actual + ", expected " + w[2];
+      return false;
+    }
+  }
+
+  if (op == "snapshot" && w.size() == 2) {
+    sync(machine, true);
+    const std::string &path = w[1];
+    bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+    const int width = AppleIIVideo::HIRES_WIDTH;
+    const int height = AppleIIVideo::HIRES_HEIGHT;
+    bool ok = png ? FrameExporter::writePNG(path, view.pixels(), width, height)
+                  : FrameExporter::writePPM(path, view.pixels(), width, height);
+    if (!ok) error = "cannot write " + path;
+    return ok;
+  }
+
+  if (op == "print" && w.size() >= 2) {
+    uint64_t address, length;
+    if (w[1] == "screen" && w.size() == 2) {
+      sync(machine, false);
+      out << view.text();
+      return true;
+    }
+    if (w[1] == "mem" && w.size() == 4 && parseNumber(w[2], address) && parseNumber(w[3], length)) {
+      printMemory(out, machine.cpu.ram, address, length);
+      return true;
+    }
+    out << w[1] << "\n";
+    return true;
+  }
+
+  error = "bad command: " + op;
+  return false;
+}
+
+void Script::printMemory(std::ostream &out, const uint8_t *ram, uint16_t address, uint64_t length) {
+  for (uint64_t i = 0; i < length; i++) {
+    char hex[8];
+    uint16_t a = address + i;
+    if (i % 16 == 0) {
+      snprintf(hex, sizeof(hex), "%04X:", a);
+      out << (i ? "\n" : "") << hex;
+    }
+    snprintf(hex, sizeof(hex), " %02X", ram[a]);
+    out << hex;
+  }
+  out << "\n";
+}
+
+bool Script::run(Machine &machine, std::ostream &out, std::string &error) {
+  runStart = machine.cycles();
+  for (const Command &command : commands) {
+    std::string message;
+    bool ok = execute(machine, command, out, message);
+    cycles = machine.cycles() - runStart;
+    if (!ok && cycleLimit && cycles >= cycleLimit) {
+      message = "cycle limit of " + std::to_string(cycleLimit) + " reached during " + command.words[0];
+    }
+    if (!ok) {
+      error = name + ":" + std::to_string(command.line) + ": " + message;
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,92 @@
+// script.h - Expect-style automation: wait for the screen, type, assert
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include "machine.h"
+#include "screen.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A script drives a Machine directly, on the calling thread and flat out:
+// every command runs exactly as many emulated cycles as it needs, and all
+// timeouts are in cycles, so a script never sleeps and takes the same
+// cycles on every host. One command per line; '#' starts a comment.
+//
+//   wait "TEXT" [TIMEOUT]        run until the text page contains TEXT
+//   wait-input [TIMEOUT]         run until the program polls an empty keyboard
+//   type "TEXT" [TIMEOUT]        type TEXT, running until every key is read
+//   run CYCLES                   run a fixed number of cycles
+//   load FILE                    tokenize an Applesoft listing into memory now
+//   assert screen "TEXT"         the text page contains TEXT
+//   assert line ROW "TEXT"       text row ROW (0-23) is TEXT, less trailing spaces
+//   assert mem ADDR BYTE...      memory from ADDR holds these (hex) bytes
+//   assert hash HEX              the visible frame hashes to HEX (see -print-screen)
+//   snapshot FILE                save the screen as PNG (.png) or PPM
+//   print screen | print mem ADDR LENGTH | print "TEXT"
+//   timeout CYCLES               default timeout for wait and type
+//
+// Strings take \n, \r, \t, \", \\ and \xHH escapes; "\r" is Return.
+// Numbers are decimal, or hex with a $ or 0x prefix.
+class Script {
+public:
+  static const uint64_t DEFAULT_TIMEOUT = 50000000;     // ~50 s emulated
+  static const uint64_t POLL_CYCLES = 256;              // Screen checks while waiting
+
+  Script();
+
+  void setPalette(AppleIIVideo::Palette palette) { view.setPalette(palette); }
+
+  // Cap the cycles a whole run() may take, whatever the per-command
+  // timeouts say (0 = no cap). Running into it fails the command.
+  void setCycleLimit(uint64_t limit) { cycleLimit = limit; }
+
+  bool load(const std::string &filename, std::string &error);
+  bool parse(const std::string &text, const std::string &name, std::string &error);
+
+  // Run every command against `machine`, printing to `out`. Stops at
+  // the first failure, which is described in `error` as name:line: message.
+  bool run(Machine &machine, std::ostream &out, std::string &error);
+
+  // Screen as the script last saw it (e.g. to show after a failure)
+  Screen &screen() { return view; }
+
+  // Screen as the machine shows it now, caught up if it has changed
+  Screen &screen(Machine &machine) {
+    sync(machine, false);
+    return view;
+  }
+  uint64_t cyclesRun() const { return cycles; }
+
+  // Script syntax, for other line-based formats (batch manifests)
+  static bool tokenizeLine(const std::string &text, std::vector<std::string> &words, std::string &error);
+  static bool parseNumber(const std::string &text, uint64_t &value);
+
+  // Hex dump as "print mem" writes it: 16 bytes a line, "ADDR: XX XX ..."
+  static void printMemory(std::ostream &out, const uint8_t *ram, uint16_t address, uint64_t length);
+
+private:
+  struct Command {
+    int line;
+    std::vector<std::string> words;      // Quotes removed, escapes applied
+  };
+
+  std::string name;
+  std::vector<Command> commands;
+  Screen view;
+  std::unique_ptr<VideoFrame> frame;
+  uint64_t timeout;
+  uint64_t cycles;
+  uint64_t cycleLimit;
+  uint64_t runStart;
+
+  uint64_t remaining(Machine &machine) const;
+  void sync(Machine &machine, bool force);
+  bool runUntil(Machine &machine, uint64_t limit, const std::function<bool()> &done);
+  bool execute(Machine &machine, const Command &command, std::ostream &out, std::string &error);
+};
+
+#endif
@@ -0,0 +1,38 @@
+#include "slots.h"
+
+SlotBus::SlotBus() : selected(nullptr) {
+    for (int i = 0; i < NUM_SLOTS; i++) {
+        cards[i] = nullptr;
+        io[i] = nullptr;
+        rom[i] = nullptr;
+        expansion[i] = nullptr;
+    }
+}
+
+void SlotBus::insert(int slot, Card* card) {
+    // Slot 0 has no firmware page ($C000-$C0FF is I/O)
+    if (slot < 0 || slot >= NUM_SLOTS) {
+        return;
+    }
+    remove(slot);
+
+    cards[slot] = card;
+    io[slot] = card;
+    if (card && slot > 0) {
+        rom[slot] = card->getROM();
+        expansion[slot] = card->getExpansionROM();
+    }
+}
+
+void SlotBus::remove(int slot) {
+    if (slot < 0 || slot >= NUM_SLOTS) {
+        return;
+    }
+    if (selected && selected == expansion[slot]) {
+        selected = nullptr;
+    }
+    cards[slot] = nullptr;
+    io[slot] = nullptr;
+    rom[slot] = nullptr;
+    expansion[slot] = nullptr;
+}
@@ -0,0 +1,74 @@
+// slots.h - Peripheral cards and the slot bus ($C080-$CFFF)
+#ifndef SLOTS_H
+#define SLOTS_H
+
+#include <cstdint>
+
+// A peripheral card. Each slot n owns the 16 I/O locations at
+// $C080 + n * 16, the firmware page $Cn00-$CnFF and, while selected,
+// the shared expansion ROM at $C800-$CFFF.
+class Card {
+public:
+    virtual ~Card() {}
+
+    // I/O access; the low nibble of `address` selects the register
+    virtual uint8_t ioRead(uint16_t address) = 0;
+    virtual void ioWrite(uint16_t address, uint8_t value) = 0;
+
+    // 256-byte firmware page, or nullptr if the card has none
+    virtual const uint8_t* getROM() const { return nullptr; }
+
+    // 2 KB expansion ROM, or nullptr if the card has none
+    virtual const uint8_t* getExpansionROM() const { return nullptr; }
+};
+
+class SlotBus {
+public:
+    static const int NUM_SLOTS = 8;
+    static const uint16_t IO_BASE = 0xC080;
+    static const uint16_t ROM_BASE = 0xC100;
+    static const uint16_t EXPANSION_BASE = 0xC800;
+    static const uint16_t EXPANSION_SIZE = 0x800;
+    static const uint16_t EXPANSION_OFF = 0xCFFF;   // Any access deselects the expansion ROM
+
+    SlotBus();
+
+    // Cards are not owned; inserting into an occupied slot replaces the card
+    void insert(int slot, Card* card);
+    void remove(int slot);
+    Card* getCard(int slot) const { return (slot >= 0 && slot < NUM_SLOTS) ? cards[slot] : nullptr; }
+
+    // Card answering $C080-$C0FF, or nullptr for an empty slot
+    Card* ioCard(uint16_t address) const { return io[(address >> 4) & 7]; }
+
+    // Byte at $C100-$CFFF, or nullptr when no card drives the bus there.
+    // Touching a slot's firmware page selects its expansion ROM.
+    const uint8_t* romByte(uint16_t address) {
+        int page = (address >> 8) & 0x0F;
+        if (page < 8) {
+            if (expansion[page]) selected = expansion[page];
+            return rom[page] ? rom[page] + (address & 0xFF) : nullptr;
+        }
+        if (address == EXPANSION_OFF) {
+            selected = nullptr;
+            return nullptr;
+        }
+        return selected ? selected + (address & (EXPANSION_SIZE - 1)) : nullptr;
+    }
+
+    // Writes to the firmware area only matter for the expansion ROM switch
+    void romWrite(uint16_t address) {
+        if (address == EXPANSION_OFF) {
+            selected = nullptr;
+        }
+    }
+
+private:
+    Card* cards[NUM_SLOTS];
+    Card* io[NUM_SLOTS];                    // Indexed by bits 4-6 of the address
+    const uint8_t* rom[NUM_SLOTS];          // Indexed by the $Cn page
+    const uint8_t* expansion[NUM_SLOTS];
+    const uint8_t* selected;                // Expansion ROM currently at $C800
+};
+
+#endif
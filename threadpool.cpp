@@ -0,0 +1,96 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(int threads) : nextWorker(0), pending(0), stopping(false) {
+    if (threads <= 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(new Worker);
+    }
+    for (int i = 0; i < threads; i++) {
+        workers[i]->thread = std::thread(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+void ThreadPool::submit(Job job) {
+    Worker& worker = *workers[nextWorker++ % workers.size()];
+    pending++;
+    {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.jobs.push_back(std::move(job));
+    }
+    // Take the idle lock so a worker between "no job" and "sleep" sees it
+    { std::lock_guard<std::mutex> guard(idleLock); }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(idleLock);
+    allDone.wait(guard, [this] { return pending == 0; });
+}
+
+bool ThreadPool::takeJob(int index, Job& job) {
+    // Own deque first, newest job (still warm in cache)
+    Worker& own = *workers[index];
+    {
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // Then steal the oldest job from the others
+    for (size_t i = 1; i < workers.size(); i++) {
+        Worker& victim = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(int index) {
+    Job job;
+    for (;;) {
+        if (takeJob(index, job)) {
+            job();
+            job = nullptr;
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> guard(idleLock);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idleLock);
+        if (stopping) return;
+        // Re-check under the lock: submit() takes it before notifying
+        bool queued = false;
+        for (auto& worker : workers) {
+            std::lock_guard<std::mutex> jobGuard(worker->lock);
+            if (!worker->jobs.empty()) { queued = true; break; }
+        }
+        if (!queued) {
+            workAvailable.wait(guard);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+// threadpool.h - Work-stealing thread pool for batch jobs
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Each worker owns a deque. Jobs are dealt round-robin; a worker takes
+// its newest job first and, once its own deque is empty, steals the oldest
+// job from another worker. Long and short jobs then even out without one
+// shared queue that every thread contends on.
+class ThreadPool {
+public:
+    typedef std::function<void()> Job;
+
+    explicit ThreadPool(int threads = 0);   // 0 = hardware concurrency
+    ~ThreadPool();
+
+    void submit(Job job);
+
+    // Block until every submitted job has finished
+    void wait();
+
+    int size() const { return (int)workers.size(); }
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<Job> jobs;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<unsigned> nextWorker;
+    std::atomic<int> pending;               // Submitted but not finished
+    std::atomic<bool> stopping;
+
+    std::mutex idleLock;                    // Guards the two condition variables
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    void run(int index);
+    bool takeJob(int index, Job& job);
+};
+
+#endif
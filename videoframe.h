@@ -0,0 +1,62 @@
+// videoframe.h - Frame snapshots handed from the CPU thread to the display
+#ifndef VIDEOFRAME_H
+#define VIDEOFRAME_H
+
+#include "ppu.h"
+#include <atomic>
+#include <cstdint>
+
+// Everything the renderer needs for one frame: video memory, the soft
+// switch state, and the cells and lines written since the previous frame
+struct VideoFrame {
+  uint64_t sequence;               // Consecutive frames differ by one
+  AppleIIVideo::VideoMode mode;
+  bool displayPage2;
+  bool fullScreen;
+  bool hiResMode;
+  bool store80;
+  bool col80;
+  bool doubleHiRes;
+
+  uint64_t dirtyCells[AppleIIVideo::TEXT_HEIGHT];
+  uint64_t dirtyLines[2][3];
+
+  uint8_t textMemory[AppleIIVideo::TEXT_PAGE_BYTES];
+  uint8_t hiResPage1[AppleIIVideo::HIRES_PAGE_BYTES];
+  uint8_t hiResPage2[AppleIIVideo::HIRES_PAGE_BYTES];
+  uint8_t auxHiResPage1[AppleIIVideo::HIRES_PAGE_BYTES];
+};
+
+// Lock-free triple buffer with one producer and one consumer. Each side
+// owns a buffer outright; the third sits in the middle and is exchanged
+// atomically, tagged FRESH while it holds a frame nobody has read. The
+// producer never waits, and the consumer always gets the newest frame.
+class FrameExchange {
+public:
+  FrameExchange() : middle(1), back(0), front(2) {}
+
+  // Producer: fill backBuffer(), then publish() it
+  VideoFrame& backBuffer() { return frames[back]; }
+  void publish() {
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Consumer: the newest published frame, or nullptr if nothing new
+  // arrived. The frame stays valid until the next successful acquire().
+  VideoFrame* acquire() {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH)) return nullptr;
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return &frames[front];
+  }
+
+private:
+  static const int INDEX = 3;
+  static const int FRESH = 4;
+
+  VideoFrame frames[3];
+  std::atomic<int> middle;
+  int back;                        // Producer only
+  int front;                       // Consumer only
+};
+
+#endif